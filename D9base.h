@@ -2,6 +2,8 @@
 #include "Orbitersdk.h"
 #include "UMmuSDK.h"
 #include "UCGOCargoSDK.h" //UCGO 2.0 copy past this line
+#include "FlightRecorder.h"
+#include "InputLog.h"
 
 // Vessel Parameters
 // This is where data about the vessel class can be specified, then loaded latr under a shorter name. For example,
@@ -13,18 +15,8 @@ const VECTOR3 EXP_CS = {398.95,221.22,32.49}; //Shuttle-D cross section in m^2
 const VECTOR3 EXP_PMI = {142.96,138.51,5.30}; //Principal Moments of Inertia, normalized, m^2
 const double EXP_EMPTYMASS = 14770; //empty vessel mass in kg
 const double EXP_FUELMASS =  11900; //max fuel mass in kg
-const double EXP_RCS1FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS2FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS3FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS4FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS5FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS6FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS7FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS8FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS9FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS10FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS11FUELMASS =  120; //max fuel mass in kg
-const double EXP_RCS12FUELMASS =  120; //max fuel mass in kg
+const double EXP_RCSFUELMASS =  120; //max fuel mass of each RCS tank in kg
+const double EXP_RCSXFEED = 2.0; //RCS cross-feed, the most any one tank can gain or lose in kg/s
 const double VACSHD_ISP = 9000; //fuel-specific impulse in m/s
 const double NMLSHD_ISP = 4200; //fuel-specific impulse in m/s
 const double VACRCS_ISP = 1600; //fuel-specific impulse in m/s
@@ -50,6 +42,362 @@ const double RCSTH15 = 1200;
 const double GEAR_OPERATING_SPEED = 0.10;
 const double PLBAYA_OPERATING_SPEED = 0.07;
 const double PLBAYB_OPERATING_SPEED = 0.18;
+const double UCGO_WARN_TIME = 20.0;	// seconds of sim time after the vessel is created that UCGO may tell the user it isnt installed
+const double MASS_UPDATE_STEP = 0.01; // kg of O2 or propellant used up before the new mass properties are worth pushing to Orbiter again
+const VECTOR3 EXP_O2TANKPOS = {0,0,20.0}; // rough position of the O2 tank (crew module) for the mass properties
+const VECTOR3 EXP_MAINTANKPOS = {0,0,-10.0}; // rough position of the main propellant tank
+
+// Vessel layout
+// The RCS tanks, thrusters, exhausts & groups, the UCGO cargo slots & the UMmu action areas. The defaults are the tables at the top of
+// SHD.cpp, but any of them can be replaced from Shuttle-D.cfg (see the comments in there for the format). Each cfg file is only read
+// once a session: the layouts are kept by the checksum of the cfg text, so every vessel of a class reuses the one SHDLAYOUT, while
+// a variant with a cfg of its own (Module = ShuttleD) gets its own. A parsed layout is also written to LAYOUT_CACHE_DIR with the
+// cfg checksum in it, & the next session loads it from there without parsing anything, for as long as the cfg stays the same.
+const int MAX_RCS_TANKS = 16;
+const int MAX_RCS_THRUSTERS = 32;	// no more than 32, as thruster groups are bitmasks
+const int MAX_RCS_EXHAUSTS = 32;
+const int MAX_RCS_GROUPS = 16;
+const int MAX_CARGO_SLOTS = 32;
+const int MAX_ACTION_AREAS = 8;
+
+struct THRUSTERDEF { VECTOR3 pos, dir; double maxth; int tank; };
+struct EXHAUSTDEF { int th; double lscale, wscale; VECTOR3 pos, dir; };
+struct THGROUPDEF { THGROUP_TYPE type; unsigned int mask; };	// bit n set for each thruster n in the group
+struct CARGOSLOTDEF { VECTOR3 pos, rot, release; };
+struct ACTIONAREADEF { VECTOR3 pos; double radius; char msg[64]; };
+
+struct SHDLAYOUT
+{
+	int ntank;		double tank[MAX_RCS_TANKS];				// RCS propellant resources, max mass in kg
+	int nth;		THRUSTERDEF th[MAX_RCS_THRUSTERS];		// RCS thrusters, tank is an index into tank[]
+	int nexh;		EXHAUSTDEF exh[MAX_RCS_EXHAUSTS];		// RCS exhaust flames, th is an index into th[]
+	int ngroup;		THGROUPDEF group[MAX_RCS_GROUPS];		// RCS thruster groups
+	int nslot;		CARGOSLOTDEF slot[MAX_CARGO_SLOTS];		// UCGO cargo slots
+	int narea;		ACTIONAREADEF area[MAX_ACTION_AREAS];	// UMmu action areas, in the order clbkPostStep expects them
+};
+
+const int MAX_LAYOUTS = 8;		// different cfg files one session keeps a layout for
+const DWORD LAYOUT_CACHE_MAGIC = 0x4C444853;	// "SHDL"
+const DWORD LAYOUT_CACHE_VERSION = 1;			// bump it with anything that changes SHDLAYOUT
+#define LAYOUT_CACHE_DIR "Config\\Vessels\\Shuttle-D cache\\"
+
+struct LAYOUTCACHE
+{
+	DWORD magic;			// LAYOUT_CACHE_MAGIC
+	DWORD version;			// LAYOUT_CACHE_VERSION
+	DWORD size;				// sizeof(LAYOUTCACHE)
+	DWORD cfgsum;			// checksum of the cfg file the layout was parsed from
+	DWORD checksum;			// of L
+	SHDLAYOUT L;
+};
+
+// Mass properties
+// The pieces of the vessel whose mass changes during a flight: the O2 tank, the main propellant & each of the UCGO cargo slots.
+// Each one is treated as a point mass at a fixed position on top of the dry vessel (EXP_EMPTYMASS at the origin). EXP_PMI is taken
+// to be the PMI with a full O2 tank, full main propellant & no cargo, so the items only ever change the PMI by their difference
+// from that & an unloaded Shuttle-D still flies exactly like it always did. sum_mr & sum_mr2 hold the first & second moments of
+// all the items together, so when one item changes only its own difference has to be added in, instead of walking everything
+// again.
+const int MASS_O2 = 0;
+const int MASS_MAINFUEL = 1;
+const int MASS_CARGO0 = 2;
+const int MASS_ITEMS = MASS_CARGO0+MAX_CARGO_SLOTS;
+
+struct MASSPROPS
+{
+	double m[MASS_ITEMS];	// current mass of each item in kg
+	VECTOR3 pos[MASS_ITEMS];	// & where it sits in the vessel frame
+	double mass;			// dry mass + all items
+	VECTOR3 I0;				// inertia of the dry vessel about the origin, worked out from EXP_PMI
+	VECTOR3 sum_mr;			// sum of m*r over the items
+	VECTOR3 sum_mr2;		// sum of m*(y^2+z^2), m*(x^2+z^2), m*(x^2+y^2) over the items
+	VECTOR3 cg;				// resulting centre of gravity, relative to the vessel origin
+	VECTOR3 pmi;			// resulting mass-normalized PMI about the centre of gravity
+	VECTOR3 pmi_sent;		// PMI last passed to SetPMI
+};
+
+// RCS propellant
+// All the RCS tanks side by side, so the cross-feed can work on them as plain arrays (see RCS Propellant in SHD.cpp). Everything past
+// n is an empty tank with no capacity, which lets the arrays always be worked on two at a time.
+struct RCSTANKS
+{
+	int n;
+	PROPELLANT_HANDLE h[MAX_RCS_TANKS];
+	double mass[MAX_RCS_TANKS];	// contents in kg, as of the last step any RCS thruster fired
+	double max[MAX_RCS_TANKS];		// & capacity
+	double total;			// sum of mass[]
+	double capacity;		// sum of max[]
+	bool balancing;			// the cross-feed hasnt evened the tanks out yet
+};
+
+// Animated mechanisms
+// The gear & both payload bay doors all work the same way, so instead of three copies of the same state machine they live in one
+// array of MECHANISM entries, indexed by the numbers below. A new door or ramp only needs a new index here & a line in the table
+// at the top of SHD.cpp.
+const int MECH_GEAR = 0;
+const int MECH_PLBAYA = 1;
+const int MECH_PLBAYB = 2;
+const int MECH_COUNT = 3;
+
+struct MECHANISM
+{
+	// CLOSED means proc 0, OPEN means proc 1. The numbers match the old GEAR_UP/GEAR_DOWN/GEAR_RAISING/GEAR_LOWERING values
+	// so scenarios saved by older versions still load.
+	enum Status { CLOSED, OPEN, CLOSING, OPENING } status;
+	double proc;		// animation state, 0..1
+	double speed;		// fraction of full travel per second
+	UINT anim;			// animation handle
+	int wave_open;		// OrbiterSound wave played when it starts opening
+	int wave_close;		// & when it starts closing
+	bool started;		// set by RevertMechanism, cleared once the start event has fired
+};
+
+// Life support
+// Oxygen, the CO2 scrubbers (what they can still take up), water & battery power are used at a constant rate for as long as the
+// number of crew aboard stays the same. So instead of taking a little off each of them every step, LIFESUPPORT keeps each level as
+// it was at t0 with the rate since then: the level at any later time is one multiply & add, & the time it runs out is known as
+// soon as the rate is. Only a change of crew (or of a level, from the scenario) starts a new t0. Nothing is used with nobody
+// aboard. Rates are per second, O2, CO2 & water in kg, power in kWh. The O2 tank & rate are the ones the Shuttle-D always had,
+// & the others are sized so O2 still runs out first with any number of crew: 1000 kg lasts 833 crew days, the scrubbers 1000,
+// the water 857, & the power 833 days with one crew aboard (less base load a head with more).
+const int LS_O2 = 0;
+const int LS_CO2 = 1;
+const int LS_WATER = 2;
+const int LS_POWER = 3;
+const int LS_COUNT = 4;
+const double LS_CAPACITY[LS_COUNT] = {1000, 1000, 3000, 12000};
+const double LS_CREWRATE[LS_COUNT] = {1.2/86400, 1.0/86400, 3.5/86400, 0.1/3600};	// each crew member: 1.2 kg O2, 1 kg CO2 & 3.5 kg water a day, 100 W
+const double LS_BASERATE[LS_COUNT] = {0, 0, 0, 0.5/3600};							// life support itself while anyone is aboard: 500 W
+const int LS_WARNINGS = 3;
+const double LS_WARN_TIME[LS_WARNINGS] = {7*86400.0, 86400.0, 3600.0};	// the crew is warned this long before the first one runs out
+
+struct LIFESUPPORT
+{
+	double t0;					// sim time the levels are for
+	double level[LS_COUNT];		// at t0
+	double rate[LS_COUNT];		// since t0
+	int crew;					// the rates are for this many crew
+	unsigned int empty;			// one bit for each one that has run out since t0 & been dealt with
+	double tEmpty;				// sim time the next one runs out, a very long time if none of them ever does
+	int first;					// the one that runs out at tEmpty
+	int event;					// the EV_LIFESUPPORT event waiting for tEmpty, -1 if none
+	int warn;					// the next EV_LS_WARNING event, -1 if none
+};
+
+// HUD messages
+// UMmu, UCGO & our own code all report back through ShuttleD::HudMessage. The messages wait in a small fixed queue instead of
+// one buffer per library, so a new message doesnt wipe out the last one, & a message that keeps getting sent (the crash warning
+// is sent every step) just stays up longer instead of crowding everything else out. When the queue is full the oldest of the
+// least severe messages makes room.
+const int HUD_INFO = 0;
+const int HUD_WARNING = 1;
+const int HUD_ALERT = 2;
+const int HUD_QUEUE = 8;			// at most this many messages on screen, must fit the bits of hud_live
+const int HUD_MSGLEN = 160;			// longer ones are cut off
+const double HUD_TIME = 15.0;		// seconds a message stays up
+const double HUD_ALERT_TIME = 30.0;	// & an alert
+
+struct HUDMSG
+{
+	double expires;		// sim time it goes away at
+	DWORD seq;			// order they were sent in, the newest has the highest
+	DWORD hash;			// of the text, so a repeat is found without comparing strings
+	int severity;		// HUD_INFO, HUD_WARNING or HUD_ALERT
+	int len;			// strlen(text), worked out once when it was sent
+	int event;			// the EV_HUD_EXPIRE event waiting to take it off, -1 if none
+	char text[HUD_MSGLEN];
+};
+
+// Event scheduler
+// Anything that has to happen at a known sim time (a HUD message going away, a consumable running out, the next step of adding a
+// crew member) is put into a timer wheel instead of being checked every step. Times are counted in ticks of 1/SCHED_TICKS s; the
+// wheel has SCHED_LEVELS levels of 64 slots, level 0 one tick a slot, level 1 64 ticks a slot & so on, & an event sits in the
+// slot of the lowest level its tick fits into. Whenever level 0 comes round again the next slot of level 1 is shared out over
+// level 0, & so on up. mask has one bit for each slot with something in it, so empty stretches are stepped over a whole slot
+// of the level above at a time, & a step with nothing due costs one compare. Events further away than the top level can hold
+// wait in an overflow list that is looked at each time the top level comes round (about every 3 days). The events come from a
+// fixed pool in the vessel, nothing here allocates.
+const int SCHED_TICKS = 64;			// a second
+const int SCHED_BITS = 6;			// 64 slots a level, so one unsigned long long of mask each
+const int SCHED_SLOTS = 1 << SCHED_BITS;
+const int SCHED_LEVELS = 4;
+const int SCHED_OVERFLOW = SCHED_LEVELS*SCHED_SLOTS;	// the list after the last slot
+const int SCHED_EVENTS = 32;		// waiting at once, each vessel
+
+enum { EV_HUD_EXPIRE, EV_LIFESUPPORT, EV_LS_WARNING, EV_ADD_CREW };
+
+struct SCHEDEVENT
+{
+	LONGLONG tick;		// it is due once the wheel gets here
+	double t;			// sim time it was asked for
+	int type;			// EV_...
+	int arg;
+	DWORD seq;			// a second argument, for checking that the thing it is for is still the same one
+	int list;			// slot (level*SCHED_SLOTS + slot) or SCHED_OVERFLOW it is in, -1 once free
+	int prev, next;		// in that list or the free list, -1 at the ends
+};
+
+struct SCHEDULER
+{
+	SCHEDEVENT ev[SCHED_EVENTS];
+	int head[SCHED_OVERFLOW+1];				// first event in each slot & in the overflow list
+	unsigned long long mask[SCHED_LEVELS];	// one bit for each slot with something in it
+	int free;				// first unused event
+	int count;				// events waiting
+	LONGLONG now;			// the last tick that has been run
+};
+
+
+// Commands
+// Everything the pilot can do from the keyboard is one of these. The keys are bound to them through a table (see Commands & Key
+// Bindings in SHD.cpp, & the KEY_ lines in Shuttle-D.cfg), & the VC switches or any other code can run the same thing through
+// ShuttleD::RunCommand without pretending to press a key.
+enum {
+	CMD_GEAR, CMD_PLBAYA, CMD_PLBAYB,
+	CMD_GEAR_DOWN, CMD_GEAR_UP, CMD_PLBAYA_OPEN, CMD_PLBAYA_CLOSE, CMD_PLBAYB_OPEN, CMD_PLBAYB_CLOSE,
+	CMD_EVA, CMD_CREW_NEXT, CMD_CREW_PREV, CMD_AIRLOCK, CMD_CREW_INFO, CMD_ADD_CREW,
+	CMD_SLOT_NEXT, CMD_SLOT_PREV, CMD_CARGO_PICK, CMD_CARGO_ADD, CMD_CARGO_GRAPPLE, CMD_CARGO_RELEASE, CMD_CARGO_INFO,
+	CMD_O2_INFO, CMD_PROFILE, CMD_PROFILE_DUMP,
+	CMD_COUNT
+};
+
+// Binary snapshot
+// With BINARY_SNAPSHOT = TRUE in Shuttle-D.cfg, clbkSaveState also writes the whole vessel state into one of these, in a file of its
+// own, & the scenario just gets a SNAPSHOT line pointing at it. Loading maps the file & copies the numbers straight out, at full
+// precision & without parsing any text. Anything that changes the layout of this struct must bump SNAPSHOT_VERSION, as older files
+// are then ignored & the scenario text is used instead. UMmu crew & UCGO cargo still go through their own scenario lines, only our
+// selections in them are kept here.
+const DWORD SNAPSHOT_MAGIC = 0x53444853;	// "SHDS"
+const DWORD SNAPSHOT_VERSION = 4;
+#define SNAPSHOT_DIR "Config\\Vessels\\Shuttle-D snapshots\\"
+
+struct SHDSNAPSHOT
+{
+	DWORD magic;			// SNAPSHOT_MAGIC
+	DWORD version;			// SNAPSHOT_VERSION
+	DWORD size;				// sizeof(SHDSNAPSHOT)
+	DWORD checksum;			// of everything after the header, see SnapshotChecksum
+	int mech_status[MECH_COUNT];
+	double mech_proc[MECH_COUNT];
+	double ls_level[LS_COUNT];	// life support levels when saved
+	double mainfuel;
+	double rcs_mass[MAX_RCS_TANKS];
+	unsigned int rcs_failed;
+	int SelectedUmmuMember;
+	int iSelectedCargo;
+	HUDMSG hud[HUD_QUEUE];	// expires is the time left, 0 for an empty entry, event means nothing
+};
+
+// Telemetry
+// With TELEMETRY = TRUE in Shuttle-D.cfg every clbkPostStep drops one TLMRECORD into a ring, & a thread of its own takes them out
+// again & writes them to a CSV file, so the simulation never waits on the disk. Only the sim thread moves head & only the writer
+// moves tail, so neither needs a lock. If the writer falls behind the ring fills up & new records are counted in dropped instead
+// of being stored; the CSV gets a comment line wherever that happened.
+const LONG TLM_RING = 4096;		// records, must be a power of 2. About 40 s at 100 steps a second
+const DWORD TLM_SLEEP = 50;		// ms the writer waits after it has caught up
+#define TELEMETRY_DIR "Config\\Vessels\\Shuttle-D telemetry\\"
+
+struct TLMRECORD
+{
+	double simt, simdt;
+	double mech_proc[MECH_COUNT];
+	double O2Tank;
+	double mainfuel;
+	double rcsfuel;
+	double dynp;			// dynamic pressure
+	double vspeed;			// vertical speed
+	double cargo;			// UCGO cargo mass
+	int crew;
+};
+
+struct TLMSTREAM
+{
+	TLMRECORD rec[TLM_RING];
+	volatile LONG head;		// records pushed so far, rec[head % TLM_RING] is the next one to fill
+	volatile LONG tail;		// records written so far
+	volatile LONG dropped;	// records lost because the ring was full
+	volatile LONG stop;		// tells the writer to empty the ring one last time & finish
+	DWORD pushed;			// sim thread only
+	HANDLE thread;
+	FILE *f;
+	char path[256];
+};
+
+// Flight recorder
+// With FLIGHT_RECORDER = TRUE in Shuttle-D.cfg every step also goes into an FDRBUFFER, & once a chunk's worth has piled up it is
+// encoded a column at a time & written out. See FlightRecorder.h for the format, & FDRDump.cpp for getting a stretch of it back as CSV.
+#define RECORDER_DIR "Config\\Vessels\\Shuttle-D recorder\\"
+
+struct FDRBUFFER
+{
+	double col[FDR_COLS][FDR_CHUNK];	// the current chunk, column by column
+	int n;								// steps in it so far
+	unsigned char enc[FDR_COLS][FDR_MAXCOLBYTES];
+	unsigned char tmp[FDR_MAXCOLBYTES];
+	FILE *f;							// the .fdr
+	FILE *fx;							// & its .fdx index
+	unsigned long long offset;			// where the next chunk goes in the .fdr
+	DWORD steps, chunks;
+	char path[256];
+};
+
+// Input log
+// With INPUT_LOG = RECORD in Shuttle-D.cfg every key press & VC click that reaches a Shuttle-D, every answer typed into the add
+// crew boxes & the length of every time step go into a small binary log, Config\Vessels\Shuttle-D inputs\<name>.sil. With
+// INPUT_LOG = REPLAY the same scenario plays it back: each key, click & answer happens again after the same time step it happened
+// after the first time, & the live ones are ignored until the log runs out. The format is in InputLog.h.
+struct INPUTLOG
+{
+	bool replay;
+	FILE *f;
+	unsigned long long last;	// bits of the last simdt
+	DWORD steps, events;
+	DWORD differ;				// replayed steps whose simdt wasnt the recorded one
+	char path[256];
+};
+
+// Profiling
+// PROFILE_SCOPE(id) at the top of a block times the rest of that block into the histogram for id, & PROFILE_COUNT(c) counts one
+// call of an Orbiter SDK function we care about. Both only cost a flag test unless profiling is on (PROFILE = TRUE in Shuttle-D.cfg,
+// or the PROFILE key), & without SHD_PROFILE defined they compile to nothing at all. The numbers are for the whole module, so with
+// 40 Shuttle-Ds in a scene they show what all 40 cost together. See Profiling in SHD.cpp for the report.
+#define SHD_PROFILE
+
+enum {
+	PRF_PRESTEP, PRF_POSTSTEP, PRF_DRAWHUD, PRF_VCREDRAW, PRF_LOADVC, PRF_SETCLASSCAPS, PRF_LOADSTATE, PRF_SAVESTATE,
+	PRF_UMMU_PROCESS, PRF_UMMU_ACTIONAREA, PRF_UMMU_WARN, PRF_UMMU_LOAD, PRF_UMMU_SAVE,
+	PRF_UCGO_WARN, PRF_UCGO_LOAD, PRF_UCGO_SAVE,
+	PRF_COUNT
+};
+enum {
+	PRC_SETANIMATION, PRC_SETTOUCHDOWN, PRC_PLAYWAVE, PRC_SETMASS, PRC_BLT,
+	PRC_COUNT
+};
+const int PRF_BUCKETS = 16;	// bucket 0 is under 1 us, bucket b from 2^(b-1) us up to 2^b us, the last one everything longer
+#define PROFILE_FILE "Config\\Vessels\\Shuttle-D profile.txt"
+
+extern bool bShuttleProfile;
+extern DWORD ProfileCalls[PRC_COUNT];	// calls in the current frame
+void ProfileRecord (int id, const LARGE_INTEGER &t0);
+void ProfileFrame (double simt);
+
+class ProfileTimer
+{
+public:
+	ProfileTimer (int id): id(bShuttleProfile ? id : -1) { if (this->id >= 0) QueryPerformanceCounter (&t0); }
+	~ProfileTimer () { if (id >= 0) ProfileRecord (id, t0); }
+private:
+	int id;
+	LARGE_INTEGER t0;
+};
+
+#ifdef SHD_PROFILE
+#define PROFILE_SCOPE(id) ProfileTimer profile_timer (id)
+#define PROFILE_COUNT(c) (ProfileCalls[c]++)
+#else
+#define PROFILE_SCOPE(id)
+#define PROFILE_COUNT(c)
+#endif
 
 
 class ShuttleD :public VESSEL3
@@ -72,13 +420,34 @@ public:
 	void clbkLoadStateEx (FILEHANDLE scn, void *status);
 	bool clbkDrawHUD (int mode, const HUDPAINTSPEC *hps, oapi::Sketchpad *skp);
 	void clbkSaveState (FILEHANDLE scn);
+	bool SaveSnapshot (const char *path, DWORD &checksum);
+	bool LoadSnapshot (const char *path, DWORD checksum);
 	void Timestep (double simt);
+	void clbkPreStep (double simt, double simdt, double mjd);
 	void clbkPostStep (double simtt, double simdt, double mjd);
-	void RevertGEAR (void);
-	void RevertPLBAYA (void);
-	void RevertPLBAYB (void);
+	const SHDLAYOUT *layout;	// the one for our class's cfg, see Vessel Layout
+	void BuildRcsAllocation ();
+	void SetRcsThrusterFailed (int th, bool failed);
+	void BalanceRcsTanks (double simdt);
+	double RcsDeltaV ();
+	void RevertMechanism (int m);
+	void MoveMechanism (int m, double from, const char *msgok, const char *msgbusy);
+	void StepMechanisms (double simdt);
+	void MechanismStopped (int m);
 	double UpdateMass ();
+	void SetMassItem (int item, double m);
+	bool UpdateMassProperties ();
 	double O2Check ();
+	double LifeSupportLevel (int i, double simt) const;
+	void LifeSupportChanged ();
+	void SetLifeSupportCrew (int crew);
+	void LifeSupportEmpty (double simt);
+	void NextLifeSupportEmpty ();
+	void LifeSupportWarning (int k, double simt);
+	int ScheduleEvent (double t, int type, int arg = 0, DWORD seq = 0);
+	void CancelEvent (int e);
+	bool RunEvents (double simt);
+	void FireEvent (const SCHEDEVENT &e, double simt);
 	double Geardown ();
 	double Gearup ();
 	double MainBayOpen ();
@@ -86,24 +455,55 @@ public:
 	double AuxBayOpen ();
 	double AuxBayClose ();
 	void clbkPostCreation(void);
+	void StartTelemetry ();
+	void PushTelemetry (double simt, double simdt);
+	void StopTelemetry ();
+	TLMSTREAM *tlm;			// NULL unless TELEMETRY is on
+	void StartRecorder ();
+	void RecordStep (double simt);
+	void WriteRecorderChunk ();
+	void StopRecorder ();
+	FDRBUFFER *fdr;			// NULL unless FLIGHT_RECORDER is on
+	void StartInputLog (bool replay);
+	void LogStep (double simdt);
+	void LogEvent (int type, const void *data, int size);
+	void ReplayEvents ();
+	void StopInputLog (const char *why);
+	INPUTLOG *ilog;			// NULL unless INPUT_LOG is RECORD or REPLAY
 
-	// Bits of code used to give the gear & payload bay references to work with instead of 0,0.1,0.2...
+	// The gear & payload bay doors, see MECHANISM above. mech_moving has one bit set for each entry that is currently in motion,
+	// so a step where nothing moves doesnt have to look at any of them.
 	// The different VC camera positions are also identified here as well.
 
-	enum GEARStatus { GEAR_UP, GEAR_DOWN, GEAR_RAISING, GEAR_LOWERING } GEAR_status;
-	enum PLBAYAStatus { PLBAYA_UP, PLBAYA_DOWN, PLBAYA_CLOSING, PLBAYA_OPENING } PLBAYA_status;
-	enum PLBAYBStatus { PLBAYB_UP, PLBAYB_DOWN, PLBAYB_CLOSING, PLBAYB_OPENING } PLBAYB_status;
+	MECHANISM mech[MECH_COUNT];
+	unsigned int mech_moving;
+
+	// Step counters. nFastSteps counts the clbkPostStep calls where nothing on the vessel changed, so none of the mass, touchdown
+	// point, animation or UMmu/UCGO updates had to be sent anywhere.
+	DWORD nSteps;
+	DWORD nFastSteps;
+
+	// MFD button label strips: how often they were actually drawn, how often nothing had changed so the draw was skipped, & the
+	// total time spent drawing them in seconds. mfdLabel keeps the labels each strip was last drawn with (see clbkVCRedrawEvent).
+	DWORD nLabelRedraws;
+	DWORD nLabelSkips;
+	double tLabelRedraw;
+	char mfdLabel[4][6][8];
 	enum {CAM_VCPILOT, CAM_VCPSNGR1, CAM_VCPSNGR2, CAM_VCPSNGR3, CAM_VCPSNGR4} campos;
 
 	// This is a unique id, used to identify the ship in OrbiterSound.
 	int SHD;	
 
 	int  clbkConsumeBufferedKey (DWORD key, bool down, char *kstate);
+	int  KeyDown (DWORD key, int m);
+	void RunCommand (int cmd);
+	bool RunCommand (const char *name);
 	void clbkVisualCreated (VISHANDLE vis, int refcount);
 	void clbkMFDMode (int mfd, int mode);
 	bool clbkLoadVC (int id);
 	bool clbkVCRedrawEvent (int id, int event, SURFHANDLE surf);
 	bool clbkVCMouseEvent (int id, int event, VECTOR3 &p);
+	bool VCClick (int id, int event, VECTOR3 &p);
 	VCMFDSPEC mfds_left;
 	VCMFDSPEC mfds_right;
 
@@ -116,42 +516,74 @@ public:
 	int iActionAreaDemoStep;			// this is just to show one feature of action area.
 	void clbkSetClassCaps_UMMu(void);	// our special SetClassCap function just added for more readability
 
-	// The HUD display method variable, see PDF doc
-	char cUmmuHudDisplay[255];			// UMmu hud char variable
-	double dHudMessageDelay;			// UMmu hud display delay
-	char *SendHudMessage(void);			// UMmu hud display function
+	// The HUD messages, see HUDMSG above. hud_live has one bit set for each hudmsg entry still on screen, each of which has an
+	// EV_HUD_EXPIRE event waiting to take it off again.
+	HUDMSG hudmsg[HUD_QUEUE];
+	unsigned int hud_live;
+	DWORD hud_seq;
+	void HudMessage (int severity, const char *fmt, ...);
+	void PostHudMessage (int severity, const char *text, double expires);
 
 	// "Allow user to add crew to your ship 
 	// without scenery editor"
 	char cAddUMmuToVessel[255];
 	void AddUMmuToVessel(BOOL bStartAdding=FALSE);
+	void OpenCrewInputBox (const char *title);
 
 	// This section is for UCGO, another terrific development library by Dansteph which allows developers to add cargo carrying capabilities. 
 
 	// UCGO 2.0 CLASS HANDLE FUNCTION AND VARIABLES
 	UCGO	hUcgo;						// Cargo class handle
-	char   *SendCargHudMessage(void);	// Cargo hud display function
-	char	cCargoHudDisplay[255];		// Cargo hud display char variable
-	double	dCargHudMessageDelay;		// Cargo hud display delay
 	int		iSelectedCargo;				// for the selection of cargos -1 by default
 
 private:
 	int iActiveDockNumber;
-	UINT anim_gear;
-	UINT anim_PLBAYA;
-	UINT anim_PLBAYB;
+
+	// Scenario keys of our own, see clbkLoadStateEx & clbkSaveState. Each read handler gets whatever follows the key on the line,
+	// each write handler formats the value into buf & returns the end of it, or NULL if the key isnt needed in this save.
+	struct SCNKEY {
+		const char *key; size_t len;
+		void (ShuttleD::*read)(const char *value, int arg);
+		char *(ShuttleD::*write)(char *buf, int arg);
+		int arg;
+	};
+	static const SCNKEY ScenarioKeys[];
+	void ScnMechanism (const char *value, int m);
+	void ScnConsumable (const char *value, int i);
+	void ScnRcsFail (const char *value, int);
+	void ScnSnapshot (const char *value, int);
+	char *ScnSaveMechanism (char *buf, int m);
+	char *ScnSaveConsumable (char *buf, int i);
+	char *ScnSaveRcsFail (char *buf, int);
+	char *ScnSaveSnapshot (char *buf, int);
+	char cSnapshotFile[256];	// snapshot named in the scenario being loaded, applied once the rest of it is in
+	DWORD snapshotSum;
 
 	// Vessel specific parameters are called here like the # of kilos of LOX in the onboard tanks, the positions of the gear & payload bay doors,
 	//	a variable that Im hoping to use as a randomizer for this project in the future. Variables are used to store & keep track of various pieces
 	// of information during a simulation session, but need to be saved & loaded properly in clbkLoadStateEx & clbkSaveState
 	// if they are to be persistent. Oh hi Face... ;)
 
-	double GEAR_proc,PLBAYA_proc,PLBAYB_proc;
-	double O2Tank;
+	double O2Tank;			// ls.level[LS_O2] brought up to date each step, for the mass & anything else that shows it
+	LIFESUPPORT ls;
+	SCHEDULER sched;		// see Event Scheduler in SHD.cpp
+	double tdGearProc;		// gear position the touchdown points were last set for
+	MASSPROPS mp;
+	double massCargo;		// UCGO cargo total included in mp & the last empty mass sent to Orbiter
+	float fUMmuVersion;		// -1 if UMmu isnt installed
+	double tUcgoWarn;		// sim time the UCGO warning stops being called, see UCGO_WARN_TIME
 	double MSStime;
 	double Randomizer;
-	PROPELLANT_HANDLE *MainFuel, *RCSRES, *RCS1, *RCS2, *RCS3, *RCS4, *RCS5, *RCS6, *RCS7, *RCS8, *RCS9, *RCS10, *RCS11, *RCS12;
-	THRUSTER_HANDLE *th_rcs, *th_main;
+	PROPELLANT_HANDLE MainFuel;
+	RCSTANKS rcs;
+
+	// RCS allocation, see the RCS Allocation section in SHD.cpp. Orbiter only sees the th_cmd thrusters (one per group), the real
+	// thrusters get their levels from rcs_alloc. rcs_failed has one bit set for each thruster that is switched off.
+	THRUSTER_HANDLE th_rcs[MAX_RCS_THRUSTERS];
+	THRUSTER_HANDLE th_cmd[MAX_RCS_GROUPS];
+	double rcs_alloc[MAX_RCS_THRUSTERS][MAX_RCS_GROUPS];
+	unsigned int rcs_failed;
+	bool rcs_firing;		// the last clbkPreStep set at least one RCS level
 };
 
 
@@ -200,3 +632,4 @@ HBRUSH hBrush;
 #define AID_PLBAYACLOSESWITCH	37
 #define AID_PLBAYBOPENSWITCH	38
 #define AID_PLBAYBCLOSESWITCH	39
+#define VC_AREA_COUNT			40	// one more than the highest id above
@@ -0,0 +1,103 @@
+//=========================================================
+// FDRDump
+// A small command line tool that reads a Shuttle-D flight recorder file (see FlightRecorder.h) back out as CSV. It uses the index to
+// jump straight to the first chunk of the time range, & then decodes one chunk at a time, so a stretch of a multi-day recording
+// takes no longer to get out than its own length, & no more memory than one chunk. It needs nothing from Orbiter: build it on its
+// own as a console program.
+//
+//   FDRDump <name>.fdr [from [to]] > out.csv
+//
+// from & to are mission times (simt) in seconds. Without them it writes everything.
+//=========================================================
+
+#include "FlightRecorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+// the CSV header, one for each column RecordStep in SHD.cpp fills in
+static const char *FdrColumnName[FDR_COLS] = {
+	"simt", "O2Tank", "GEAR_proc", "PLBAYA_proc", "PLBAYB_proc", "mainfuel", "rcsfuel", "mass",
+	"airspeed_x", "airspeed_y", "airspeed_z", "dynp",
+};
+
+static double col[FDR_COLS][FDR_CHUNK];
+static unsigned char enc[FDR_MAXCOLBYTES];
+
+// reads index entry i
+static bool ReadIndex (FILE *fx, long i, FDRINDEX &ix)
+{
+	return fseek (fx, i*(long)sizeof(FDRINDEX), SEEK_SET) == 0 && fread (&ix, sizeof(ix), 1, fx) == 1;
+}
+
+int main (int argc, char *argv[])
+{
+	if (argc < 2 || strlen (argv[1]) < 4) {
+		fprintf (stderr, "usage: FDRDump <name>.fdr [from [to]]\n");
+		return 1;
+	}
+	double from = (argc > 2 ? atof (argv[2]) : -1e300);
+	double to = (argc > 3 ? atof (argv[3]) : 1e300);
+
+	char path[1024];
+	strncpy (path, argv[1], sizeof(path)-5);
+	path[sizeof(path)-5] = 0;
+	FILE *f = fopen (path, "rb");
+	strcpy (path + strlen(path) - 4, ".fdx");
+	FILE *fx = fopen (path, "rb");
+	if (!f || !fx) {
+		fprintf (stderr, "FDRDump: cant open %s & its .fdx\n", argv[1]);
+		return 1;
+	}
+	FDRHEADER hdr;
+	if (fread (&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != FDR_MAGIC || hdr.version != FDR_VERSION ||
+		hdr.cols != (unsigned)FDR_COLS || hdr.chunk != (unsigned)FDR_CHUNK) {
+		fprintf (stderr, "FDRDump: %s isnt a Shuttle-D recording this version can read\n", argv[1]);
+		return 1;
+	}
+
+	// the chunks are in time order, so look for the first one that ends at or after from
+	fseek (fx, 0, SEEK_END);
+	long lo = 0, hi = ftell (fx)/(long)sizeof(FDRINDEX);
+	FDRINDEX ix;
+	while (lo < hi) {
+		long mid = (lo+hi)/2;
+		if (!ReadIndex (fx, mid, ix)) return 1;
+		if (ix.t1 < from) lo = mid+1;
+		else hi = mid;
+	}
+
+	int c, i;
+	printf ("%s", FdrColumnName[0]);
+	for (c = 1; c < FDR_COLS; c++)
+		printf (",%s", FdrColumnName[c]);
+	printf ("\n");
+
+	// & from there on the chunks are read one after the other, no more index needed
+	if (ReadIndex (fx, lo, ix) && fseek64 (f, ix.offset, SEEK_SET) == 0) {
+		FDRCHUNKHEADER ch;
+		while (fread (&ch, sizeof(ch), 1, f) == 1 && ch.magic == FDR_CHUNKMAGIC && ch.n <= (unsigned)FDR_CHUNK && ch.t0 <= to) {
+			for (c = 0; c < FDR_COLS; c++)
+				if (ch.size[c] > (unsigned)FDR_MAXCOLBYTES || fread (enc, ch.size[c], 1, f) != 1 ||
+					!FdrDecodeColumn (enc, ch.size[c], ch.n, col[c])) {
+					fprintf (stderr, "FDRDump: damaged chunk at t = %.3f\n", ch.t0);
+					return 1;
+				}
+			for (i = 0; i < (int)ch.n; i++) {
+				if (col[0][i] < from || col[0][i] > to) continue;
+				printf ("%.15g", col[0][i]);
+				for (c = 1; c < FDR_COLS; c++)
+					printf (",%.15g", col[c][i]);
+				printf ("\n");
+			}
+		}
+	}
+	fclose (f);
+	fclose (fx);
+	return 0;
+}
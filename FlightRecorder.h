@@ -0,0 +1,116 @@
+#pragma once
+#include <string.h>
+
+// Flight Recorder file format
+// Shared by the module (see Flight Recorder in SHD.cpp) & the FDRDump tool, so it only uses the C library. A recording is two files:
+// <name>.fdr holds a file header & then the chunks, <name>.fdx holds one FDRINDEX entry per chunk, written as each chunk is, so a
+// reader can find the chunks around a mission time without reading the ones before it.
+//
+// A chunk holds up to FDR_CHUNK steps, & at most FDR_CHUNK_TIME seconds of them. Inside it each column is stored on its own, one
+// value per step. Every value is turned into a residual against the values before it in the same column (see FdrResidual), which
+// for anything that changes slowly leaves the high bytes zero & for anything that didnt change at all leaves nothing. Only the
+// bytes below the highest non-zero one are stored, after a 4 bit count of them per value (two counts to a byte). A column starts
+// with one byte saying which kind of residual it uses, & starts again from 0, so every chunk decodes on its own.
+
+const unsigned int FDR_MAGIC = 0x52444653;		// "SFDR"
+const unsigned int FDR_CHUNKMAGIC = 0x4B4E4843;	// "CHNK"
+const unsigned int FDR_VERSION = 1;
+const int FDR_CHUNK = 1024;						// steps per chunk at most
+const double FDR_CHUNK_TIME = 60.0;				// & seconds per chunk at most
+const int FDR_COLS = 12;						// in the order RecordStep in SHD.cpp fills them in, named in FDRDump.cpp
+const int FDR_MAXCOLBYTES = 1 + FDR_CHUNK/2 + FDR_CHUNK*8;	// the most one encoded column can take
+
+struct FDRHEADER
+{
+	unsigned int magic;			// FDR_MAGIC
+	unsigned int version;		// FDR_VERSION
+	unsigned int cols;			// FDR_COLS
+	unsigned int chunk;			// FDR_CHUNK
+};
+
+struct FDRCHUNKHEADER
+{
+	unsigned int magic;			// FDR_CHUNKMAGIC
+	unsigned int n;				// steps in the chunk
+	double t0, t1;				// simt of the first & last
+	unsigned int size[FDR_COLS];// bytes of each encoded column, in column order after this header
+};
+
+struct FDRINDEX
+{
+	double t0, t1;				// as in the chunk header
+	unsigned long long offset;	// of the chunk header in the .fdr
+};
+
+// The residual stored for one value, given the bit patterns of the two values before it. FDR_XOR is the XOR with the last value.
+// FDR_DELTA treats the bit patterns as integers & takes the difference from a straight line through the last two, so a value
+// that keeps changing at the same rate (simt, a door in motion, propellant at a steady burn) leaves only a byte or two. It is all
+// integer arithmetic, so the module & the tool always agree on the result whatever the compiler does with doubles.
+const int FDR_XOR = 0;
+const int FDR_DELTA = 1;
+
+inline unsigned long long FdrResidual (int mode, unsigned long long bits, unsigned long long b1, unsigned long long b2)
+{
+	if (mode == FDR_XOR) return bits ^ b1;
+	unsigned long long d = bits - (2*b1 - b2);	// wraps around, the same way when decoding
+	return (d << 1) ^ (0 - (d >> 63));			// zigzag, so a small negative difference stays small
+}
+
+inline unsigned long long FdrUnresidual (int mode, unsigned long long r, unsigned long long b1, unsigned long long b2)
+{
+	if (mode == FDR_XOR) return r ^ b1;
+	return ((r >> 1) ^ (0 - (r & 1))) + (2*b1 - b2);
+}
+
+// encodes n values into out with the given mode, returns the number of bytes used
+inline unsigned int FdrEncodeMode (int mode, const double *v, int n, unsigned char *out)
+{
+	unsigned char *count = out+1, *p = count + (n+1)/2;
+	unsigned long long b1 = 0, b2 = 0, bits, x;
+	out[0] = (unsigned char)mode;
+	memset (count, 0, (n+1)/2);
+	for (int i = 0; i < n; i++) {
+		memcpy (&bits, v+i, 8);
+		x = FdrResidual (mode, bits, b1, b2);
+		b2 = b1;
+		b1 = bits;
+		unsigned int nb = 0;
+		while (nb < 8 && (x >> (nb*8))) nb++;
+		count[i/2] |= (unsigned char)(nb << ((i&1)*4));
+		for (unsigned int b = 0; b < nb; b++)
+			*p++ = (unsigned char)(x >> (b*8));
+	}
+	return (unsigned int)(p-out);
+}
+
+// encodes n values into out with whichever mode comes out smaller, tmp must have room for FDR_MAXCOLBYTES as well
+inline unsigned int FdrEncodeColumn (const double *v, int n, unsigned char *out, unsigned char *tmp)
+{
+	unsigned int size = FdrEncodeMode (FDR_XOR, v, n, out);
+	unsigned int dsize = FdrEncodeMode (FDR_DELTA, v, n, tmp);
+	if (dsize < size) {
+		memcpy (out, tmp, dsize);
+		size = dsize;
+	}
+	return size;
+}
+
+// decodes n values from in, returns false if they dont fit in size bytes
+inline bool FdrDecodeColumn (const unsigned char *in, unsigned int size, int n, double *v)
+{
+	const unsigned char *count = in+1, *p = count + (n+1)/2, *end = in + size;
+	unsigned long long b1 = 0, b2 = 0, bits, x;
+	unsigned int b;
+	if (p > end || in[0] > FDR_DELTA) return false;
+	for (int i = 0; i < n; i++) {
+		unsigned int nb = (count[i/2] >> ((i&1)*4)) & 15;
+		if (nb > 8 || p+nb > end) return false;
+		for (x = 0, b = 0; b < nb; b++)
+			x |= (unsigned long long)*p++ << (b*8);
+		bits = FdrUnresidual (in[0], x, b1, b2);
+		b2 = b1;
+		b1 = bits;
+		memcpy (v+i, &bits, 8);
+	}
+	return true;
+}
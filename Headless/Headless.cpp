@@ -0,0 +1,697 @@
+//=========================================================
+// Headless
+// The stand-in SDK: windows.h on POSIX, the Orbiter API on the Headless world (see Headless.h), & the UMmu & UCGO classes on
+// plain lists. Built together with SHD.cpp & a driver, see SHDBench.cpp.
+//=========================================================
+
+#include <string>
+#include <map>
+#include "Headless.h"		// after the STL, like windows.h it defines min & max
+#include "UMmuSDK.h"
+#include "UCGOCargoSDK.h"
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//=========================================================
+// The world
+//=========================================================
+
+double Headless::simt = 0.0, Headless::simdt = 0.0;
+double Headless::dynp = 0.0;
+bool Headless::ground = true;
+VECTOR3 Headless::airspeed = {0.0, 0.0, 0.0};
+bool Headless::echoLog = false;
+long Headless::logLines = 0;
+char Headless::lastLog[512];
+char Headless::className[64] = "Shuttle-D";
+
+double Headless::Seconds ()
+{
+	timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// a cfg file, scenario or scenario being written
+struct HLFILE {
+	std::string text;
+	size_t pos;
+	bool output;
+	char line[1024];
+};
+
+FILEHANDLE Headless::OpenText (const char *text)
+{
+	HLFILE *f = new HLFILE;
+	f->text = text;
+	f->pos = 0;
+	f->output = false;
+	return f;
+}
+
+FILEHANDLE Headless::OpenFile (const char *path)
+{
+	FILE *in = fopen (path, "rb");
+	if (!in) return NULL;
+	HLFILE *f = new HLFILE;
+	f->pos = 0;
+	f->output = false;
+	char buf[4096];
+	size_t n;
+	while ((n = fread (buf, 1, sizeof(buf), in)) > 0)
+		f->text.append (buf, n);
+	fclose (in);
+	return f;
+}
+
+FILEHANDLE Headless::OpenOutput ()
+{
+	HLFILE *f = (HLFILE*)OpenText ("");
+	f->output = true;
+	return f;
+}
+
+const char *Headless::Text (FILEHANDLE f)
+{
+	return ((HLFILE*)f)->text.c_str();
+}
+
+void Headless::Rewind (FILEHANDLE file)
+{
+	HLFILE *f = (HLFILE*)file;
+	if (f->output) f->text.clear ();	// keeps its capacity, so saving again doesnt allocate
+	f->pos = 0;
+}
+
+void Headless::Close (FILEHANDLE f)
+{
+	delete (HLFILE*)f;
+}
+
+// the open input box, answered by AnswerInputBox
+static Input_clbk inputClbk = NULL;
+static void *inputData = NULL;
+
+bool Headless::AnswerInputBox (const char *answer)
+{
+	if (!inputClbk) return false;
+	Input_clbk clbk = inputClbk;
+	inputClbk = NULL;
+	if (answer) {
+		char buf[256];
+		strncpy (buf, answer, sizeof(buf)-1);
+		buf[sizeof(buf)-1] = 0;
+		if (!clbk (NULL, buf, inputData))
+			inputClbk = clbk;		// refused, the box stays open like Orbiter's
+	}
+	return true;
+}
+
+//=========================================================
+// windows.h
+//=========================================================
+
+BOOL QueryPerformanceCounter (LARGE_INTEGER *count)
+{
+	timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	count->QuadPart = (LONGLONG)ts.tv_sec*1000000000 + ts.tv_nsec;
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency (LARGE_INTEGER *freq)
+{
+	freq->QuadPart = 1000000000;
+	return TRUE;
+}
+
+void Sleep (DWORD ms)
+{
+	timespec ts = {(time_t)(ms/1000), (long)(ms%1000)*1000000};
+	nanosleep (&ts, NULL);
+}
+
+// every HANDLE is one of these
+struct HLHANDLE {
+	enum { THREAD, FILE, MAPPING } kind;
+	pthread_t thread;
+	LPTHREAD_START_ROUTINE start;
+	LPVOID param;
+	int fd;
+	size_t size;
+};
+
+static void *ThreadStart (void *arg)
+{
+	HLHANDLE *h = (HLHANDLE*)arg;
+	h->start (h->param);
+	return NULL;
+}
+
+HANDLE CreateThread (void *attr, size_t stack, LPTHREAD_START_ROUTINE start, LPVOID param, DWORD flags, DWORD *id)
+{
+	HLHANDLE *h = new HLHANDLE;
+	h->kind = HLHANDLE::THREAD;
+	h->start = start;
+	h->param = param;
+	if (pthread_create (&h->thread, NULL, ThreadStart, h)) {
+		delete h;
+		return NULL;
+	}
+	if (id) *id = 0;
+	return h;
+}
+
+DWORD WaitForSingleObject (HANDLE h, DWORD ms)
+{
+	pthread_join (((HLHANDLE*)h)->thread, NULL);
+	return 0;
+}
+
+BOOL CloseHandle (HANDLE handle)
+{
+	HLHANDLE *h = (HLHANDLE*)handle;
+	if (h->kind == HLHANDLE::FILE) close (h->fd);
+	delete h;
+	return TRUE;
+}
+
+HANDLE CreateFile (const char *path, DWORD access, DWORD share, void *sec, DWORD disp, DWORD flags, HANDLE tmpl)
+{
+	int fd = open (path, O_RDONLY);
+	struct stat st;
+	if (fd < 0) return INVALID_HANDLE_VALUE;
+	if (fstat (fd, &st)) {
+		close (fd);
+		return INVALID_HANDLE_VALUE;
+	}
+	HLHANDLE *h = new HLHANDLE;
+	h->kind = HLHANDLE::FILE;
+	h->fd = fd;
+	h->size = (size_t)st.st_size;
+	return h;
+}
+
+DWORD GetFileSize (HANDLE h, DWORD *high)
+{
+	if (high) *high = 0;
+	return (DWORD)((HLHANDLE*)h)->size;
+}
+
+HANDLE CreateFileMapping (HANDLE file, void *sec, DWORD protect, DWORD high, DWORD low, const char *name)
+{
+	HLHANDLE *h = new HLHANDLE (*(HLHANDLE*)file);
+	h->kind = HLHANDLE::MAPPING;	// the fd stays the file's
+	return h;
+}
+
+static std::map<const void*, size_t> views;
+
+void *MapViewOfFile (HANDLE map, DWORD access, DWORD high, DWORD low, size_t size)
+{
+	HLHANDLE *h = (HLHANDLE*)map;
+	if (!size) size = h->size;
+	void *view = mmap (NULL, size, PROT_READ, MAP_PRIVATE, h->fd, 0);
+	if (view == MAP_FAILED) return NULL;
+	views[view] = size;
+	return view;
+}
+
+BOOL UnmapViewOfFile (const void *view)
+{
+	std::map<const void*, size_t>::iterator it = views.find (view);
+	if (it == views.end()) return FALSE;
+	munmap ((void*)view, it->second);
+	views.erase (it);
+	return TRUE;
+}
+
+BOOL CreateDirectory (const char *path, void *sec)
+{
+	return TRUE;
+}
+
+//=========================================================
+// Orbiter API
+//=========================================================
+
+double oapiGetSimTime ()
+{
+	return Headless::simt;
+}
+
+void oapiWriteLog (const char *line)
+{
+	Headless::logLines++;
+	strncpy (Headless::lastLog, line, sizeof(Headless::lastLog)-1);
+	if (Headless::echoLog) fprintf (stderr, "%s\n", line);
+}
+
+double oapiGetInducedDrag (double cl, double A, double e)
+{
+	return cl*cl/(PI*A*e);
+}
+
+// the same shape as Orbiter's: nothing below M1, rising linearly to cmax at M2, flat to M3 & falling off after it
+double oapiGetWaveDrag (double M, double M1, double M2, double M3, double cmax)
+{
+	if (M < M1) return 0.0;
+	if (M < M2) return cmax*(M-M1)/(M2-M1);
+	if (M < M3) return cmax;
+	return cmax*sqrt ((M3*M3-1.0)/(M*M-1.0));
+}
+
+// the value of item in a cfg, which is the rest of its line without comments & the spaces around it
+static const char *FindItem (FILEHANDLE file, const char *item)
+{
+	HLFILE *f = (HLFILE*)file;
+	size_t len = strlen (item);
+	const char *p = f->text.c_str();
+	while (*p) {
+		const char *end = strchr (p, '\n');
+		if (!end) end = p+strlen (p);
+		const char *q = p;
+		while (*q == ' ' || *q == '\t') q++;
+		if (!_strnicmp (q, item, len)) {
+			q += len;
+			while (*q == ' ' || *q == '\t') q++;
+			if (*q == '=') {
+				for (q++; *q == ' ' || *q == '\t'; q++);
+				const char *e = q;
+				while (e < end && *e != ';' && *e != '\r') e++;
+				while (e > q && (e[-1] == ' ' || e[-1] == '\t')) e--;
+				size_t n = min ((size_t)(e-q), sizeof(f->line)-1);
+				memcpy (f->line, q, n);
+				f->line[n] = 0;
+				return f->line;
+			}
+		}
+		p = *end ? end+1 : end;
+	}
+	return NULL;
+}
+
+bool oapiReadItem_string (FILEHANDLE f, const char *item, char *string)
+{
+	const char *value = FindItem (f, item);
+	if (!value) return false;
+	strcpy (string, value);
+	return true;
+}
+
+bool oapiReadItem_int (FILEHANDLE f, const char *item, int &val)
+{
+	const char *value = FindItem (f, item);
+	return value && sscanf (value, "%d", &val) == 1;
+}
+
+bool oapiReadItem_bool (FILEHANDLE f, const char *item, bool &val)
+{
+	const char *value = FindItem (f, item);
+	if (!value) return false;
+	if (!_stricmp (value, "TRUE")) val = true;
+	else if (!_stricmp (value, "FALSE")) val = false;
+	else return false;
+	return true;
+}
+
+// the next line, with the leading spaces taken off, up to END like Orbiter's
+bool oapiReadScenario_nextline (FILEHANDLE file, char *&line)
+{
+	HLFILE *f = (HLFILE*)file;
+	for (;;) {
+		if (f->pos >= f->text.size()) return false;
+		size_t end = f->text.find ('\n', f->pos);
+		if (end == std::string::npos) end = f->text.size();
+		size_t start = f->pos;
+		f->pos = end+1;
+		while (start < end && (f->text[start] == ' ' || f->text[start] == '\t')) start++;
+		while (end > start && (f->text[end-1] == '\r' || f->text[end-1] == ' ')) end--;
+		if (start == end) continue;
+		size_t n = min (end-start, sizeof(f->line)-1);
+		memcpy (f->line, f->text.c_str()+start, n);
+		f->line[n] = 0;
+		if (!_stricmp (f->line, "END")) return false;
+		line = f->line;
+		return true;
+	}
+}
+
+void oapiWriteScenario_string (FILEHANDLE scn, char *item, char *string)
+{
+	std::string &text = ((HLFILE*)scn)->text;
+	text += "  ";
+	text += item;
+	text += ' ';
+	text += string;
+	text += '\n';
+}
+
+void oapiOpenInputBox (char *title, Input_clbk clbk, char *buf, int vislen, void *usrdata)
+{
+	inputClbk = clbk;
+	inputData = usrdata;
+}
+
+// handles only have to be something other than NULL
+static char dummy[16];
+
+MESHHANDLE oapiLoadMeshGlobal (const char *fname) { return dummy; }
+SURFHANDLE oapiRegisterExhaustTexture (const char *name) { return dummy; }
+SURFHANDLE oapiGetTextureHandle (MESHHANDLE hMesh, int texidx) { return dummy; }
+SURFHANDLE oapiCreateSurface (int width, int height) { return dummy; }
+void oapiDestroySurface (SURFHANDLE surf) {}
+void oapiClearSurface (SURFHANDLE surf, DWORD col) {}
+HDC oapiGetDC (SURFHANDLE surf) { return dummy; }
+void oapiReleaseDC (SURFHANDLE surf, HDC hDC) {}
+void oapiBlt (SURFHANDLE tgt, SURFHANDLE src, int tgtx, int tgty, int srcx, int srcy, int w, int h, DWORD ck) {}
+void oapiVCRegisterMFD (int mfd, const VCMFDSPEC *spec) {}
+void oapiVCRegisterHUD (const VCHUDSPEC *spec) {}
+void oapiVCRegisterArea (int id, int draw_event, int mouse_event) {}
+void oapiVCRegisterArea (int id, const RECT_ &tgtrect, int draw_event, int mouse_event, int bkmode, SURFHANDLE tgt) {}
+void oapiVCSetAreaClickmode_Spherical (int id, const VECTOR3 &cnt, double rad) {}
+void oapiVCSetNeighbours (int left, int right, int top, int bottom) {}
+void oapiVCTriggerRedrawArea (int vc_id, int area_id) {}
+const char *oapiMFDButtonLabel (int mfd, int bt) { return bt < 6 ? "MOD" : NULL; }
+bool oapiProcessMFDButton (int mfd, int bt, int event) { return true; }
+void oapiToggleMFD_on (int mfd) {}
+bool oapiSendMFDKey (int mfd, DWORD key) { return true; }
+
+//=========================================================
+// VESSEL
+//=========================================================
+
+VESSEL::VESSEL (OBJHANDLE hVessel, int fmodel)
+{
+	hl_handle = hVessel;
+	strcpy (hl_class, Headless::className);
+	hl_emptymass = 0.0;
+	hl_nprop = hl_nthruster = hl_nanim = 0;
+	hl_corelines = 0;
+}
+
+OBJHANDLE VESSEL::GetHandle () const { return hl_handle; }
+char *VESSEL::GetName () const { return (char*)hl_handle; }
+char *VESSEL::GetClassName () const { return (char*)hl_class; }
+
+void VESSEL::SetEmptyMass (double m) const { hl_emptymass = m; }
+void VESSEL::SetPMI (const VECTOR3 &pmi) const {}
+void VESSEL::SetCrossSections (const VECTOR3 &cs) const {}
+void VESSEL::SetSize (double size) const {}
+void VESSEL::SetSurfaceFrictionCoeff (double mu_lng, double mu_lat) const {}
+void VESSEL::SetRotDrag (const VECTOR3 &rd) const {}
+bool VESSEL::EnableTransponder (bool enable) { return true; }
+void VESSEL::InitNavRadios (DWORD nnav) const {}
+void VESSEL::SetAlbedoRGB (const VECTOR3 &albedo) const {}
+void VESSEL::SetTouchdownPoints (const VECTOR3 &pt1, const VECTOR3 &pt2, const VECTOR3 &pt3) const {}
+DOCKHANDLE VESSEL::CreateDock (const VECTOR3 &pos, const VECTOR3 &dir, const VECTOR3 &rot) const { return dummy; }
+void VESSEL::ClearAirfoilDefinitions () const {}
+void *VESSEL::CreateAirfoil (AIRFOIL_ORIENTATION align, const VECTOR3 &ref, AirfoilCoeffFunc cf, double c, double S, double A) const
+{
+	return dummy;
+}
+
+double VESSEL::GetMass () const
+{
+	double m = hl_emptymass;
+	for (int i = 0; i < hl_nprop; i++)
+		m += hl_propmass[i];
+	return m;
+}
+
+PROPELLANT_HANDLE VESSEL::CreatePropellantResource (double maxmass, double mass, double efficiency) const
+{
+	if (hl_nprop == HL_MAX_PROPELLANT) return NULL;
+	hl_propmax[hl_nprop] = maxmass;
+	hl_propmass[hl_nprop] = mass < 0.0 ? maxmass : mass;
+	return (PROPELLANT_HANDLE)(long)++hl_nprop;
+}
+
+double VESSEL::GetPropellantMass (PROPELLANT_HANDLE ph) const
+{
+	return ph ? hl_propmass[(long)ph-1] : 0.0;
+}
+
+void VESSEL::SetPropellantMass (PROPELLANT_HANDLE ph, double mass) const
+{
+	if (ph) hl_propmass[(long)ph-1] = max (0.0, min (mass, hl_propmax[(long)ph-1]));
+}
+
+THRUSTER_HANDLE VESSEL::CreateThruster (const VECTOR3 &pos, const VECTOR3 &dir, double maxth0, PROPELLANT_HANDLE hp,
+	double isp0, double isp_ref, double p_ref) const
+{
+	if (hl_nthruster == HL_MAX_THRUSTER) return NULL;
+	hl_thlevel[hl_nthruster] = 0.0;
+	return (THRUSTER_HANDLE)(long)++hl_nthruster;
+}
+
+void VESSEL::CreateThrusterGroup (THRUSTER_HANDLE *th, int nth, THGROUP_TYPE thgt) const {}
+
+double VESSEL::GetThrusterLevel (THRUSTER_HANDLE th) const
+{
+	return th ? hl_thlevel[(long)th-1] : 0.0;
+}
+
+void VESSEL::SetThrusterLevel (THRUSTER_HANDLE th, double level) const
+{
+	if (th) hl_thlevel[(long)th-1] = level;
+}
+
+void VESSEL::AddExhaust (THRUSTER_HANDLE th, double lscale, double wscale, const VECTOR3 &pos, const VECTOR3 &dir, SURFHANDLE tex) const {}
+void VESSEL::AddExhaustStream (THRUSTER_HANDLE th, const VECTOR3 &pos, PARTICLESTREAMSPEC *pss) const {}
+
+UINT VESSEL::AddMesh (const char *meshname, const VECTOR3 *ofs) const { return 0; }
+UINT VESSEL::AddMesh (MESHHANDLE hMesh, const VECTOR3 *ofs) const { return 0; }
+void VESSEL::SetMeshVisibilityMode (UINT idx, int mode) const {}
+
+UINT VESSEL::CreateAnimation (double initial_state) const
+{
+	if (hl_nanim == HL_MAX_ANIMATION) return 0;
+	hl_anim[hl_nanim] = initial_state;
+	return hl_nanim++;
+}
+
+ANIMATIONCOMPONENT_HANDLE VESSEL::AddAnimationComponent (UINT anim, double state0, double state1, MGROUP_ROTATE *trans,
+	ANIMATIONCOMPONENT_HANDLE parent)
+{
+	return dummy;
+}
+
+bool VESSEL::SetAnimation (UINT anim, double state) const
+{
+	if (anim >= (UINT)hl_nanim) return false;
+	hl_anim[anim] = state;
+	return true;
+}
+
+void VESSEL::SetCameraOffset (const VECTOR3 &co) const {}
+void VESSEL::SetCameraDefaultDirection (const VECTOR3 &cd) const {}
+void VESSEL::SetCameraRotationRange (double left, double right, double up, double down) const {}
+void VESSEL::SetCameraShiftRange (const VECTOR3 &fpos, const VECTOR3 &lpos, const VECTOR3 &rpos) const {}
+
+bool VESSEL::GroundContact () const { return Headless::ground; }
+double VESSEL::GetDynPressure () const { return Headless::dynp; }
+void VESSEL::GetHorizonAirspeedVector (VECTOR3 &v) const { v = Headless::airspeed; }
+
+bool VESSEL::ParseScenarioLineEx (char *line, void *status) const
+{
+	hl_corelines++;
+	return true;
+}
+
+//=========================================================
+// UMmu
+// Saved as UMMU_CREW name;miscid;age;pulse;weight. The lines are taken apart by hand rather than with sscanf, so the time spent
+// in here doesnt swamp the vessel's own share of a scenario load.
+//=========================================================
+
+UMMUCREWMANAGMENT::UMMUCREWMANAGMENT ()
+{
+	ncrew = 0;
+	seats = HL_MAX_CREW;
+	airlock = FALSE;
+	lastEva[0] = 0;
+}
+
+int UMMUCREWMANAGMENT::InitUmmu (OBJHANDLE hVessel)
+{
+	ncrew = 0;
+	return 1;
+}
+
+float UMMUCREWMANAGMENT::GetUserUMmuVersion ()
+{
+	return 2.0f;
+}
+
+void UMMUCREWMANAGMENT::SetMaxSeatAvailableInShip (int n)
+{
+	seats = min (n, HL_MAX_CREW);
+}
+
+int UMMUCREWMANAGMENT::AddCrewMember (char *name, int age, int pulse, int weight, char *miscid)
+{
+	if (ncrew >= seats || !name || !*name) return FALSE;
+	Member &m = crew[ncrew++];
+	strncpy (m.name, name, sizeof(m.name)-1);
+	m.name[sizeof(m.name)-1] = 0;
+	strncpy (m.miscid, miscid ? miscid : "", sizeof(m.miscid)-1);
+	m.miscid[sizeof(m.miscid)-1] = 0;
+	m.age = age;
+	m.pulse = pulse;
+	m.weight = weight;
+	return TRUE;
+}
+
+int UMMUCREWMANAGMENT::EvaCrewMember (char *name)
+{
+	if (!airlock) return ERROR_AIRLOCK_CLOSED;
+	for (int i = 0; i < ncrew; i++)
+		if (!strcmp (crew[i].name, name)) {
+			strcpy (lastEva, crew[i].name);
+			crew[i] = crew[--ncrew];
+			return EVA_OK;
+		}
+	return ERROR_CREW_MEMBER_NOT_FOUND;
+}
+
+char *UMMUCREWMANAGMENT::GetCrewNameBySlotNumber (int slot)
+{
+	return slot >= 0 && slot < ncrew ? crew[slot].name : (char*)"";
+}
+
+char *UMMUCREWMANAGMENT::GetCrewMiscIdBySlotNumber (int slot)
+{
+	return slot >= 0 && slot < ncrew ? crew[slot].miscid : (char*)"";
+}
+
+char *UMMUCREWMANAGMENT::GetCrewMiscIdByName (char *name)
+{
+	for (int i = 0; i < ncrew; i++)
+		if (!strcmp (crew[i].name, name)) return crew[i].miscid;
+	return (char*)"";
+}
+
+int UMMUCREWMANAGMENT::GetCrewAgeBySlotNumber (int slot)
+{
+	return slot >= 0 && slot < ncrew ? crew[slot].age : -1;
+}
+
+float UMMUCREWMANAGMENT::GetCrewWeightBySlotNumber (int slot)
+{
+	return slot >= 0 && slot < ncrew ? (float)crew[slot].weight : -1.0f;
+}
+
+void UMMUCREWMANAGMENT::SetCrewMemberPulseBySlotNumber (int slot, int pulse)
+{
+	if (slot >= 0 && slot < ncrew) crew[slot].pulse = pulse;
+}
+
+BOOL UMMUCREWMANAGMENT::LoadAllMembersFromOrbiterScenario (char *line)
+{
+	if (_strnicmp (line, "UMMU_CREW ", 10)) return FALSE;
+	char name[40], miscid[8];
+	const char *p = line+10, *q = strchr (p, ';');
+	if (!q || q-p >= (long)sizeof(name)) return TRUE;
+	memcpy (name, p, q-p);
+	name[q-p] = 0;
+	p = q+1;
+	if (!(q = strchr (p, ';')) || q-p >= (long)sizeof(miscid)) return TRUE;
+	memcpy (miscid, p, q-p);
+	miscid[q-p] = 0;
+	char *end;
+	int age = (int)strtol (q+1, &end, 10);
+	int pulse = (int)strtol (end+1, &end, 10);
+	int weight = (int)strtol (end+1, &end, 10);
+	AddCrewMember (name, age, pulse, weight, miscid);
+	return TRUE;
+}
+
+void UMMUCREWMANAGMENT::SaveAllMembersInOrbiterScenarios (FILEHANDLE scn)
+{
+	char buf[128];
+	for (int i = 0; i < ncrew; i++) {
+		sprintf (buf, "%s;%s;%d;%d;%d", crew[i].name, crew[i].miscid, crew[i].age, crew[i].pulse, crew[i].weight);
+		oapiWriteScenario_string (scn, (char*)"UMMU_CREW", buf);
+	}
+}
+
+//=========================================================
+// UCGO
+// Saved as UCGO_SLOT slot mass
+//=========================================================
+
+UCGO::UCGO ()
+{
+	nslot = 0;
+	for (int i = 0; i < HL_MAX_SLOT; i++) mass[i] = 0.0;
+}
+
+void UCGO::DeclareCargoSlot (int slot, VECTOR3 pos, VECTOR3 rot)
+{
+	if (slot >= 0 && slot < HL_MAX_SLOT && slot >= nslot) nslot = slot+1;
+}
+
+BOOL UCGO::ReleaseOneCargo (int slot)
+{
+	if (slot < 0) {
+		for (slot = nslot-1; slot >= 0 && mass[slot] == 0.0; slot--);
+		if (slot < 0) return FALSE;
+	}
+	if (slot >= nslot || mass[slot] == 0.0) return FALSE;
+	mass[slot] = 0.0;
+	return TRUE;
+}
+
+double UCGO::GetCargoTotalMass ()
+{
+	double m = 0.0;
+	for (int i = 0; i < nslot; i++) m += mass[i];
+	return m;
+}
+
+int UCGO::GetNbrCargoLoaded ()
+{
+	int n = 0;
+	for (int i = 0; i < nslot; i++) n += mass[i] > 0.0;
+	return n;
+}
+
+double UCGO::GetCargoSlotMass (int slot)
+{
+	return slot >= 0 && slot < nslot ? mass[slot] : -1.0;
+}
+
+BOOL UCGO::ScnEditor_AddLastSelectedCargoToSlot (int slot)
+{
+	if (slot < 0 || slot >= nslot || mass[slot] > 0.0) return FALSE;
+	mass[slot] = 1000.0;
+	return TRUE;
+}
+
+BOOL UCGO::LoadCargoFromScenario (char *line)
+{
+	if (_strnicmp (line, "UCGO_SLOT ", 10)) return FALSE;
+	char *end;
+	int slot = (int)strtol (line+10, &end, 10);
+	double m = strtod (end, NULL);
+	if (slot >= 0 && slot < HL_MAX_SLOT) {
+		mass[slot] = m;
+		if (slot >= nslot) nslot = slot+1;
+	}
+	return TRUE;
+}
+
+void UCGO::SaveCargoToScenario (FILEHANDLE scn)
+{
+	char buf[64];
+	for (int i = 0; i < nslot; i++)
+		if (mass[i] > 0.0) {
+			sprintf (buf, "%d %.17g", i, mass[i]);
+			oapiWriteScenario_string (scn, (char*)"UCGO_SLOT", buf);
+		}
+}
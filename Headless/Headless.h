@@ -0,0 +1,38 @@
+//=========================================================
+// Headless
+// What the vessel sees of the world when it runs without Orbiter, & the few things a driver needs to feed it. The driver sets
+// simt & simdt before each step & whatever flight state it wants the vessel to react to. Cfg files & scenarios are text in
+// memory: OpenText reads from a string (a whole file with OpenFile), OpenOutput collects what clbkSaveState writes so Text can
+// hand it back. The OBJHANDLE given to ovcInit is simply the vessel's name, which is what GetName returns.
+//=========================================================
+
+#ifndef __HEADLESS_H
+#define __HEADLESS_H
+
+#include "Orbitersdk.h"
+
+namespace Headless {
+	extern double simt, simdt;		// sim time & step, simt is what oapiGetSimTime returns
+	extern double dynp;				// dynamic pressure, Pa
+	extern bool ground;				// GroundContact
+	extern VECTOR3 airspeed;		// horizon airspeed vector, m/s
+	extern bool echoLog;			// copy oapiWriteLog lines to stderr
+	extern long logLines;			// lines written to the log so far
+	extern char lastLog[512];		// & the last of them
+	extern char className[64];		// what GetClassName returns for the vessels created from now on
+
+	FILEHANDLE OpenText (const char *text);
+	FILEHANDLE OpenFile (const char *path);		// NULL if it cant be read
+	FILEHANDLE OpenOutput ();
+	const char *Text (FILEHANDLE f);			// what has been written to an output so far
+	void Rewind (FILEHANDLE f);					// reads from the start again, or empties an output
+	void Close (FILEHANDLE f);
+
+	// Orbiter answers an input box some frames after it opens, so here the driver does it between steps. Returns false if
+	// none is open; answer NULL is the escape key.
+	bool AnswerInputBox (const char *answer);
+
+	double Seconds ();						// wall clock, for timing
+}
+
+#endif // !__HEADLESS_H
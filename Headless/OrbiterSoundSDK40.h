@@ -0,0 +1,33 @@
+//=========================================================
+// Headless stand-in for OrbiterSoundSDK40.h
+// There is no sound. ConnectToOrbiterSoundDLL hands out an id so the vessel behaves as if OrbiterSound was installed, & the
+// rest just say yes.
+//=========================================================
+
+#ifndef __HEADLESS_ORBITERSOUNDSDK40_H
+#define __HEADLESS_ORBITERSOUNDSDK40_H
+
+#define INTERNAL_ONLY 1
+#define REPLACE_MAIN_THRUST 1
+#define REPLACE_RCS_THRUST_ATTACK 2
+#define REPLACE_RCS_THRUST_SUSTAIN 3
+#define REPLACE_AIR_CONDITIONNING 4
+#define REPLACE_COCKPIT_AMBIENCE_1 5
+#define REPLACE_COCKPIT_AMBIENCE_2 6
+#define REPLACE_COCKPIT_AMBIENCE_3 7
+#define REPLACE_COCKPIT_AMBIENCE_4 8
+#define REPLACE_COCKPIT_AMBIENCE_5 9
+#define REPLACE_COCKPIT_AMBIENCE_6 10
+#define REPLACE_COCKPIT_AMBIENCE_7 11
+#define REPLACE_COCKPIT_AMBIENCE_8 12
+#define REPLACE_COCKPIT_AMBIENCE_9 13
+#define PLAYRADIOATC 1
+
+inline int ConnectToOrbiterSoundDLL (OBJHANDLE hVessel) { return 1; }
+inline BOOL SetMyDefaultWaveDirectory (const char *dir) { return TRUE; }
+inline BOOL RequestLoadVesselWave (int id, int wav, const char *file, int type) { return TRUE; }
+inline BOOL ReplaceStockSound (int id, const char *file, int which) { return TRUE; }
+inline BOOL SoundOptionOnOff (int id, int option, BOOL on) { return TRUE; }
+inline BOOL PlayVesselWave (int id, int wav, int loop = 0, int vol = 255, int freq = 0) { return TRUE; }
+
+#endif // !__HEADLESS_ORBITERSOUNDSDK40_H
@@ -0,0 +1,366 @@
+//=========================================================
+// Headless stand-in for the Orbiter SDK
+// Just enough of Orbitersdk.h (& the bits of windows.h it drags in) for SHD.cpp to compile & run on Linux without Orbiter, so
+// the real vessel code can be stepped, timed & looked at with perf or valgrind. Nothing here simulates any physics: the vessel
+// sees whatever the driver puts into Headless (see Headless.h), its thrusters & propellants are just numbers kept for it, & the
+// drawing calls do nothing. Only what SHD.cpp actually uses is declared, with the same names & arguments as the real SDK, so if
+// SHD.cpp starts using something new the headless build is where it shows up first. The key codes are the exception, they are all
+// there. See SHDBench.cpp for how to build it.
+//=========================================================
+
+#ifndef __HEADLESS_ORBITERSDK_H
+#define __HEADLESS_ORBITERSDK_H
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+
+//=========================================================
+// windows.h
+// The types keep their Windows names, but DWORD & LONG are longs, so they are 64 bit here instead of 32. Nothing in SHD.cpp
+// depends on the size, only snapshot files written by a headless build cant be read by the real one & the other way round.
+//=========================================================
+
+typedef unsigned long DWORD;
+typedef long LONG;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef long long LONGLONG;
+typedef void *LPVOID;
+typedef void *HANDLE;
+typedef void *HINSTANCE;
+typedef void *HDC;
+typedef void *HFONT;
+typedef void *HPEN;
+typedef void *HBRUSH;
+typedef union { struct { DWORD LowPart; LONG HighPart; }; LONGLONG QuadPart; } LARGE_INTEGER;
+typedef struct { LONG cx, cy; } SIZE;
+
+#define TRUE 1
+#define FALSE 0
+#define WINAPI
+#define INFINITE 0xFFFFFFFF
+#define max(a,b) (((a) > (b)) ? (a) : (b))
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#define _vsnprintf vsnprintf
+#define RGB(r,g,b) ((DWORD)(((r)|((g)<<8))|((b)<<16)))
+
+// the timer, from clock_gettime
+BOOL QueryPerformanceCounter (LARGE_INTEGER *count);
+BOOL QueryPerformanceFrequency (LARGE_INTEGER *freq);
+
+// threads, on pthreads. The handle of a thread is only good for one WaitForSingleObject.
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE) (LPVOID);
+HANDLE CreateThread (void *attr, size_t stack, LPTHREAD_START_ROUTINE start, LPVOID param, DWORD flags, DWORD *id);
+DWORD WaitForSingleObject (HANDLE h, DWORD ms);
+void Sleep (DWORD ms);
+inline LONG InterlockedExchange (volatile LONG *target, LONG value) { __sync_synchronize (); return __sync_lock_test_and_set (target, value); }
+inline LONG InterlockedIncrement (volatile LONG *target) { return __sync_add_and_fetch (target, 1); }
+
+// read only file mapping, on open & mmap
+#define INVALID_HANDLE_VALUE ((HANDLE)(long)-1)
+#define GENERIC_READ 0x80000000
+#define FILE_SHARE_READ 1
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+HANDLE CreateFile (const char *path, DWORD access, DWORD share, void *sec, DWORD disp, DWORD flags, HANDLE tmpl);
+DWORD GetFileSize (HANDLE h, DWORD *high);
+HANDLE CreateFileMapping (HANDLE h, void *sec, DWORD protect, DWORD high, DWORD low, const char *name);
+void *MapViewOfFile (HANDLE map, DWORD access, DWORD high, DWORD low, size_t size);
+BOOL UnmapViewOfFile (const void *view);
+BOOL CloseHandle (HANDLE h);
+BOOL CreateDirectory (const char *path, void *sec);	// does nothing, the "\\" paths end up as plain file names
+
+// GDI, none of which draws anything
+#define PS_SOLID 0
+#define TRANSPARENT 1
+inline HFONT CreateFont (int, int, int, int, int, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, const char*) { return NULL; }
+inline HPEN CreatePen (int, int, DWORD) { return NULL; }
+inline HBRUSH CreateSolidBrush (DWORD) { return NULL; }
+inline BOOL DeleteObject (void*) { return TRUE; }
+inline void *SelectObject (HDC, void*) { return NULL; }
+inline DWORD SetTextColor (HDC, DWORD) { return 0; }
+inline int SetBkMode (HDC, int) { return 0; }
+inline BOOL TextOut (HDC, int, int, const char*, int) { return TRUE; }
+inline BOOL GetTextExtentPoint32 (HDC, const char*, int n, SIZE *size) { size->cx = 8*n; size->cy = 16; return TRUE; }
+
+//=========================================================
+// Orbiter API
+//=========================================================
+
+#define DLLCLBK extern "C"
+#define OAPIFUNC
+
+const double PI = 3.14159265358979323846;
+const double RAD = PI/180.0;
+const double DEG = 180.0/PI;
+
+typedef struct { double x, y, z; } VECTOR3;
+inline VECTOR3 _V (double x, double y, double z) { VECTOR3 v = {x, y, z}; return v; }
+inline VECTOR3 operator+ (const VECTOR3 &a, const VECTOR3 &b) { return _V (a.x+b.x, a.y+b.y, a.z+b.z); }
+inline VECTOR3 operator- (const VECTOR3 &a, const VECTOR3 &b) { return _V (a.x-b.x, a.y-b.y, a.z-b.z); }
+inline VECTOR3 operator* (const VECTOR3 &a, double f) { return _V (a.x*f, a.y*f, a.z*f); }
+inline VECTOR3 operator/ (const VECTOR3 &a, double f) { return _V (a.x/f, a.y/f, a.z/f); }
+inline VECTOR3 &operator+= (VECTOR3 &a, const VECTOR3 &b) { a.x += b.x; a.y += b.y; a.z += b.z; return a; }
+inline double dotp (const VECTOR3 &a, const VECTOR3 &b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+inline VECTOR3 crossp (const VECTOR3 &a, const VECTOR3 &b) { return _V (a.y*b.z-b.y*a.z, a.z*b.x-b.z*a.x, a.x*b.y-b.x*a.y); }
+inline double length (const VECTOR3 &a) { return sqrt (dotp (a, a)); }
+
+typedef struct { int left, top, right, bottom; } RECT_;
+inline RECT_ _R (int left, int top, int right, int bottom) { RECT_ r = {left, top, right, bottom}; return r; }
+
+typedef void *OBJHANDLE;
+typedef void *MESHHANDLE;
+typedef void *FILEHANDLE;
+typedef void *VISHANDLE;
+typedef void *SURFHANDLE;
+typedef void *PROPELLANT_HANDLE;
+typedef void *THRUSTER_HANDLE;
+typedef void *DOCKHANDLE;
+typedef void *ANIMATIONCOMPONENT_HANDLE;
+
+struct HUDPAINTSPEC { int W, H, CX, CY; double Scale, Markersize; };
+struct VCMFDSPEC { DWORD nmesh, ngroup; };
+struct VCHUDSPEC { DWORD nmesh, ngroup; VECTOR3 hudcnt; double size; };
+
+namespace oapi {
+	class Sketchpad {
+	public:
+		bool Text (int, int, const char*, int) { return true; }
+		DWORD SetTextColor (DWORD col) { return col; }
+	};
+}
+
+struct MGROUP_ROTATE {
+	MGROUP_ROTATE (UINT mesh, UINT *grp, UINT ngrp, const VECTOR3 &ref, const VECTOR3 &axis, float angle) {}
+};
+
+struct PARTICLESTREAMSPEC {
+	DWORD flags;
+	double srcsize, srcrate, v0, srcspread, lifetime, growthrate, atmslowdown;
+	enum LTYPE { EMISSIVE, DIFFUSE } ltype;
+	enum LEVELMAP { LVL_FLAT, LVL_LIN, LVL_SQRT, LVL_PLIN, LVL_PSQRT } levelmap;
+	double lmin, lmax;
+	enum ATMSMAP { ATM_FLAT, ATM_PLIN, ATM_PLOG } atmsmap;
+	double amin, amax;
+	SURFHANDLE tex;
+};
+
+enum THGROUP_TYPE {
+	THGROUP_MAIN, THGROUP_RETRO, THGROUP_HOVER,
+	THGROUP_ATT_PITCHUP, THGROUP_ATT_PITCHDOWN, THGROUP_ATT_YAWLEFT, THGROUP_ATT_YAWRIGHT, THGROUP_ATT_BANKLEFT,
+	THGROUP_ATT_BANKRIGHT, THGROUP_ATT_RIGHT, THGROUP_ATT_LEFT, THGROUP_ATT_UP, THGROUP_ATT_DOWN, THGROUP_ATT_FORWARD,
+	THGROUP_ATT_BACK
+};
+enum AIRFOIL_ORIENTATION { LIFT_VERTICAL, LIFT_HORIZONTAL };
+typedef void (*AirfoilCoeffFunc) (double aoa, double M, double Re, double *cl, double *cm, double *cd);
+
+#define MESHVIS_VC 4
+#define MFD_LEFT 0
+#define MFD_RIGHT 1
+#define PANEL_REDRAW_NEVER 0x00
+#define PANEL_REDRAW_USER 0x01
+#define PANEL_MOUSE_IGNORE 0x00
+#define PANEL_MOUSE_LBDOWN 0x01
+#define PANEL_MAP_BACKGROUND 0x03
+
+// keyboard, DirectInput scan codes as in the real SDK
+#define OAPI_KEY_1 0x02
+#define OAPI_KEY_2 0x03
+#define OAPI_KEY_3 0x04
+#define OAPI_KEY_4 0x05
+#define OAPI_KEY_5 0x06
+#define OAPI_KEY_6 0x07
+#define OAPI_KEY_7 0x08
+#define OAPI_KEY_8 0x09
+#define OAPI_KEY_9 0x0A
+#define OAPI_KEY_0 0x0B
+#define OAPI_KEY_Q 0x10
+#define OAPI_KEY_W 0x11
+#define OAPI_KEY_E 0x12
+#define OAPI_KEY_R 0x13
+#define OAPI_KEY_T 0x14
+#define OAPI_KEY_Y 0x15
+#define OAPI_KEY_U 0x16
+#define OAPI_KEY_I 0x17
+#define OAPI_KEY_O 0x18
+#define OAPI_KEY_P 0x19
+#define OAPI_KEY_LCONTROL 0x1D
+#define OAPI_KEY_A 0x1E
+#define OAPI_KEY_S 0x1F
+#define OAPI_KEY_D 0x20
+#define OAPI_KEY_F 0x21
+#define OAPI_KEY_G 0x22
+#define OAPI_KEY_H 0x23
+#define OAPI_KEY_J 0x24
+#define OAPI_KEY_K 0x25
+#define OAPI_KEY_L 0x26
+#define OAPI_KEY_GRAVE 0x29
+#define OAPI_KEY_LSHIFT 0x2A
+#define OAPI_KEY_Z 0x2C
+#define OAPI_KEY_X 0x2D
+#define OAPI_KEY_C 0x2E
+#define OAPI_KEY_V 0x2F
+#define OAPI_KEY_B 0x30
+#define OAPI_KEY_N 0x31
+#define OAPI_KEY_M 0x32
+#define OAPI_KEY_RSHIFT 0x36
+#define OAPI_KEY_F1 0x3B
+#define OAPI_KEY_F2 0x3C
+#define OAPI_KEY_F3 0x3D
+#define OAPI_KEY_F4 0x3E
+#define OAPI_KEY_F5 0x3F
+#define OAPI_KEY_F6 0x40
+#define OAPI_KEY_F7 0x41
+#define OAPI_KEY_F8 0x42
+#define OAPI_KEY_F9 0x43
+#define OAPI_KEY_F10 0x44
+#define OAPI_KEY_F11 0x57
+#define OAPI_KEY_F12 0x58
+#define OAPI_KEY_RCONTROL 0x9D
+#define KEYDOWN(buf,key) (buf[key] & 0x80)
+#define KEYMOD_SHIFT(buf) (KEYDOWN(buf,OAPI_KEY_LSHIFT) || KEYDOWN(buf,OAPI_KEY_RSHIFT))
+#define KEYMOD_CONTROL(buf) (KEYDOWN(buf,OAPI_KEY_LCONTROL) || KEYDOWN(buf,OAPI_KEY_RCONTROL))
+
+// the module
+double oapiGetSimTime ();
+void oapiWriteLog (const char *line);		// char* in the SDK, which MSVC lets a string literal go to
+double oapiGetInducedDrag (double cl, double A, double e);
+double oapiGetWaveDrag (double M, double M1, double M2, double M3, double cmax);
+
+// files: cfg items & scenario lines come out of text held by the driver, see Headless.h
+bool oapiReadItem_string (FILEHANDLE f, const char *item, char *string);
+bool oapiReadItem_int (FILEHANDLE f, const char *item, int &val);
+bool oapiReadItem_bool (FILEHANDLE f, const char *item, bool &val);
+bool oapiReadScenario_nextline (FILEHANDLE scn, char *&line);
+void oapiWriteScenario_string (FILEHANDLE scn, char *item, char *string);
+typedef bool (*Input_clbk) (void *id, char *str, void *usrdata);
+void oapiOpenInputBox (char *title, Input_clbk clbk, char *buf = 0, int vislen = 20, void *usrdata = 0);
+
+// meshes, surfaces & the virtual cockpit, all of which only hand out handles
+MESHHANDLE oapiLoadMeshGlobal (const char *fname);
+SURFHANDLE oapiRegisterExhaustTexture (const char *name);
+SURFHANDLE oapiGetTextureHandle (MESHHANDLE hMesh, int texidx);
+SURFHANDLE oapiCreateSurface (int width, int height);
+void oapiDestroySurface (SURFHANDLE surf);
+void oapiClearSurface (SURFHANDLE surf, DWORD col = 0);
+HDC oapiGetDC (SURFHANDLE surf);
+void oapiReleaseDC (SURFHANDLE surf, HDC hDC);
+void oapiBlt (SURFHANDLE tgt, SURFHANDLE src, int tgtx, int tgty, int srcx, int srcy, int w, int h, DWORD ck = 0);
+void oapiVCRegisterMFD (int mfd, const VCMFDSPEC *spec);
+void oapiVCRegisterHUD (const VCHUDSPEC *spec);
+void oapiVCRegisterArea (int id, int draw_event, int mouse_event);
+void oapiVCRegisterArea (int id, const RECT_ &tgtrect, int draw_event, int mouse_event, int bkmode, SURFHANDLE tgt);
+void oapiVCSetAreaClickmode_Spherical (int id, const VECTOR3 &cnt, double rad);
+void oapiVCSetNeighbours (int left, int right, int top, int bottom);
+void oapiVCTriggerRedrawArea (int vc_id, int area_id);
+const char *oapiMFDButtonLabel (int mfd, int bt);
+bool oapiProcessMFDButton (int mfd, int bt, int event);
+void oapiToggleMFD_on (int mfd);
+bool oapiSendMFDKey (int mfd, DWORD key);
+
+//=========================================================
+// VESSEL
+// Keeps what the vessel tells it (masses, propellants, thruster levels, animation states) so it can be given back. Handles are
+// 1-based indices into the arrays below.
+//=========================================================
+
+const int HL_MAX_PROPELLANT = 16;
+const int HL_MAX_THRUSTER = 64;
+const int HL_MAX_ANIMATION = 16;
+
+class VESSEL {
+public:
+	VESSEL (OBJHANDLE hVessel, int fmodel = 1);		// hVessel is the vessel's name, see Headless.h
+	virtual ~VESSEL () {}
+	OBJHANDLE GetHandle () const;
+	char *GetName () const;
+	char *GetClassName () const;
+
+	void SetEmptyMass (double m) const;
+	double GetMass () const;
+	void SetPMI (const VECTOR3 &pmi) const;
+	void SetCrossSections (const VECTOR3 &cs) const;
+	void SetSize (double size) const;
+	void SetSurfaceFrictionCoeff (double mu_lng, double mu_lat) const;
+	void SetRotDrag (const VECTOR3 &rd) const;
+	bool EnableTransponder (bool enable);
+	void InitNavRadios (DWORD nnav) const;
+	void SetAlbedoRGB (const VECTOR3 &albedo) const;
+	void SetTouchdownPoints (const VECTOR3 &pt1, const VECTOR3 &pt2, const VECTOR3 &pt3) const;
+	DOCKHANDLE CreateDock (const VECTOR3 &pos, const VECTOR3 &dir, const VECTOR3 &rot) const;
+	void ClearAirfoilDefinitions () const;
+	void *CreateAirfoil (AIRFOIL_ORIENTATION align, const VECTOR3 &ref, AirfoilCoeffFunc cf, double c, double S, double A) const;
+
+	PROPELLANT_HANDLE CreatePropellantResource (double maxmass, double mass = -1.0, double efficiency = 1.0) const;
+	double GetPropellantMass (PROPELLANT_HANDLE ph) const;
+	void SetPropellantMass (PROPELLANT_HANDLE ph, double mass) const;
+	THRUSTER_HANDLE CreateThruster (const VECTOR3 &pos, const VECTOR3 &dir, double maxth0, PROPELLANT_HANDLE hp = NULL,
+		double isp0 = 0.0, double isp_ref = 0.0, double p_ref = 101.4e3) const;
+	void CreateThrusterGroup (THRUSTER_HANDLE *th, int nth, THGROUP_TYPE thgt) const;
+	double GetThrusterLevel (THRUSTER_HANDLE th) const;
+	void SetThrusterLevel (THRUSTER_HANDLE th, double level) const;
+	void AddExhaust (THRUSTER_HANDLE th, double lscale, double wscale, const VECTOR3 &pos, const VECTOR3 &dir, SURFHANDLE tex = 0) const;
+	void AddExhaustStream (THRUSTER_HANDLE th, const VECTOR3 &pos, PARTICLESTREAMSPEC *pss = 0) const;
+
+	UINT AddMesh (const char *meshname, const VECTOR3 *ofs = 0) const;
+	UINT AddMesh (MESHHANDLE hMesh, const VECTOR3 *ofs = 0) const;
+	void SetMeshVisibilityMode (UINT idx, int mode) const;
+	UINT CreateAnimation (double initial_state) const;
+	ANIMATIONCOMPONENT_HANDLE AddAnimationComponent (UINT anim, double state0, double state1, MGROUP_ROTATE *trans,
+		ANIMATIONCOMPONENT_HANDLE parent = NULL);
+	bool SetAnimation (UINT anim, double state) const;
+	void SetCameraOffset (const VECTOR3 &co) const;
+	void SetCameraDefaultDirection (const VECTOR3 &cd) const;
+	void SetCameraRotationRange (double left, double right, double up, double down) const;
+	void SetCameraShiftRange (const VECTOR3 &fpos, const VECTOR3 &lpos, const VECTOR3 &rpos) const;
+
+	bool GroundContact () const;
+	double GetDynPressure () const;
+	void GetHorizonAirspeedVector (VECTOR3 &v) const;
+	bool ParseScenarioLineEx (char *line, void *status) const;
+
+	// what the vessel has set, for the driver to look at
+	mutable double hl_emptymass;
+	mutable int hl_nprop, hl_nthruster, hl_nanim;
+	mutable double hl_propmass[HL_MAX_PROPELLANT], hl_propmax[HL_MAX_PROPELLANT];
+	mutable double hl_thlevel[HL_MAX_THRUSTER];
+	mutable double hl_anim[HL_MAX_ANIMATION];
+	mutable long hl_corelines;		// scenario lines handed to ParseScenarioLineEx
+
+private:
+	OBJHANDLE hl_handle;
+	char hl_class[64];
+};
+
+class VESSEL2: public VESSEL {
+public:
+	VESSEL2 (OBJHANDLE hVessel, int fmodel = 1): VESSEL (hVessel, fmodel) {}
+	virtual void clbkSetClassCaps (FILEHANDLE cfg) {}
+	virtual void clbkSaveState (FILEHANDLE scn) {}		// no core lines, only the vessel's own
+	virtual void clbkLoadStateEx (FILEHANDLE scn, void *status) {}
+	virtual void clbkPostCreation () {}
+	virtual void clbkPreStep (double simt, double simdt, double mjd) {}
+	virtual void clbkPostStep (double simt, double simdt, double mjd) {}
+	virtual int clbkConsumeBufferedKey (DWORD key, bool down, char *kstate) { return 0; }
+	virtual void clbkVisualCreated (VISHANDLE vis, int refcount) {}
+	virtual void clbkMFDMode (int mfd, int mode) {}
+	virtual bool clbkLoadVC (int id) { return false; }
+	virtual bool clbkVCRedrawEvent (int id, int event, SURFHANDLE surf) { return false; }
+	virtual bool clbkVCMouseEvent (int id, int event, VECTOR3 &p) { return false; }
+};
+
+class VESSEL3: public VESSEL2 {
+public:
+	VESSEL3 (OBJHANDLE hVessel, int fmodel = 1): VESSEL2 (hVessel, fmodel) {}
+	virtual bool clbkDrawHUD (int mode, const HUDPAINTSPEC *hps, oapi::Sketchpad *skp) { return true; }
+};
+
+#endif // !__HEADLESS_ORBITERSDK_H
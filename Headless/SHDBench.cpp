@@ -0,0 +1,997 @@
+//=========================================================
+// SHDBench
+// Runs the real Shuttle-D code (SHD.cpp) without Orbiter, on the stand-in SDK in this directory, so it can be timed & profiled on
+// any Linux box. It creates a Shuttle-D from Shuttle-D.cfg & a short scenario, the way Orbiter would, & then steps it at a fixed
+// time step, calling clbkPreStep & clbkPostStep just like a frame does. Build & run it from the top directory:
+//
+//   g++ -O2 -IHeadless -I. SHD.cpp Headless/Headless.cpp Headless/SHDBench.cpp -lpthread -o SHDBench
+//   ./SHDBench [-cfg Shuttle-D.cfg] [-steps n]
+//   ./SHDBench -bench [-cfg Shuttle-D.cfg] [-o results.csv] [-b Headless/baseline.csv] [-tol 1.25]
+//   ./SHDBench -check [-cfg Shuttle-D.cfg]
+//   ./SHDBench -replay <name>.sil [-cfg Shuttle-D.cfg] [-scn scenario.txt]
+//
+// -bench times each of the callbacks that run every frame or on every load & save on its own, see Benchmarks below, & prints the
+// time per call. -o writes them out as CSV, -b compares them against an earlier CSV & exits with 2 if any of them got slower by
+// more than -tol times. baseline.csv was made with the build line above on an x86-64 Linux box, so on another machine make a
+// baseline of its own first, before the change being measured. On a busy machine the numbers move by 10-20% from run to run by
+// themselves, so compare on an idle one. -check runs the correctness checks, see Checks below, & exits with 3 if any fails.
+// -replay plays an input log recorded with INPUT_LOG = RECORD back as fast as it goes, see Replay below.
+// Add -D_DEBUG to get the self checks in InitModule, & -g to look at it with perf or valgrind. The snapshot, telemetry, log, cfg &
+// layout cache files that get written land in the current directory, with the backslash paths as their names.
+//=========================================================
+
+#include <vector>
+#include "Headless.h"
+#include "UMmuSDK.h"
+#include "UCGOCargoSDK.h"
+#include "InputLog.h"
+
+// the module, from SHD.cpp
+DLLCLBK void InitModule (HINSTANCE hModule);
+DLLCLBK void ExitModule (HINSTANCE hModule);
+DLLCLBK VESSEL *ovcInit (OBJHANDLE hvessel, int flightmodel);
+DLLCLBK void ovcExit (VESSEL *vessel);
+extern bool bShuttleSnapshot;		// BINARY_SNAPSHOT in the cfg
+extern bool bShuttleTelemetry;		// TELEMETRY in the cfg
+extern int ShuttleInputLog;			// INPUT_LOG in the cfg, 0 off, 1 RECORD, 2 REPLAY
+extern int nShuttleLayouts;			// layouts read this session, 0 starts the next session
+
+const double STEP = 0.02;		// 50 frames a second
+
+// a scenario block for one Shuttle-D, resting on the ground with two crew aboard
+static const char *Scenario =
+	"  STATUS Landed Earth\n"
+	"  GEAR 0 0.0000\n"
+	"  PLBAYA 0 0.0000\n"
+	"  PLBAYB 0 0.0000\n"
+	"  O2Tank 1.0000\n"
+	"  UMMU_CREW Peter Falcon;Capt;41;65;74\n"
+	"  UMMU_CREW Sandra Gore;Eng;35;67;55\n"
+	"  UCGO_SLOT 0 1200\n"
+	"END\n";
+
+// creates a Shuttle-D the way Orbiter does for a vessel in the scenario
+static VESSEL3 *NewVessel (const char *name, FILEHANDLE cfg, const char *scn)
+{
+	VESSEL3 *v = (VESSEL3*)ovcInit ((OBJHANDLE)name, 1);
+	v->clbkSetClassCaps (cfg);
+	FILEHANDLE f = Headless::OpenText (scn);
+	v->clbkLoadStateEx (f, NULL);
+	Headless::Close (f);
+	v->clbkPostCreation ();
+	return v;
+}
+
+// one frame
+static void Step (VESSEL3 *v)
+{
+	Headless::simt += Headless::simdt;
+	v->clbkPreStep (Headless::simt, Headless::simdt, 51000.0 + Headless::simt/86400.0);
+	v->clbkPostStep (Headless::simt, Headless::simdt, 51000.0 + Headless::simt/86400.0);
+}
+
+// saves v into out, emptied first, & returns the text
+static const char *Save (VESSEL3 *v, FILEHANDLE out)
+{
+	Headless::Rewind (out);
+	v->clbkSaveState (out);
+	return Headless::Text (out);
+}
+
+// copies the value of key in saved scenario text into buf, false if there is no such line
+static bool ScnValue (const char *text, const char *key, char *buf, size_t size)
+{
+	size_t len = strlen (key);
+	for (const char *p = text; *p; p = strchr (p, '\n') ? strchr (p, '\n')+1 : p+strlen (p)) {
+		while (*p == ' ') p++;
+		if (!strncmp (p, key, len) && p[len] == ' ') {
+			p += len+1;
+			size_t n = strcspn (p, "\r\n");
+			if (n >= size) return false;
+			memcpy (buf, p, n);
+			buf[n] = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+static long ReadBytes (const char *path, char *buf, long size)
+{
+	FILE *f = fopen (path, "rb");
+	if (!f) return -1;
+	long n = (long)fread (buf, 1, size, f);
+	fclose (f);
+	return n;
+}
+
+static bool WriteBytes (const char *path, const char *buf, long size)
+{
+	FILE *f = fopen (path, "wb");
+	if (!f) return false;
+	bool ok = (long)fwrite (buf, 1, size, f) == size;
+	return fclose (f) == 0 && ok;
+}
+
+//=========================================================
+// Benchmarks
+// Each one sets up its own vessel & whatever else it needs, & then times calls calls of one callback. They are run BENCH_RUNS
+// times over & the fastest run is the one reported, which is the one least disturbed by whatever else the machine was doing.
+//=========================================================
+
+void Shuttle_MomentCoeff (double aoa, double M, double Re, double *cl, double *cm, double *cd);
+void Shuttle_MomentCoeffRef (double aoa, double M, double Re, double *cl, double *cm, double *cd);
+
+const int BENCH_RUNS = 11;
+static FILEHANDLE cfg;
+static volatile double sink;		// so the compiler cant drop the airfoil calls
+
+// the same Shuttle-D as Scenario, with all three mechanisms halfway through opening
+static const char *MovingScenario =
+	"  STATUS Landed Earth\n"
+	"  GEAR 3 0.3000\n"
+	"  PLBAYA 3 0.3000\n"
+	"  PLBAYB 3 0.3000\n"
+	"  O2Tank 1.0000\n"
+	"  UMMU_CREW Peter Falcon;Capt;41;65;74\n"
+	"END\n";
+
+// a full scenario block the way Orbiter saves one, with crew & cargo in every slot. RCSFAIL is only saved when a thruster has
+// failed, so it isnt in here.
+static const char *LargeScenario =
+	"  STATUS Orbiting Earth\n"
+	"  RPOS -5107831.42 -108637.67 4692151.27\n"
+	"  RVEL -5092.3316 -9.6716 -5548.4301\n"
+	"  AROT 133.26 -11.52 -167.46\n"
+	"  VROT 0.0012 -0.0031 0.0007\n"
+	"  AFCMODE 7\n"
+	"  PRPLEVEL 0:0.913524 1:0.997231 2:0.997231 3:0.997231 4:0.997231 5:0.997231 6:0.997231\n"
+	"  THLEVEL 0:0.000000\n"
+	"  NAVFREQ 0 0\n"
+	"  XPDR 466\n"
+	"  GEAR 0 0.0000\n"
+	"  PLBAYA 1 1.0000\n"
+	"  PLBAYB 0 0.0000\n"
+	"  O2Tank 0.8731\n"
+	"  CO2SCRUB 0.8802\n"
+	"  WATER 0.9105\n"
+	"  POWER 0.7770\n"
+	"  UMMU_CREW Peter Falcon;Capt;41;65;74\n"
+	"  UMMU_CREW Sandra Gore;Eng;35;67;55\n"
+	"  UCGO_SLOT 0 1200\n"
+	"  UCGO_SLOT 1 800\n"
+	"  UCGO_SLOT 2 2500\n"
+	"  UCGO_SLOT 3 450\n"
+	"END\n";
+
+static double BenchStepSteady (long calls)
+{
+	VESSEL3 *v = NewVessel ("SHD-steady", cfg, Scenario);
+	for (int n = 0; n < 100; n++) Step (v);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		Step (v);
+	double t = Headless::Seconds () - t0;
+	ovcExit (v);
+	return t;
+}
+
+// every 2 s all three are turned round, which keeps them between 0.3 & 0.7 so none of them ever reaches its end stop
+static double BenchStepMoving (long calls)
+{
+	static char kstate[256];
+	VESSEL3 *v = NewVessel ("SHD-moving", cfg, MovingScenario);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++) {
+		if (n % 100 == 99) {
+			v->clbkConsumeBufferedKey (OAPI_KEY_G, true, kstate);
+			v->clbkConsumeBufferedKey (OAPI_KEY_O, true, kstate);
+			v->clbkConsumeBufferedKey (OAPI_KEY_K, true, kstate);
+		}
+		Step (v);
+	}
+	double t = Headless::Seconds () - t0;
+	ovcExit (v);
+	return t;
+}
+
+// AOA -180..180 & Mach 0..30, at spacings that dont line up with the table's. Both versions are called through a pointer, the
+// way Orbiter calls them.
+static double BenchAirfoil (AirfoilCoeffFunc coeff, long calls)
+{
+	double cl, cm, cd, sum = 0.0;
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++) {
+		double aoa = -PI + (n % 997)*(2*PI/996);
+		double M = (n % 1009)*(30.0/1008);
+		coeff (aoa, M, 1e6, &cl, &cm, &cd);
+		sum += cl + cm + cd;
+	}
+	double t = Headless::Seconds () - t0;
+	sink = sum;
+	return t;
+}
+
+static double BenchMomentCoeff (long calls)
+{
+	return BenchAirfoil (Shuttle_MomentCoeff, calls);
+}
+
+static double BenchMomentCoeffRef (long calls)
+{
+	return BenchAirfoil (Shuttle_MomentCoeffRef, calls);
+}
+
+static double BenchLoadState (long calls)
+{
+	VESSEL3 *v = NewVessel ("SHD-load", cfg, Scenario);
+	FILEHANDLE scn = Headless::OpenText (LargeScenario);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++) {
+		Headless::Rewind (scn);
+		v->clbkLoadStateEx (scn, NULL);
+	}
+	double t = Headless::Seconds () - t0;
+	Headless::Close (scn);
+	ovcExit (v);
+	return t;
+}
+
+// a scenario block with nothing but the SNAPSHOT line, so it is only the file being mapped, checked & copied in that is timed
+static double BenchSnapshotLoad (long calls)
+{
+	char line[512];
+	bShuttleSnapshot = true;
+	VESSEL3 *v = NewVessel ("SHD-snapshot", cfg, LargeScenario);
+	FILEHANDLE out = Headless::OpenOutput ();
+	bool saved = ScnValue (Save (v, out), "SNAPSHOT", line+11, sizeof(line)-12);
+	bShuttleSnapshot = false;
+	Headless::Close (out);
+	if (!saved) {
+		ovcExit (v);
+		return 0.0;
+	}
+	memcpy (line, "  SNAPSHOT ", 11);
+	FILEHANDLE scn = Headless::OpenText (line);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++) {
+		Headless::Rewind (scn);
+		v->clbkLoadStateEx (scn, NULL);
+	}
+	double t = Headless::Seconds () - t0;
+	Headless::Close (scn);
+	ovcExit (v);
+	return t;
+}
+
+// The clbkLoadStateEx loop as it was before the ScenarioKeys table, with _strnicmp tried for every key on every line, sscanf for
+// the numbers, & every line going on to UMmu & UCGO whether it was ours or not. It reads into a state of its own, but makes the
+// same UMmu, UCGO & Orbiter calls the old one did.
+struct OLDSTATE {
+	int GEAR_status, PLBAYA_status, PLBAYB_status;
+	double GEAR_proc, PLBAYA_proc, PLBAYB_proc, O2Tank;
+	UMMUCREWMANAGMENT Crew;
+	UCGO hUcgo;
+};
+
+static void OldLoadStateEx (VESSEL *v, OLDSTATE &s, FILEHANDLE scn)
+{
+	char *line;
+	while (oapiReadScenario_nextline (scn, line)) {
+		if (!_strnicmp (line, "GEAR", 4))
+			sscanf (line+4, "%d%lf", &s.GEAR_status, &s.GEAR_proc);
+		if (!_strnicmp (line, "PLBAYA", 6))
+			sscanf (line+6, "%d%lf", &s.PLBAYA_status, &s.PLBAYA_proc);
+		if (!_strnicmp (line, "PLBAYB", 6))
+			sscanf (line+6, "%d%lf", &s.PLBAYB_status, &s.PLBAYB_proc);
+		if (!_strnicmp (line, "O2Tank", 6))
+			sscanf (line+6, "%lf", &s.O2Tank);
+		if (s.Crew.LoadAllMembersFromOrbiterScenario (line) == TRUE)
+			continue;
+		if (s.hUcgo.LoadCargoFromScenario (line) == TRUE)
+			continue;
+		v->ParseScenarioLineEx (line, NULL);
+	}
+	v->SetAnimation (0, s.GEAR_proc);
+	v->SetAnimation (1, s.PLBAYA_proc);
+	v->SetAnimation (2, s.PLBAYB_proc);
+}
+
+// one scenario with calls Shuttle-D blocks in it, each ended by END the way Orbiter hands them to clbkLoadStateEx
+static FILEHANDLE FleetScenario (long blocks)
+{
+	size_t len = strlen (LargeScenario);
+	char *text = (char*)malloc (len*blocks + 1);
+	for (long n = 0; n < blocks; n++)
+		memcpy (text + len*n, LargeScenario, len);
+	text[len*blocks] = 0;
+	FILEHANDLE scn = Headless::OpenText (text);
+	free (text);
+	return scn;
+}
+
+static double BenchFleetLoad (long calls)
+{
+	VESSEL3 *v = NewVessel ("SHD-fleet", cfg, Scenario);
+	FILEHANDLE scn = FleetScenario (calls);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		v->clbkLoadStateEx (scn, NULL);
+	double t = Headless::Seconds () - t0;
+	Headless::Close (scn);
+	ovcExit (v);
+	return t;
+}
+
+static double BenchFleetLoadOld (long calls)
+{
+	static OLDSTATE s;
+	VESSEL3 *v = NewVessel ("SHD-fleet", cfg, Scenario);
+	s.Crew.SetMaxSeatAvailableInShip (2);
+	FILEHANDLE scn = FleetScenario (calls);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		OldLoadStateEx (v, s, scn);
+	double t = Headless::Seconds () - t0;
+	Headless::Close (scn);
+	ovcExit (v);
+	return t;
+}
+
+// a quicksave of a fleet: calls vessels, each with values of its own, all saved one after the other into the same scenario
+static double BenchFleetSave (long calls)
+{
+	VESSEL3 **v = new VESSEL3*[calls];
+	char name[32], scn[1024];
+	for (long n = 0; n < calls; n++) {
+		sprintf (name, "SHD-%ld", n);
+		sprintf (scn, "%s  GEAR 1 1\n  PLBAYA 0 %.17g\n  O2Tank %.17g\n  WATER %.17g\nEND\n", LargeScenario,
+			n/(double)calls, 1000.0 - n/3.0, 2999.0 - n/7.0);
+		v[n] = NewVessel (name, cfg, scn);
+	}
+	FILEHANDLE out = Headless::OpenOutput ();
+	for (long n = 0; n < calls; n++)	// once first, so the buffer has its full size
+		v[n]->clbkSaveState (out);
+	Headless::Rewind (out);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		v[n]->clbkSaveState (out);
+	double t = Headless::Seconds () - t0;
+	Headless::Close (out);
+	for (long n = 0; n < calls; n++)
+		ovcExit (v[n]);
+	delete []v;
+	return t;
+}
+
+// Steps flat out with TELEMETRY on, so every clbkPostStep pushes a record for the writer thread. The records dropped because the
+// writer couldnt keep up are whatever StopTelemetry says they were when the vessel goes.
+static long tlmDropped, tlmRecords;
+
+static double BenchTelemetry (long calls)
+{
+	bShuttleTelemetry = true;
+	VESSEL3 *v = NewVessel ("SHD-telemetry", cfg, Scenario);
+	bShuttleTelemetry = false;
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		Step (v);
+	double t = Headless::Seconds () - t0;
+	ovcExit (v);
+	const char *p = strstr (Headless::lastLog, ".csv, ");
+	if (!p || sscanf (p+6, "%ld records, %ld dropped", &tlmRecords, &tlmDropped) != 2)
+		tlmRecords = tlmDropped = -1;
+	return t;
+}
+
+static double BenchSaveState (long calls)
+{
+	VESSEL3 *v = NewVessel ("SHD-save", cfg, LargeScenario);
+	FILEHANDLE scn = Headless::OpenOutput ();
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++) {
+		Headless::Rewind (scn);
+		v->clbkSaveState (scn);
+	}
+	double t = Headless::Seconds () - t0;
+	Headless::Close (scn);
+	ovcExit (v);
+	return t;
+}
+
+// the keys a pilot actually presses during a flight, & one that isnt bound to anything
+static double BenchKey (long calls)
+{
+	static const DWORD keys[] = {OAPI_KEY_G, OAPI_KEY_O, OAPI_KEY_K, OAPI_KEY_7, OAPI_KEY_1, OAPI_KEY_2, OAPI_KEY_4, OAPI_KEY_Q};
+	const int nkeys = sizeof(keys)/sizeof(keys[0]);
+	static char kstate[256];
+	VESSEL3 *v = NewVessel ("SHD-key", cfg, Scenario);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		v->clbkConsumeBufferedKey (keys[n % nkeys], true, kstate);
+	double t = Headless::Seconds () - t0;
+	ovcExit (v);
+	return t;
+}
+
+// every VC area id in turn, the mechanism switches as well as the MFD buttons
+static double BenchVCMouse (long calls)
+{
+	VECTOR3 p = {0.5, 0.5, 0.0};
+	VESSEL3 *v = NewVessel ("SHD-vc", cfg, Scenario);
+	double t0 = Headless::Seconds ();
+	for (long n = 0; n < calls; n++)
+		v->clbkVCMouseEvent ((int)(n % 40), PANEL_MOUSE_LBDOWN, p);
+	double t = Headless::Seconds () - t0;
+	ovcExit (v);
+	return t;
+}
+
+static const struct BENCH {
+	const char *name;
+	long calls;
+	double (*run) (long calls);
+} Benches[] = {
+	{"poststep_steady",   500000, BenchStepSteady},
+	{"poststep_moving",   500000, BenchStepMoving},
+	{"momentcoeff",      2000000, BenchMomentCoeff},
+	{"momentcoeff_ref",  2000000, BenchMomentCoeffRef},
+	{"loadstate",          20000, BenchLoadState},
+	{"snapshot_load",     100000, BenchSnapshotLoad},
+	{"fleet_load",          5000, BenchFleetLoad},
+	{"fleet_load_old",      5000, BenchFleetLoadOld},
+	{"savestate",          50000, BenchSaveState},
+	{"fleet_save",          1000, BenchFleetSave},
+	{"consumekey",        500000, BenchKey},
+	{"vcmouse",          1000000, BenchVCMouse},
+	{"telemetry_step",    200000, BenchTelemetry},
+};
+const int NBENCH = sizeof(Benches)/sizeof(Benches[0]);
+
+// the ns per call of name in a CSV written by -o, or 0 if it isnt there
+static double BaselineValue (FILE *f, const char *name)
+{
+	char line[256], key[64];
+	double ns;
+	rewind (f);
+	while (fgets (line, sizeof(line), f))
+		if (line[0] != '#' && sscanf (line, "%63[^,],%lf", key, &ns) == 2 && !strcmp (key, name))
+			return ns;
+	return 0.0;
+}
+
+static int RunBenchmarks (const char *outpath, const char *basepath, double tol)
+{
+	FILE *out = NULL, *base = NULL;
+	if (outpath && !(out = fopen (outpath, "w"))) {
+		fprintf (stderr, "SHDBench: cant write %s\n", outpath);
+		return 1;
+	}
+	if (basepath && !(base = fopen (basepath, "r"))) {
+		fprintf (stderr, "SHDBench: cant read %s\n", basepath);
+		return 1;
+	}
+	if (out) fprintf (out, "benchmark,ns_per_call\n");
+	printf ("%-20s %12s", "benchmark", "ns/call");
+	if (base) printf (" %12s %8s", "baseline", "ratio");
+	printf ("\n");
+
+	int slower = 0;
+	for (int b = 0; b < NBENCH; b++) {
+		double best = 1e300;
+		for (int r = 0; r < BENCH_RUNS; r++) {
+			Headless::simt = 0.0;
+			best = min (best, Benches[b].run (Benches[b].calls));
+		}
+		double ns = best/Benches[b].calls*1e9;
+		printf ("%-20s %12.1f", Benches[b].name, ns);
+		if (out) fprintf (out, "%s,%.1f\n", Benches[b].name, ns);
+		double bns = base ? BaselineValue (base, Benches[b].name) : 0.0;
+		if (bns > 0.0) {
+			printf (" %12.1f %8.2f", bns, ns/bns);
+			if (ns > bns*tol) {
+				printf ("  SLOWER");
+				slower++;
+			}
+		}
+		printf ("\n");
+	}
+	printf ("telemetry_step, last run: %ld records written, %ld dropped\n",
+		tlmRecords, tlmDropped);
+	if (out) fclose (out);
+	if (base) fclose (base);
+	if (slower) printf ("%d of %d benchmarks got more than %.2f times slower\n", slower, NBENCH, tol);
+	return slower ? 2 : 0;
+}
+
+//=========================================================
+// Replay
+// An input log (see Input Log in SHD.cpp) has the length of every step in it, so the vessel can be stepped headless with exactly
+// the recorded ones, with INPUT_LOG = REPLAY feeding the keys, clicks & crew answers back in between, as fast as the CPU goes.
+// Orbiter's sim time starts at 0 with every session, so the replay does too. The vessel looks for the log under its own name in
+// the inputs directory, so -replay copies <name>.sil there first if it is somewhere else.
+//=========================================================
+
+// the step lengths in the input log at path, false if it isnt one or is damaged
+static bool ReadLogSteps (const char *path, std::vector<double> &steps)
+{
+	FILE *f = fopen (path, "rb");
+	if (!f) return false;
+	unsigned int magic = 0;
+	bool ok = fread (&magic, 4, 1, f) == 1 && magic == IL_MAGIC;
+	unsigned long long last = 0;
+	int tag;
+	while (ok && (tag = fgetc (f)) != EOF) {
+		int skip = 0;
+		if ((tag & 15) == IL_STEP) {
+			unsigned long long x = 0;
+			for (int b = 0; b < (tag >> 4); b++)
+				x |= (unsigned long long)(fgetc (f) & 255) << (b*8);
+			last = FdrUnresidual (FDR_XOR, x, last, 0);
+			double dt;
+			memcpy (&dt, &last, 8);
+			steps.push_back (dt);
+		}
+		else if (tag == IL_KEY) skip = 2;
+		else if (tag == IL_CLICK) skip = 30;
+		else if (tag == IL_INPUT) skip = fgetc (f);
+		else ok = false;
+		if (ok && (skip == EOF || fseek (f, skip, SEEK_CUR))) ok = false;
+	}
+	fclose (f);
+	return ok;
+}
+
+static bool CopyBytes (const char *from, const char *to)
+{
+	FILE *in = fopen (from, "rb"), *out = in ? fopen (to, "wb") : NULL;
+	char buf[4096];
+	size_t n;
+	bool ok = out != NULL;
+	while (ok && (n = fread (buf, 1, sizeof(buf), in)) > 0)
+		ok = fwrite (buf, 1, n, out) == n;
+	if (out && fclose (out)) ok = false;
+	if (in) fclose (in);
+	return ok;
+}
+
+// creates the vessel name from scn with INPUT_LOG = REPLAY & takes it through steps, starting from sim time 0
+static VESSEL3 *Replay (const char *name, const char *scn, const std::vector<double> &steps)
+{
+	ShuttleInputLog = 2;
+	Headless::simt = 0.0;
+	VESSEL3 *v = NewVessel (name, cfg, scn);
+	ShuttleInputLog = 0;
+	for (size_t n = 0; n < steps.size(); n++) {
+		Headless::simdt = steps[n];
+		Step (v);
+	}
+	Headless::simdt = STEP;
+	return v;
+}
+
+static int RunReplay (const char *path, const char *scnpath)
+{
+	static char scn[65536];
+	char name[256], logpath[512];
+	const char *base = path;
+	for (const char *p = path; *p; p++)
+		if (*p == '/' || *p == '\\') base = p+1;
+	snprintf (name, sizeof(name), "%s", base);
+	if (strlen (name) > 4 && !_stricmp (name+strlen (name)-4, ".sil")) name[strlen (name)-4] = 0;
+	snprintf (logpath, sizeof(logpath), INPUTLOG_DIR "%s.sil", name);
+
+	std::vector<double> steps;
+	if (!ReadLogSteps (path, steps)) {
+		fprintf (stderr, "SHDBench: %s is not an input log\n", path);
+		return 1;
+	}
+	if (strcmp (path, logpath) && !CopyBytes (path, logpath)) {
+		fprintf (stderr, "SHDBench: cant copy %s to %s\n", path, logpath);
+		return 1;
+	}
+	const char *text = Scenario;
+	if (scnpath) {
+		long n = ReadBytes (scnpath, scn, sizeof(scn)-1);
+		if (n < 0) {
+			fprintf (stderr, "SHDBench: cant read %s\n", scnpath);
+			return 1;
+		}
+		scn[n] = 0;
+		text = scn;
+	}
+
+	Headless::echoLog = true;		// for the vessel's own account of the replay
+	double t0 = Headless::Seconds ();
+	VESSEL3 *v = Replay (name, text, steps);
+	double t = Headless::Seconds () - t0;
+	Headless::echoLog = false;
+	double simt = Headless::simt;
+	printf ("replayed %lu steps (%.0f s of sim time) in %.1f ms: %.0f steps/s, %.0f times real time\n",
+		(unsigned long)steps.size(), simt, t*1e3, steps.size()/t, simt/t);
+	FILEHANDLE out = Headless::OpenOutput ();
+	printf ("%s", Save (v, out));
+	Headless::Close (out);
+	ovcExit (v);
+	return 0;
+}
+
+//=========================================================
+// Checks
+// Each one prints what it found & returns false if that is wrong.
+//=========================================================
+
+// The tables against the analytic model on a 2000 x 500 grid offset from the table samples. cl & cm are piecewise linear in AOA
+// with every breakpoint on a sample, so they have to come out exact to rounding. cd has the induced drag (quadratic in cl) & the
+// wave drag kink at Mach 0.75, which falls between two samples, neither of which a linear table follows exactly, so it gets an
+// absolute limit.
+static bool CheckAero ()
+{
+	const double limit[3] = {1e-12, 1e-12, 1e-3};
+	static const char *name[3] = {"cl", "cm", "cd"};
+	double err[3] = {0, 0, 0}, at[3][2];
+	for (int i = 0; i < 2000; i++)
+		for (int j = 0; j < 500; j++) {
+			double aoa = -PI + (i+0.37)*(2*PI/2000);
+			double M = (j+0.41)*(30.0/500);
+			double ref[3], tab[3];
+			Shuttle_MomentCoeffRef (aoa, M, 1e6, ref, ref+1, ref+2);
+			Shuttle_MomentCoeff (aoa, M, 1e6, tab, tab+1, tab+2);
+			for (int k = 0; k < 3; k++)
+				if (fabs (tab[k]-ref[k]) > err[k]) {
+					err[k] = fabs (tab[k]-ref[k]);
+					at[k][0] = aoa*DEG;
+					at[k][1] = M;
+				}
+		}
+	bool ok = true;
+	for (int k = 0; k < 3; k++) {
+		printf ("aero %s max error %.3g at AOA %.2f Mach %.3f (limit %g) %s\n", name[k], err[k], at[k][0], at[k][1], limit[k],
+			err[k] <= limit[k] ? "ok" : "FAILED");
+		ok = ok && err[k] <= limit[k];
+	}
+	return ok;
+}
+
+// No two VC click spheres registered for the same camera may come closer than a millimetre, so a click between two buttons doesnt
+// land on one or the other by a hair. The switches are the closest pair as they have always been laid out, 1.04 mm apart.
+double Shuttle_VCAreaGap (int &id1, int &id2);
+
+static bool CheckVCAreas ()
+{
+	const double limit = 0.001;
+	int a = -1, b = -1;
+	double gap = Shuttle_VCAreaGap (a, b);
+	printf ("VC click areas, smallest gap %.5f m between areas %d & %d (limit %g) %s\n", gap, a, b, limit,
+		gap >= limit ? "ok" : "FAILED");
+	return gap >= limit;
+}
+
+// the scenario text without its SNAPSHOT line, whose path has the vessel name in it
+static void StripSnapshot (const char *text, char *buf, size_t size)
+{
+	const char *p = strstr (text, "  SNAPSHOT ");
+	size_t n = p ? (size_t)(p-text) : strlen (text);
+	snprintf (buf, size, "%.*s%s", (int)n, text, p ? strchr (p, '\n')+1 : "");
+}
+
+// A vessel that has been flying for a while, with the gear moving & a HUD message up, is saved with a snapshot. A second vessel is
+// loaded from that & saved again: both snapshots have to be byte for byte the same, & so do the scenario texts around them. Then
+// every byte of the file is damaged in turn, & each time the load has to turn the snapshot down (& say so in the log).
+static bool CheckSnapshot ()
+{
+	static char kstate[256];
+	static char textA[4096], textB[4096], snapA[4096], snapB[4096], bad[4096];
+	char valA[512], valB[512], *pathA, *pathB;
+	bool ok = true;
+
+	bShuttleSnapshot = true;
+	Headless::simt = 1000.0;
+	VESSEL3 *a = NewVessel ("SHD-snapA", cfg, LargeScenario);
+	for (int n = 0; n < 50; n++) Step (a);
+	a->clbkConsumeBufferedKey (OAPI_KEY_G, true, kstate);
+	a->clbkConsumeBufferedKey (OAPI_KEY_7, true, kstate);
+	for (int n = 0; n < 20; n++) Step (a);
+	FILEHANDLE out = Headless::OpenOutput ();
+	const char *text = Save (a, out);
+	snprintf (textA, sizeof(textA), "%s", text);
+	if (!ScnValue (textA, "SNAPSHOT", valA, sizeof(valA)) || !(pathA = strchr (valA, ' '))) {
+		printf ("snapshot not saved FAILED\n");
+		bShuttleSnapshot = false;
+		Headless::Close (out);
+		ovcExit (a);
+		return false;
+	}
+	pathA++;
+
+	VESSEL3 *b = NewVessel ("SHD-snapB", cfg, textA);
+	text = Save (b, out);
+	snprintf (textB, sizeof(textB), "%s", text);
+	long sizeA = ReadBytes (pathA, snapA, sizeof(snapA)), sizeB = -1;
+	if (ScnValue (textB, "SNAPSHOT", valB, sizeof(valB)) && (pathB = strchr (valB, ' ')))
+		sizeB = ReadBytes (pathB+1, snapB, sizeof(snapB));
+	bool same = sizeA > 0 && sizeA == sizeB && !memcmp (snapA, snapB, sizeA);
+	printf ("snapshot round trip, %ld bytes, %s\n", sizeA, same ? "ok" : "FAILED");
+	ok = ok && same;
+	StripSnapshot (textA, bad, sizeof(bad));
+	StripSnapshot (textB, snapB, sizeof(snapB));
+	same = !strcmp (bad, snapB);
+	printf ("snapshot scenario text round trip %s\n", same ? "ok" : "FAILED");
+	ok = ok && same;
+
+	long taken = 0;
+	for (long i = 0; i < sizeA; i++) {
+		memcpy (bad, snapA, sizeA);
+		bad[i] ^= 0x5a;
+		WriteBytes (pathA, bad, sizeA);
+		long lines = Headless::logLines;
+		VESSEL3 *c = NewVessel ("SHD-snapC", cfg, textA);
+		if (Headless::logLines == lines) taken++;
+		ovcExit (c);
+	}
+	WriteBytes (pathA, snapA, sizeA);
+	printf ("snapshot with one damaged byte taken %ld times out of %ld %s\n", taken, sizeA, taken ? "FAILED" : "ok");
+	ok = ok && !taken;
+
+	bShuttleSnapshot = false;
+	Headless::Close (out);
+	ovcExit (b);
+	ovcExit (a);
+	return ok;
+}
+
+// Values that need all 17 digits go in, & each has to come out of clbkSaveState as a number that reads back as exactly the same
+// double. A second vessel loaded from that save has to save exactly the same text again.
+static bool CheckSaveExact ()
+{
+	static const struct { const char *key; int field; double value; } Values[] = {
+		{"GEAR",     1, 0.1 + 1e-16*3},
+		{"PLBAYA",   1, 1.0/3.0},
+		{"PLBAYB",   1, 2.0/3.0},
+		{"O2Tank",   0, 987.65432109876543},
+		{"CO2SCRUB", 0, 1000.0/7.0},
+		{"WATER",    0, 2999.9999999999995},
+		{"POWER",    0, 1e-300},
+	};
+	const int nvalues = sizeof(Values)/sizeof(Values[0]);
+	static char scn[2048], textA[4096];
+	char *p = scn, value[256];
+	for (int i = 0; i < nvalues; i++)
+		p += sprintf (p, "  %s %s%.17g\n", Values[i].key, Values[i].field ? "0 " : "", Values[i].value);
+	strcpy (p, "END\n");
+
+	Headless::simt = 500.0;
+	VESSEL3 *a = NewVessel ("SHD-exactA", cfg, scn);
+	FILEHANDLE out = Headless::OpenOutput ();
+	snprintf (textA, sizeof(textA), "%s", Save (a, out));
+	int exact = 0;
+	for (int i = 0; i < nvalues; i++) {
+		double d = -1.0;
+		if (ScnValue (textA, Values[i].key, value, sizeof(value)))
+			d = strtod (Values[i].field ? strchr (value, ' ')+1 : value, NULL);
+		if (!memcmp (&d, &Values[i].value, sizeof(d))) exact++;
+		else printf ("  %s saved as %s, read back as %.17g instead of %.17g\n", Values[i].key, value, d, Values[i].value);
+	}
+	printf ("save of full precision values, %d of %d exact %s\n", exact, nvalues, exact == nvalues ? "ok" : "FAILED");
+
+	VESSEL3 *b = NewVessel ("SHD-exactB", cfg, textA);
+	bool same = !strcmp (textA, Save (b, out));
+	printf ("save, load & save again %s\n", same ? "ok" : "FAILED");
+
+	Headless::Close (out);
+	ovcExit (b);
+	ovcExit (a);
+	return exact == nvalues && same;
+}
+
+// TELEMETRY at a steady 10000 steps a second, a hundred times what Orbiter runs at, for a second or so. The writer has to keep up
+// with that without dropping anything.
+static bool CheckTelemetry ()
+{
+	bShuttleTelemetry = true;
+	VESSEL3 *v = NewVessel ("SHD-telemetry", cfg, Scenario);
+	bShuttleTelemetry = false;
+	double t0 = Headless::Seconds ();
+	long steps = 0;
+	for (int ms = 0; ms < 1000; ms++) {
+		for (int n = 0; n < 10; n++, steps++)
+			Step (v);
+		while (Headless::Seconds () - t0 < (ms+1)*0.001)
+			Sleep (0);
+	}
+	ovcExit (v);
+	long records = -1, dropped = -1;
+	const char *p = strstr (Headless::lastLog, ".csv, ");
+	if (p) sscanf (p+6, "%ld records, %ld dropped", &records, &dropped);
+	bool ok = records == steps && dropped == 0;
+	printf ("telemetry at 10000 steps/s, %ld steps, %ld records written, %ld dropped %s\n", steps, records, dropped,
+		ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// A short session is recorded with INPUT_LOG = RECORD, on the one crew MovingScenario so there is a seat free: steps of uneven
+// length, as Orbiter's are, the gear key, a click on the bay A switch & a crew member added with the M key & its three input boxes.
+// The log is then replayed on a fresh vessel from the same scenario. Every step has to come back at its recorded length, every
+// input has to be taken, & the vessel has to end up saving exactly the same scenario text.
+static bool CheckReplay ()
+{
+	const int AID_PLBAYAOPENSWITCH = 36;	// from D9base.h, which cant go in a second translation unit
+	static const char *answer[3] = {"Jim Tester", "44", "Sci"};
+	static char kstate[256];
+	static char textA[4096];
+	VECTOR3 p = {0, 0, 0};
+	int answered = 0;
+
+	ShuttleInputLog = 1;
+	Headless::simt = 0.0;
+	VESSEL3 *a = NewVessel ("SHD-replay", cfg, MovingScenario);
+	ShuttleInputLog = 0;
+	for (int n = 0; n < 1000; n++) {
+		Headless::simdt = STEP*(1.0 + 0.5*sin (n*0.1));
+		Step (a);
+		if (n == 100) a->clbkConsumeBufferedKey (OAPI_KEY_G, true, kstate);
+		if (n == 200) a->clbkVCMouseEvent (AID_PLBAYAOPENSWITCH, PANEL_MOUSE_LBDOWN, p);
+		if (n == 300) a->clbkConsumeBufferedKey (OAPI_KEY_M, true, kstate);
+		if (n == 310 || n == 320 || n == 330)
+			if (Headless::AnswerInputBox (answer[answered])) answered++;
+	}
+	Headless::simdt = STEP;
+	FILEHANDLE out = Headless::OpenOutput ();
+	snprintf (textA, sizeof(textA), "%s", Save (a, out));
+	ovcExit (a);
+
+	std::vector<double> steps;
+	bool read = ReadLogSteps (INPUTLOG_DIR "SHD-replay.sil", steps);
+	VESSEL3 *b = Replay ("SHD-replay", MovingScenario, steps);
+	unsigned long nsteps = 0, ninputs = 0, differ = 1;
+	const char *q = strstr (Headless::lastLog, " finished, ");
+	if (q) sscanf (q+11, "%lu steps & %lu inputs, %lu steps", &nsteps, &ninputs, &differ);
+	bool same = !strcmp (textA, Save (b, out));
+	Headless::Close (out);
+	ovcExit (b);
+
+	bool added = strstr (textA, "Jim Tester") != NULL;
+	bool ok = read && answered == 3 && added && steps.size() == 1000 && nsteps == 1000 && ninputs == 6 && differ == 0 && same;
+	printf ("replay of %d recorded inputs (crew %s), %lu of %lu steps & %lu inputs taken, %lu steps not as long as recorded, "
+		"saved state %s %s\n", 3+answered, added ? "added" : "NOT ADDED", nsteps, (unsigned long)steps.size(), ninputs, differ,
+		same ? "the same" : "DIFFERENT", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Creates a vessel of class cls, the cfg text written to where Orbiter keeps it, & returns the log line about its layout, or an
+// empty one if the vessel reused a layout it already had.
+static const char *LayoutLine (const char *cls, const char *text)
+{
+	static char line[512];
+	char path[256];
+	sprintf (path, "Config\\Vessels\\%s.cfg", cls);
+	WriteBytes (path, text, (long)strlen (text));
+	strcpy (Headless::className, cls);
+	FILEHANDLE f = Headless::OpenFile (path);
+	long lines = Headless::logLines;
+	VESSEL3 *v = (VESSEL3*)ovcInit ((OBJHANDLE)"SHD-layout", 1);
+	v->clbkSetClassCaps (f);
+	ovcExit (v);
+	Headless::Close (f);
+	strcpy (Headless::className, "Shuttle-D");
+	const char *p = strstr (Headless::lastLog, " layout read from ");
+	snprintf (line, sizeof(line), "%s", Headless::logLines > lines && p ? p+18 : "");
+	return line;
+}
+
+// the layout line has to say from & nslot, see LayoutLine
+static bool LayoutFrom (const char *line, const char *from, int nslot)
+{
+	char want[64];
+	sprintf (want, ", %d cargo slots", nslot);
+	bool ok = !strncmp (line, from, strlen (from)) && strstr (line, want);
+	if (!ok) printf ("layout read from \"%s\", wanted %s%s\n", line, from, want);
+	return ok;
+}
+
+// Two classes with different cfgs have to get a layout each, a second vessel of a class reuses it, the next session reads it back
+// from the cache, & a changed cfg is parsed again rather than taken from a cache made from the old one.
+static bool CheckLayouts ()
+{
+	static const char *one = "CARGO_SLOTS = 1\n"
+		"CARGO_SLOT0 = -0.65 -3.3 11.53  0 0 270  2 -3.6 11.53\n";
+	static const char *two = "CARGO_SLOTS = 2\n"
+		"CARGO_SLOT0 = -0.65 -3.3 11.53  0 0 270  2 -3.6 11.53\n"
+		"CARGO_SLOT1 = -0.65 -3.3 10.23  0 0 270  2 -3.6 10.23\n";
+	static const char *three = "CARGO_SLOTS = 3\n"
+		"CARGO_SLOT0 = -0.65 -3.3 11.53  0 0 270  2 -3.6 11.53\n"
+		"CARGO_SLOT1 = -0.65 -3.3 10.23  0 0 270  2 -3.6 10.23\n"
+		"CARGO_SLOT2 = -0.65 -3.3 8.93  0 0 270  2 -3.6 8.93\n";
+	int saved = nShuttleLayouts;
+	remove ("Config\\Vessels\\Shuttle-D cache\\SHD-layout-a.bin");	// LAYOUT_CACHE_DIR in D9base.h
+	remove ("Config\\Vessels\\Shuttle-D cache\\SHD-layout-b.bin");
+
+	nShuttleLayouts = 0;
+	bool ok = LayoutFrom (LayoutLine ("SHD-layout-a", two), "its cfg", 2);
+	ok = LayoutFrom (LayoutLine ("SHD-layout-b", one), "its cfg", 1) && ok;
+	const char *again = LayoutLine ("SHD-layout-a", two);
+	if (*again) {
+		printf ("layout read again for a second vessel, from \"%s\"\n", again);
+		ok = false;
+	}
+	nShuttleLayouts = 0;
+	ok = LayoutFrom (LayoutLine ("SHD-layout-a", two), "the layout cache", 2) && ok;
+	ok = LayoutFrom (LayoutLine ("SHD-layout-a", three), "its cfg", 3) && ok;
+	nShuttleLayouts = 0;
+	ok = LayoutFrom (LayoutLine ("SHD-layout-a", three), "the layout cache", 3) && ok;
+	nShuttleLayouts = saved;
+	printf ("layouts for 2 classes, reused, cached & parsed again for a changed cfg %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static int RunChecks ()
+{
+	int failed = 0;
+	if (!CheckAero ()) failed++;
+	if (!CheckVCAreas ()) failed++;
+	if (!CheckSnapshot ()) failed++;
+	if (!CheckSaveExact ()) failed++;
+	if (!CheckTelemetry ()) failed++;
+	if (!CheckReplay ()) failed++;
+	if (!CheckLayouts ()) failed++;
+	if (failed) printf ("%d checks failed\n", failed);
+	return failed ? 3 : 0;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *cfgpath = "Shuttle-D.cfg", *outpath = NULL, *basepath = NULL, *replaypath = NULL, *scnpath = NULL;
+	long steps = 1000000;
+	bool bench = false, check = false;
+	double tol = 1.25;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp (argv[i], "-cfg") && i+1 < argc) cfgpath = argv[++i];
+		else if (!strcmp (argv[i], "-steps") && i+1 < argc) steps = atol (argv[++i]);
+		else if (!strcmp (argv[i], "-bench")) bench = true;
+		else if (!strcmp (argv[i], "-check")) check = true;
+		else if (!strcmp (argv[i], "-o") && i+1 < argc) outpath = argv[++i];
+		else if (!strcmp (argv[i], "-b") && i+1 < argc) basepath = argv[++i];
+		else if (!strcmp (argv[i], "-tol") && i+1 < argc) tol = atof (argv[++i]);
+		else if (!strcmp (argv[i], "-replay") && i+1 < argc) replaypath = argv[++i];
+		else if (!strcmp (argv[i], "-scn") && i+1 < argc) scnpath = argv[++i];
+		else {
+			fprintf (stderr, "usage: SHDBench [-cfg Shuttle-D.cfg] [-steps n]\n"
+				"       SHDBench -bench [-cfg Shuttle-D.cfg] [-o results.csv] [-b baseline.csv] [-tol 1.25]\n"
+				"       SHDBench -check [-cfg Shuttle-D.cfg]\n"
+				"       SHDBench -replay <name>.sil [-cfg Shuttle-D.cfg] [-scn scenario.txt]\n");
+			return 1;
+		}
+	}
+	cfg = Headless::OpenFile (cfgpath);
+	if (!cfg) {
+		fprintf (stderr, "SHDBench: cant read %s\n", cfgpath);
+		return 1;
+	}
+	Headless::echoLog = true;
+	InitModule (NULL);
+	Headless::simt = 0.0;
+	Headless::simdt = STEP;
+	VESSEL3 *v = NewVessel ("SHD-1", cfg, Scenario);
+	Headless::echoLog = false;
+
+	int ret = 0;
+	if (replaypath)
+		ret = RunReplay (replaypath, scnpath);
+	else if (check)
+		ret = RunChecks ();
+	if (bench && !ret)
+		ret = RunBenchmarks (outpath, basepath, tol);
+	else if (!bench && !check && !replaypath) {
+		double t0 = Headless::Seconds ();
+		for (long n = 0; n < steps; n++)
+			Step (v);
+		double t = Headless::Seconds () - t0;
+		printf ("%ld steps (%.0f s of sim time) in %.3f s: %.0f steps/s, %.1f ns/step\n",
+			steps, steps*STEP, t, steps/t, t/steps*1e9);
+	}
+
+	ovcExit (v);
+	ExitModule (NULL);
+	Headless::Close (cfg);
+	return ret;
+}
@@ -0,0 +1,42 @@
+//=========================================================
+// Headless stand-in for UCGOCargoSDK.h
+// Cargo is a mass per slot. There is never any cargo lying around to grapple, so the driver loads slots through the "UCGO"
+// scenario lines instead, which are saved back the same way.
+//=========================================================
+
+#ifndef __HEADLESS_UCGOCARGOSDK_H
+#define __HEADLESS_UCGOCARGOSDK_H
+
+const int HL_MAX_SLOT = 16;
+
+class UCGO {
+public:
+	UCGO ();
+	void Init (OBJHANDLE hVessel) {}
+	void WarnUserUCGONotInstalled (const char *addon) {}
+	void DeclareCargoSlot (int slot, VECTOR3 pos, VECTOR3 rot);
+	void SetSlotGroundReleasePos (int slot, VECTOR3 pos) {}
+	void SetReleaseSpeedInSpace (float speed) {}
+	void SetMaxCargoMassAcceptable (double mass) {}
+	void SetGrappleDistance (double dist) {}
+	void SetUcgoVisual (VISHANDLE vis) {}
+	void UpdateEmptyMass () {}
+	void SetSlotDoorState (BOOL state) {}
+
+	int GrappleOneCargo (int slot) { return 0; }
+	BOOL ReleaseOneCargo (int slot);
+	double GetCargoTotalMass ();
+	int GetNbrCargoLoaded ();
+	double GetCargoSlotMass (int slot);
+	char *ScnEditor_SelectNextCargoAvailableOnDisk () { return (char*)"Headless cargo"; }
+	BOOL ScnEditor_AddLastSelectedCargoToSlot (int slot);
+
+	BOOL LoadCargoFromScenario (char *line);
+	void SaveCargoToScenario (FILEHANDLE scn);
+
+private:
+	double mass[HL_MAX_SLOT];
+	int nslot;
+};
+
+#endif // !__HEADLESS_UCGOCARGOSDK_H
@@ -0,0 +1,60 @@
+//=========================================================
+// Headless stand-in for UMmuSDK.h
+// The crew is a plain list of names & ids, saved & loaded as "UMMU" lines, so the crew parts of the scenario round trip. Nobody
+// ever walks out: EvaCrewMember just takes the member off the list.
+//=========================================================
+
+#ifndef __HEADLESS_UMMUSDK_H
+#define __HEADLESS_UMMUSDK_H
+
+#define UMMU_TRANSFERED_TO_OUR_SHIP 1
+#define UMMU_RETURNED_TO_OUR_SHIP 2
+#define TRANSFER_TO_DOCKED_SHIP_OK 1
+#define EVA_OK 2
+#define ERROR_AIRLOCK_CLOSED 3
+#define ERROR_DOCKED_SHIP_HAVE_AIRLOCK_CLOSED 4
+#define ERROR_CREW_MEMBER_NOT_FOUND 5
+#define ERROR_DOCKEDSHIP_DONOT_USE_UMMU 6
+#define ERROR_MISC_ERROR_EVAFAILED 7
+
+const int HL_MAX_CREW = 16;
+
+class UMMUCREWMANAGMENT {
+public:
+	UMMUCREWMANAGMENT ();
+	int InitUmmu (OBJHANDLE hVessel);
+	float GetUserUMmuVersion ();
+	void WarnUserUMMUNotInstalled (const char *addon) {}
+	void SetMaxSeatAvailableInShip (int seats);
+	void DefineAirLockShape (BOOL state, float x0, float x1, float y0, float y1, float z0, float z1) {}
+	void SetMembersPosRotOnEVA (VECTOR3 pos, VECTOR3 rot) {}
+	void DeclareActionArea (int id, VECTOR3 pos, double radius, BOOL trigger, const char *wav, const char *msg) {}
+	int ProcessUniversalMMu () { return 0; }
+	int DetectActionAreaActivated () { return -1; }
+	void SetAirlockDoorState (BOOL state) { airlock = state; }
+	BOOL GetAirlockDoorState () { return airlock; }
+
+	int AddCrewMember (char *name, int age, int pulse, int weight, char *miscid);
+	int EvaCrewMember (char *name);
+	int GetCrewTotalNumber () { return ncrew; }
+	char *GetCrewNameBySlotNumber (int slot);
+	char *GetCrewMiscIdBySlotNumber (int slot);
+	char *GetCrewMiscIdByName (char *name);
+	int GetCrewAgeBySlotNumber (int slot);
+	float GetCrewWeightBySlotNumber (int slot);
+	void SetCrewMemberPulseBySlotNumber (int slot, int pulse);
+	char *GetLastEnteredCrewName () { return (char*)""; }
+	char *GetLastEvaedCrewName () { return lastEva; }
+
+	BOOL LoadAllMembersFromOrbiterScenario (char *line);
+	void SaveAllMembersInOrbiterScenarios (FILEHANDLE scn);
+
+private:
+	struct Member { char name[40], miscid[8]; int age, pulse, weight; };
+	Member crew[HL_MAX_CREW];
+	int ncrew, seats;
+	BOOL airlock;
+	char lastEva[40];
+};
+
+#endif // !__HEADLESS_UMMUSDK_H
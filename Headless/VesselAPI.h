@@ -0,0 +1 @@
+// the Orbiter SDK header of the same name only adds what SHD.cpp doesnt use
@@ -0,0 +1,2 @@
+// the SDK is included under both spellings, see Orbitersdk.h
+#include "Orbitersdk.h"
@@ -0,0 +1,14 @@
+#pragma once
+#include "FlightRecorder.h"
+
+// Input log file format
+// Shared by the module (see Input Log in SHD.cpp) & the headless driver, which replays a log with the recorded step lengths (see
+// Headless/SHDBench.cpp), so like FlightRecorder.h it only uses the C library. A log is the magic & then one entry after another,
+// each a type byte & what follows it:
+
+const int IL_STEP = 1;		// simdt as the XOR with the last one (see FdrResidual), the number of bytes kept in the high 4 bits
+const int IL_KEY = 2;		// key, Shift (1) & Ctrl (2) bits
+const int IL_CLICK = 3;		// VC area id (2 bytes), event (4 bytes), position (3 doubles)
+const int IL_INPUT = 4;		// length byte, then the text
+const unsigned int IL_MAGIC = 0x49444853;	// "SHDI"
+#define INPUTLOG_DIR "Config\\Vessels\\Shuttle-D inputs\\"
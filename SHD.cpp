@@ -13,6 +13,9 @@
 #include "orbitersdk.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <emmintrin.h>
 #include "OrbiterSoundSDK40.h"
 #include "VesselAPI.h"
 
@@ -24,6 +27,13 @@
 #define PLBAYBOPEN					 5
 #define PLBAYBCLOSE					 6
 
+// Operating speed & sounds for each entry in ShuttleD::mech, in MECH_* order. The animation handles are filled in by DefineAnimations.
+static const struct { double speed; int wave_open, wave_close; } MechanismSpec[MECH_COUNT] = {
+	{GEAR_OPERATING_SPEED,   GEARUP,     GEARDOWN},
+	{PLBAYA_OPERATING_SPEED, PLBAYAOPEN, PLBAYACLOSE},
+	{PLBAYB_OPERATING_SPEED, PLBAYBOPEN, PLBAYBCLOSE},
+};
+
 HINSTANCE g_hDLL;
 VISHANDLE MainExternalMeshVisual = 0;
 
@@ -32,9 +42,11 @@ VISHANDLE MainExternalMeshVisual = 0;
 // Looks painfuly complicated at first, but gets a lot simpler once you realize that each column corresponds to a particular AOA value,
 // and the parameters underneath give the aerodynamic behaviour of the vessel at the given AOA. An excellent tutorial on what these values mean
 // is available on the Orbiterwiki website.
+// Shuttle_MomentCoeffRef is the original analytic model. It is no longer handed to Orbiter directly, but it is what the tables below are
+// built from, so any change to the aerodynamics belongs in here.
 // ==============================================================
 
-void Shuttle_MomentCoeff (double aoa,double M,double Re,double *cl,double *cm,double *cd)
+void Shuttle_MomentCoeffRef (double aoa,double M,double Re,double *cl,double *cm,double *cd)
 {
 	int i;
 	const int nabsc = 7;
@@ -52,6 +64,818 @@ void Shuttle_MomentCoeff (double aoa,double M,double Re,double *cl,double *cm,do
 	// profile drag + (lift-)induced drag + transonic/supersonic wave (compressibility) drag
 }
 
+// ==============================================================
+// Airfoil coefficient tables
+// Orbiter calls the airfoil function every timestep for every Shuttle-D in the scenario, so instead of searching the AOA list, taking a
+// sine & calling back into Orbiter for the drag terms each time, the model above is sampled once in InitModule.
+// Lift, moment, profile drag & induced drag only depend on AOA, and wave drag only depends on Mach, so two 1D tables cover the whole
+// AOA x Mach plane just as well as a 2D grid would. The AOA step is 0.5 degrees, which lands on every breakpoint in the AOA list above,
+// so cl & cm come out of the table exactly. Above AERO_MAXMACH the wave drag is held at its last value.
+// ==============================================================
+
+const int    AERO_NAOA    = 721;		// -180..180 degrees in 0.5 degree steps
+const double AERO_AOA0    = -PI;
+const double AERO_DAOA    = (2*PI)/(AERO_NAOA-1);
+const int    AERO_NMACH   = 1501;		// Mach 0..30 in 0.02 steps
+const double AERO_DMACH   = 0.02;
+const double AERO_MAXMACH = AERO_DMACH*(AERO_NMACH-1);
+
+double AeroCL[AERO_NAOA], AeroCM[AERO_NAOA], AeroCD[AERO_NAOA];	// AeroCD is profile + induced drag
+double AeroCDW[AERO_NMACH];										// wave drag
+
+void Shuttle_BuildAeroTables ()
+{
+	int i;
+	double cd;
+	double cdw0 = oapiGetWaveDrag (0, 0.75, 1.0, 1.1, 0.04);
+
+	for (i = 0; i < AERO_NAOA; i++) {
+		Shuttle_MomentCoeffRef (AERO_AOA0 + i*AERO_DAOA, 0, 0, &AeroCL[i], &AeroCM[i], &cd);
+		AeroCD[i] = cd - cdw0;	// the AOA table gets everything except the wave drag
+	}
+	for (i = 0; i < AERO_NMACH; i++)
+		AeroCDW[i] = oapiGetWaveDrag (i*AERO_DMACH, 0.75, 1.0, 1.1, 0.04);
+}
+
+// This is the function actually handed to CreateAirfoil. The clamps are plain min/max on doubles, which the compiler turns into
+// minsd/maxsd rather than jumps, so there are no branches on the flight condition at all.
+void Shuttle_MomentCoeff (double aoa,double M,double Re,double *cl,double *cm,double *cd)
+{
+	double u = min (max ((aoa-AERO_AOA0)*(1.0/AERO_DAOA), 0.0), AERO_NAOA-1.000001);
+	int i = (int)u;
+	double f = u-i;
+	double w = min (max (M*(1.0/AERO_DMACH), 0.0), AERO_NMACH-1.000001);
+	int j = (int)w;
+	double g = w-j;
+
+	*cl = AeroCL[i] + (AeroCL[i+1]-AeroCL[i]) * f;
+	*cm = AeroCM[i] + (AeroCM[i+1]-AeroCM[i]) * f;
+	*cd = AeroCD[i] + (AeroCD[i+1]-AeroCD[i]) * f + AeroCDW[j] + (AeroCDW[j+1]-AeroCDW[j]) * g;
+}
+
+// ==============================================================
+// Batch airfoil evaluation
+// Same table lookup as Shuttle_MomentCoeff, but for whole arrays of flight conditions at once, for trajectory tools & MFDs that want
+// thousands of points without going through the pointer out-params one call at a time. It works two points per SSE2 register, with the
+// arithmetic done in exactly the same order as the scalar version so both give bit-identical results. Any odd point left over at the
+// end goes through Shuttle_MomentCoeff itself. Re is accepted to keep the same inputs as the airfoil callback, but like there it is unused.
+// Exported from the module so other addons can pick it up with GetProcAddress.
+// ==============================================================
+
+DLLCLBK void Shuttle_MomentCoeffBatch (int n, const double *aoa, const double *M, const double *Re, double *cl, double *cm, double *cd)
+{
+	const __m128d aoa0  = _mm_set1_pd (AERO_AOA0);
+	const __m128d iaoa  = _mm_set1_pd (1.0/AERO_DAOA);
+	const __m128d imach = _mm_set1_pd (1.0/AERO_DMACH);
+	const __m128d zero  = _mm_setzero_pd ();
+	const __m128d umax  = _mm_set1_pd (AERO_NAOA-1.000001);
+	const __m128d wmax  = _mm_set1_pd (AERO_NMACH-1.000001);
+	int k;
+
+	for (k = 0; k+2 <= n; k += 2) {
+		__m128d u = _mm_min_pd (_mm_max_pd (_mm_mul_pd (_mm_sub_pd (_mm_loadu_pd (aoa+k), aoa0), iaoa), zero), umax);
+		__m128i ii = _mm_cvttpd_epi32 (u);
+		__m128d f = _mm_sub_pd (u, _mm_cvtepi32_pd (ii));
+		__m128d w = _mm_min_pd (_mm_max_pd (_mm_mul_pd (_mm_loadu_pd (M+k), imach), zero), wmax);
+		__m128i jj = _mm_cvttpd_epi32 (w);
+		__m128d g = _mm_sub_pd (w, _mm_cvtepi32_pd (jj));
+
+		int i0 = _mm_cvtsi128_si32 (ii), i1 = _mm_cvtsi128_si32 (_mm_srli_si128 (ii, 4));
+		int j0 = _mm_cvtsi128_si32 (jj), j1 = _mm_cvtsi128_si32 (_mm_srli_si128 (jj, 4));
+
+		__m128d a, b;
+		a = _mm_set_pd (AeroCL[i1], AeroCL[i0]);  b = _mm_set_pd (AeroCL[i1+1], AeroCL[i0+1]);
+		_mm_storeu_pd (cl+k, _mm_add_pd (a, _mm_mul_pd (_mm_sub_pd (b, a), f)));
+		a = _mm_set_pd (AeroCM[i1], AeroCM[i0]);  b = _mm_set_pd (AeroCM[i1+1], AeroCM[i0+1]);
+		_mm_storeu_pd (cm+k, _mm_add_pd (a, _mm_mul_pd (_mm_sub_pd (b, a), f)));
+		a = _mm_set_pd (AeroCD[i1], AeroCD[i0]);  b = _mm_set_pd (AeroCD[i1+1], AeroCD[i0+1]);
+		__m128d d = _mm_add_pd (a, _mm_mul_pd (_mm_sub_pd (b, a), f));
+		a = _mm_set_pd (AeroCDW[j1], AeroCDW[j0]);  b = _mm_set_pd (AeroCDW[j1+1], AeroCDW[j0+1]);
+		d = _mm_add_pd (_mm_add_pd (d, a), _mm_mul_pd (_mm_sub_pd (b, a), g));
+		_mm_storeu_pd (cd+k, d);
+	}
+	for (; k < n; k++)
+		Shuttle_MomentCoeff (aoa[k], M[k], Re ? Re[k] : 0, cl+k, cm+k, cd+k);
+}
+
+#ifdef _DEBUG
+// Debug builds compare the tables against the analytic model at points that fall between the table samples & write the worst error
+// to Orbiter.log, so a change to Shuttle_MomentCoeffRef that the table resolution cant follow shows up straight away. The batch
+// version is checked against the scalar one the same way.
+void Shuttle_CheckAeroTables ()
+{
+	int i;
+	double errl = 0, errm = 0, errd = 0;
+	for (i = 0; i < 20000; i++) {
+		double aoa = AERO_AOA0 + (i+0.37)*(2*PI/20000);
+		double M = (i%1000)*(AERO_MAXMACH/1000) + 0.0071;
+		double cl0, cm0, cd0, cl1, cm1, cd1;
+		Shuttle_MomentCoeffRef (aoa, M, 0, &cl0, &cm0, &cd0);
+		Shuttle_MomentCoeff (aoa, M, 0, &cl1, &cm1, &cd1);
+		errl = max (errl, fabs (cl1-cl0));
+		errm = max (errm, fabs (cm1-cm0));
+		errd = max (errd, fabs (cd1-cd0));
+	}
+	char cbuf[256];
+	sprintf (cbuf, "ShuttleD: aero table max error cl %g cm %g cd %g", errl, errm, errd);
+	oapiWriteLog (cbuf);
+
+	// the batch version has to agree with the scalar one to the last bit
+	static double aoa[1001], M[1001], cl[1001], cm[1001], cd[1001];
+	int nbad = 0;
+	for (i = 0; i < 1001; i++) {
+		aoa[i] = AERO_AOA0 - 0.1 + i*(2*PI+0.2)/1000;
+		M[i] = i*(AERO_MAXMACH+2.0)/1000;
+	}
+	Shuttle_MomentCoeffBatch (1001, aoa, M, 0, cl, cm, cd);
+	for (i = 0; i < 1001; i++) {
+		double cl1, cm1, cd1;
+		Shuttle_MomentCoeff (aoa[i], M[i], 0, &cl1, &cm1, &cd1);
+		if (cl1 != cl[i] || cm1 != cm[i] || cd1 != cd[i]) nbad++;
+	}
+	sprintf (cbuf, "ShuttleD: aero batch/scalar mismatches %d of 1001", nbad);
+	oapiWriteLog (cbuf);
+}
+#endif
+
+//=========================================================
+// Vessel Layout
+// The built-in RCS, cargo slot & action area layout, & the code that lets Shuttle-D.cfg replace any part of it. FindShuttleLayout
+// fills in one SHDLAYOUT per cfg file, the first time a vessel of that class runs clbkSetClassCaps, & every vessel after that
+// builds itself straight from it without looking at the cfg text again. A block in the cfg that is incomplete or doesnt make sense
+// gets a line in Orbiter.log & the built-in version of that block is used instead.
+//=========================================================
+
+#define COUNTOF(a) (sizeof(a)/sizeof((a)[0]))
+
+// The built-in layout. Thrusters & tanks are named by the enums below & the groups are bitmasks of thruster names, so every index
+// in these tables is checked by the compiler: a table that has the wrong number of entries, a group that names a thruster that
+// doesnt exist or a pair of opposite groups sharing a thruster wont compile. The cargo slots are generated from slot 0 & the
+// slot spacing, so they cant drift apart either.
+#define STATIC_CHECK(expr,name) typedef char static_check_##name[(expr) ? 1 : -1]
+#define TH(t) (1u << (t))
+
+enum {
+	RCS1, RCS2, RCS3, RCS4, RCS5, RCS6, RCS7, RCS8, RCS9, RCS10, RCS11, RCS12,
+	RCS_TANK_COUNT
+};
+
+enum {
+	CM_FWD_R, CM_FWD_L, CM_SIDE_R, CM_SIDE_L,							// crew module, forward & sideways
+	TRUSS_FWD_UP_R, TRUSS_FWD_UP_L, TRUSS_FWD_DOWN_R, TRUSS_FWD_DOWN_L,	// forward truss quads
+	TRUSS_AFT_UP_R, TRUSS_AFT_UP_L, TRUSS_AFT_DOWN_R, TRUSS_AFT_DOWN_L,	// aft truss quads
+	SM_BACK_R, SM_BACK_L, SM_SIDE_R, SM_SIDE_L,							// service module, backwards & sideways
+	RCS_TH_COUNT
+};
+
+enum {
+	GRP_PITCHUP   = TH(TRUSS_FWD_UP_R)|TH(TRUSS_FWD_UP_L)|TH(TRUSS_AFT_DOWN_R)|TH(TRUSS_AFT_DOWN_L),
+	GRP_PITCHDOWN = TH(TRUSS_FWD_DOWN_R)|TH(TRUSS_FWD_DOWN_L)|TH(TRUSS_AFT_UP_R)|TH(TRUSS_AFT_UP_L),
+	GRP_BANKLEFT  = TH(TRUSS_FWD_UP_R)|TH(TRUSS_FWD_DOWN_L)|TH(TRUSS_AFT_UP_R)|TH(TRUSS_AFT_DOWN_L),
+	GRP_BANKRIGHT = TH(TRUSS_FWD_UP_L)|TH(TRUSS_FWD_DOWN_R)|TH(TRUSS_AFT_UP_L)|TH(TRUSS_AFT_DOWN_R),
+	GRP_UP        = TH(TRUSS_FWD_UP_R)|TH(TRUSS_FWD_UP_L)|TH(TRUSS_AFT_UP_R)|TH(TRUSS_AFT_UP_L),
+	GRP_DOWN      = TH(TRUSS_FWD_DOWN_R)|TH(TRUSS_FWD_DOWN_L)|TH(TRUSS_AFT_DOWN_R)|TH(TRUSS_AFT_DOWN_L),
+	GRP_YAWLEFT   = TH(CM_SIDE_R)|TH(SM_SIDE_L),
+	GRP_YAWRIGHT  = TH(CM_SIDE_L)|TH(SM_SIDE_R),
+	GRP_LEFT      = TH(CM_SIDE_R)|TH(SM_SIDE_R),
+	GRP_RIGHT     = TH(CM_SIDE_L)|TH(SM_SIDE_L),
+	GRP_FORWARD   = TH(CM_FWD_R)|TH(CM_FWD_L),
+	GRP_BACK      = TH(SM_BACK_R)|TH(SM_BACK_L)
+};
+
+const VECTOR3 CARGO_SLOT0_POS = {-0.65,-3.3,11.53};		// position of cargo slot 0, the others follow it aft
+const double CARGO_SLOT0_RELEASE_X = 2;					// ground release point, beside the slot
+const double CARGO_SLOT0_RELEASE_Y = -3.6;
+const double CARGO_SLOT_SPACING = 1.3;					// distance between cargo slots in meters
+const int CARGO_SLOT_COUNT = 18;
+
+STATIC_CHECK(RCS_TANK_COUNT <= MAX_RCS_TANKS, rcs_tank_count);
+STATIC_CHECK(RCS_TH_COUNT <= MAX_RCS_THRUSTERS && RCS_TH_COUNT <= 32, rcs_thruster_count);
+STATIC_CHECK(CARGO_SLOT_COUNT <= MAX_CARGO_SLOTS, cargo_slot_count);
+STATIC_CHECK(((GRP_PITCHUP|GRP_PITCHDOWN|GRP_BANKLEFT|GRP_BANKRIGHT|GRP_UP|GRP_DOWN|GRP_YAWLEFT|GRP_YAWRIGHT|
+	GRP_LEFT|GRP_RIGHT|GRP_FORWARD|GRP_BACK) >> RCS_TH_COUNT) == 0, rcs_group_thrusters_exist);
+STATIC_CHECK((GRP_PITCHUP & GRP_PITCHDOWN) == 0, rcs_pitch_groups_disjoint);
+STATIC_CHECK((GRP_BANKLEFT & GRP_BANKRIGHT) == 0, rcs_bank_groups_disjoint);
+STATIC_CHECK((GRP_YAWLEFT & GRP_YAWRIGHT) == 0, rcs_yaw_groups_disjoint);
+STATIC_CHECK((GRP_UP & GRP_DOWN) == 0, rcs_updown_groups_disjoint);
+STATIC_CHECK((GRP_LEFT & GRP_RIGHT) == 0, rcs_leftright_groups_disjoint);
+STATIC_CHECK((GRP_FORWARD & GRP_BACK) == 0, rcs_forwardback_groups_disjoint);
+
+static const double RcsTankDefault[] = {
+	EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS,
+	EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS, EXP_RCSFUELMASS
+};
+STATIC_CHECK(COUNTOF(RcsTankDefault) == RCS_TANK_COUNT, rcs_tank_table);
+
+static const THRUSTERDEF RcsThrusterDefault[] = {
+	{{1.611,0,24.707}, {0,0,1}, RCSTH0, RCS1},			// CM FRONT RIGHT SIDE FORWARD
+	{{-1.611,0,24.707}, {0,0,1}, RCSTH1, RCS2},			// CM FRONT LEFT SIDE FORWARD
+	{{1.8505,0,24.306}, {-1,0,0}, RCSTH2, RCS1},		// CM FRONT RIGHT SIDE RIGHT
+	{{-1.8505,0,24.306}, {1,0,0}, RCSTH3, RCS2},		// CM FRONT LEFT SIDE LEFT
+	{{1.124,2.03,16.182}, {0,1,0}, RCSTH4, RCS3},		// TRUSS FORWARD RIGHT SIDE UP
+	{{-1.124,2.03,16.182}, {0,1,0}, RCSTH5, RCS4},		// TRUSS FORWARD LEFT SIDE UP
+	{{1.124,-1.951,16.182}, {0,-1,0}, RCSTH6, RCS5},	// TRUSS FORWARD RIGHT SIDE DOWN
+	{{-1.124,-1.951,16.182}, {0,-1,0}, RCSTH7, RCS6},	// TRUSS FORWARD LEFT SIDE DOWN
+	{{1.124,2.03,-16.125}, {0,1,0}, RCSTH8, RCS7},		// TRUSS AFT RIGHT SIDE UP
+	{{-1.124,2.03,-16.125}, {0,1,0}, RCSTH9, RCS8},		// TRUSS AFT LEFT SIDE UP
+	{{1.124,-1.951,-16.125}, {0,-1,0}, RCSTH10, RCS9},	// TRUSS AFT RIGHT SIDE DOWN
+	{{-1.124,-1.951,-16.125}, {0,-1,0}, RCSTH11, RCS10},	// TRUSS AFT LEFT SIDE DOWN
+	{{1.89,0,-29.371}, {0,0,-1}, RCSTH12, RCS11},		// SM BACK RIGHT SIDE BACKWARDS
+	{{-1.89,0,-29.371}, {0,0,-1}, RCSTH13, RCS12},		// SM BACK LEFT SIDE BACKWARDS
+	{{2.22,0,-28.963}, {-1,0,0}, RCSTH14, RCS11},		// SM BACK RIGHT SIDE RIGHT
+	{{-2.22,0,-28.963}, {1,0,0}, RCSTH15, RCS12},		// SM BACK LEFT SIDE LEFT
+};
+STATIC_CHECK(COUNTOF(RcsThrusterDefault) == RCS_TH_COUNT, rcs_thruster_table);
+
+static const EXHAUSTDEF RcsExhaustDefault[] = {
+	{SM_BACK_R, 1.9, 0.278, {1.611,0,24.707}, {0,0,1}},
+	{SM_BACK_L, 1.9, 0.278, {-1.611,0,24.707}, {0,0,1}},
+	{CM_SIDE_R, 1.9, 0.278, {1.8905,0,24.306}, {1,0,0}},
+	{CM_SIDE_L, 1.9, 0.278, {-1.8905,0,24.306}, {-1,0,0}},
+	{TRUSS_FWD_DOWN_R, 1.9, 0.278, {1.124,2.03,16.182}, {0,1,0}},
+	{TRUSS_FWD_DOWN_L, 1.9, 0.278, {-1.124,2.03,16.182}, {0,1,0}},
+	{TRUSS_FWD_UP_R, 1.9, 0.278, {1.124,-1.951,16.182}, {0,-1,0}},
+	{TRUSS_FWD_UP_L, 1.9, 0.278, {-1.124,-1.951,16.182}, {0,-1,0}},
+	{TRUSS_AFT_DOWN_R, 1.9, 0.278, {1.124,2.03,-16.125}, {0,1,0}},
+	{TRUSS_AFT_DOWN_L, 1.9, 0.278, {-1.124,2.03,-16.125}, {0,1,0}},
+	{TRUSS_AFT_UP_R, 1.9, 0.278, {1.124,-1.951,-16.125}, {0,-1,0}},
+	{TRUSS_AFT_UP_L, 1.9, 0.278, {-1.124,-1.951,-16.125}, {0,-1,0}},
+	{CM_FWD_R, 1.9, 0.278, {1.89,0,-29.371}, {0,0,-1}},
+	{CM_FWD_L, 1.9, 0.278, {-1.89,0,-29.371}, {0,0,-1}},
+	{SM_SIDE_R, 1.9, 0.278, {2.22,0,-28.963}, {1,0,0}},
+	{SM_SIDE_L, 1.9, 0.278, {-2.22,0,-28.963}, {-1,0,0}},
+};
+STATIC_CHECK(COUNTOF(RcsExhaustDefault) <= MAX_RCS_EXHAUSTS, rcs_exhaust_table);
+
+static const THGROUPDEF RcsGroupDefault[] = {
+	{THGROUP_ATT_PITCHUP, GRP_PITCHUP},
+	{THGROUP_ATT_PITCHDOWN, GRP_PITCHDOWN},
+	{THGROUP_ATT_BANKLEFT, GRP_BANKLEFT},
+	{THGROUP_ATT_BANKRIGHT, GRP_BANKRIGHT},
+	{THGROUP_ATT_UP, GRP_UP},
+	{THGROUP_ATT_DOWN, GRP_DOWN},
+	{THGROUP_ATT_YAWLEFT, GRP_YAWLEFT},
+	{THGROUP_ATT_YAWRIGHT, GRP_YAWRIGHT},
+	{THGROUP_ATT_LEFT, GRP_LEFT},
+	{THGROUP_ATT_RIGHT, GRP_RIGHT},
+	{THGROUP_ATT_FORWARD, GRP_FORWARD},
+	{THGROUP_ATT_BACK, GRP_BACK},
+};
+STATIC_CHECK(COUNTOF(RcsGroupDefault) <= MAX_RCS_GROUPS, rcs_group_table);
+
+#define CARGO_SLOT(i) {{CARGO_SLOT0_POS.x, CARGO_SLOT0_POS.y, CARGO_SLOT0_POS.z-(i)*CARGO_SLOT_SPACING}, {0,0,270}, \
+	{CARGO_SLOT0_RELEASE_X, CARGO_SLOT0_RELEASE_Y, CARGO_SLOT0_POS.z-(i)*CARGO_SLOT_SPACING}}
+
+static const CARGOSLOTDEF CargoSlotDefault[] = {
+	CARGO_SLOT(0),  CARGO_SLOT(1),  CARGO_SLOT(2),  CARGO_SLOT(3),  CARGO_SLOT(4),  CARGO_SLOT(5),
+	CARGO_SLOT(6),  CARGO_SLOT(7),  CARGO_SLOT(8),  CARGO_SLOT(9),  CARGO_SLOT(10), CARGO_SLOT(11),
+	CARGO_SLOT(12), CARGO_SLOT(13), CARGO_SLOT(14), CARGO_SLOT(15), CARGO_SLOT(16), CARGO_SLOT(17),
+};
+STATIC_CHECK(COUNTOF(CargoSlotDefault) == CARGO_SLOT_COUNT, cargo_slot_table);
+
+static const ACTIONAREADEF ActionAreaDefault[] = {
+	{{2,-3.05,12.63}, 2.9, "Payload Bay A Activated"},
+	{{0,3.120,-22.568}, 2.9, "Payload Bay B Activated"},
+	{{0,-0.937,26.2}, 4.5, "Airlock Activated"},
+};
+STATIC_CHECK(COUNTOF(ActionAreaDefault) <= MAX_ACTION_AREAS, action_area_table);
+
+static const struct { const char *name; THGROUP_TYPE type; } ThGroupNames[] = {
+	{"PITCHUP", THGROUP_ATT_PITCHUP}, {"PITCHDOWN", THGROUP_ATT_PITCHDOWN}, {"YAWLEFT", THGROUP_ATT_YAWLEFT},
+	{"YAWRIGHT", THGROUP_ATT_YAWRIGHT}, {"BANKLEFT", THGROUP_ATT_BANKLEFT}, {"BANKRIGHT", THGROUP_ATT_BANKRIGHT},
+	{"RIGHT", THGROUP_ATT_RIGHT}, {"LEFT", THGROUP_ATT_LEFT}, {"UP", THGROUP_ATT_UP}, {"DOWN", THGROUP_ATT_DOWN},
+	{"FORWARD", THGROUP_ATT_FORWARD}, {"BACK", THGROUP_ATT_BACK},
+};
+
+// the layouts read so far, see FindShuttleLayout
+struct LAYOUTENTRY { DWORD cfgsum; char cls[64]; SHDLAYOUT L; };
+LAYOUTENTRY ShuttleLayouts[MAX_LAYOUTS];
+int nShuttleLayouts = 0;
+bool bShuttleOptionsLoaded = false;
+bool bShuttleSnapshot = false;		// BINARY_SNAPSHOT in Shuttle-D.cfg
+bool bShuttleTelemetry = false;		// TELEMETRY in Shuttle-D.cfg
+bool bShuttleRecorder = false;		// FLIGHT_RECORDER in Shuttle-D.cfg
+int ShuttleInputLog = 0;			// INPUT_LOG in Shuttle-D.cfg: 0 off, 1 RECORD, 2 REPLAY
+bool UMmuCrewAddCallback (void *id, char *str, void *data);
+bool bShuttleProfile = false;		// PROFILE in Shuttle-D.cfg, see Profiling
+bool bShowProfile = false;			// the PROFILE key
+int ProfileReport (char *line, int i);
+bool WriteProfile (const char *path);
+void LoadKeyBindings (FILEHANDLE cfg);	// see Commands & Key Bindings
+void InvalidateLabels (char label[4][6][8]);	// see clbkVCRedrawEvent
+
+static bool ParseTank (const char *str, void *item)
+{
+	double *m = (double*)item;
+	return sscanf (str, "%lf", m) == 1 && *m > 0;
+}
+
+static bool ParseThruster (const char *str, void *item)
+{
+	THRUSTERDEF *t = (THRUSTERDEF*)item;
+	return sscanf (str, "%lf%lf%lf%lf%lf%lf%lf%d", &t->pos.x, &t->pos.y, &t->pos.z, &t->dir.x, &t->dir.y, &t->dir.z,
+		&t->maxth, &t->tank) == 8 && t->maxth > 0;
+}
+
+static bool ParseExhaust (const char *str, void *item)
+{
+	EXHAUSTDEF *e = (EXHAUSTDEF*)item;
+	return sscanf (str, "%d%lf%lf%lf%lf%lf%lf%lf%lf", &e->th, &e->lscale, &e->wscale, &e->pos.x, &e->pos.y, &e->pos.z,
+		&e->dir.x, &e->dir.y, &e->dir.z) == 9;
+}
+
+static bool ParseGroup (const char *str, void *item)
+{
+	THGROUPDEF *g = (THGROUPDEF*)item;
+	char name[32];
+	int i, th, len;
+	if (sscanf (str, "%31s%n", name, &len) != 1) return false;
+	for (i = 0; i < (int)COUNTOF(ThGroupNames) && _stricmp (name, ThGroupNames[i].name); i++);
+	if (i == COUNTOF(ThGroupNames)) return false;
+	g->type = ThGroupNames[i].type;
+	for (g->mask = 0, str += len; sscanf (str, "%d%n", &th, &len) == 1; str += len) {
+		if (th < 0 || th >= MAX_RCS_THRUSTERS) return false;
+		g->mask |= TH(th);
+	}
+	return g->mask != 0;
+}
+
+static bool ParseCargoSlot (const char *str, void *item)
+{
+	CARGOSLOTDEF *c = (CARGOSLOTDEF*)item;
+	return sscanf (str, "%lf%lf%lf%lf%lf%lf%lf%lf%lf", &c->pos.x, &c->pos.y, &c->pos.z, &c->rot.x, &c->rot.y, &c->rot.z,
+		&c->release.x, &c->release.y, &c->release.z) == 9;
+}
+
+static bool ParseActionArea (const char *str, void *item)
+{
+	ACTIONAREADEF *a = (ACTIONAREADEF*)item;
+	a->msg[0] = 0;
+	return sscanf (str, "%lf%lf%lf%lf %63[^\n]", &a->pos.x, &a->pos.y, &a->pos.z, &a->radius, a->msg) >= 4 && a->radius > 0;
+}
+
+// Reads one block of the layout, "countkey = n" followed by "key0" .. "key<n-1>", into the n items of size bytes at items.
+// A block that isnt in the cfg at all leaves n & items alone.
+static bool ReadLayoutBlock (FILEHANDLE cfg, const char *countkey, const char *key, int maxn, int &n, void *items, size_t size,
+	bool (*parse)(const char *str, void *item))
+{
+	char item[32], line[256];
+	int i, count;
+	strcpy (item, countkey);
+	if (!oapiReadItem_int (cfg, item, count))
+		return true;
+	if (count < 0 || count > maxn)
+		return false;
+	for (i = 0; i < count; i++) {
+		sprintf (item, "%s%d", key, i);
+		if (!oapiReadItem_string (cfg, item, line) || !parse (line, (char*)items + i*size))
+			return false;
+	}
+	n = count;
+	return true;
+}
+
+static void ShuttleLayoutError (const char *cls, const char *block)
+{
+	char cbuf[256];
+	sprintf (cbuf, "ShuttleD: %s in %s.cfg is incomplete or invalid, using the built-in layout for it", block, cls);
+	oapiWriteLog (cbuf);
+}
+
+// returns false if any block had to fall back to the built-in one
+static bool LoadShuttleLayout (FILEHANDLE cfg, const char *cls, SHDLAYOUT &L)
+{
+	bool clean = true;
+	int i;
+
+	memset (&L, 0, sizeof(L));	// padding too, it is part of the cache checksum
+	L.ntank = COUNTOF(RcsTankDefault);
+	memcpy (L.tank, RcsTankDefault, sizeof(RcsTankDefault));
+	L.nth = COUNTOF(RcsThrusterDefault);
+	memcpy (L.th, RcsThrusterDefault, sizeof(RcsThrusterDefault));
+	L.nexh = COUNTOF(RcsExhaustDefault);
+	memcpy (L.exh, RcsExhaustDefault, sizeof(RcsExhaustDefault));
+	L.ngroup = COUNTOF(RcsGroupDefault);
+	memcpy (L.group, RcsGroupDefault, sizeof(RcsGroupDefault));
+	L.nslot = COUNTOF(CargoSlotDefault);
+	memcpy (L.slot, CargoSlotDefault, sizeof(CargoSlotDefault));
+	L.narea = COUNTOF(ActionAreaDefault);
+	memcpy (L.area, ActionAreaDefault, sizeof(ActionAreaDefault));
+	if (!cfg) return true;
+
+	// The RCS blocks refer to each other by index, so they are read into a copy & only kept if they all agree
+	SHDLAYOUT T = L;
+	bool ok = ReadLayoutBlock (cfg, "RCS_TANKS", "RCS_TANK", MAX_RCS_TANKS, T.ntank, T.tank, sizeof(T.tank[0]), ParseTank)
+		&& ReadLayoutBlock (cfg, "RCS_THRUSTERS", "RCS_TH", MAX_RCS_THRUSTERS, T.nth, T.th, sizeof(T.th[0]), ParseThruster)
+		&& ReadLayoutBlock (cfg, "RCS_EXHAUSTS", "RCS_EXHAUST", MAX_RCS_EXHAUSTS, T.nexh, T.exh, sizeof(T.exh[0]), ParseExhaust)
+		&& ReadLayoutBlock (cfg, "RCS_GROUPS", "RCS_GROUP", MAX_RCS_GROUPS, T.ngroup, T.group, sizeof(T.group[0]), ParseGroup);
+	for (i = 0; ok && i < T.nth; i++)
+		ok = T.th[i].tank >= 0 && T.th[i].tank < T.ntank;
+	for (i = 0; ok && i < T.nexh; i++)
+		ok = T.exh[i].th >= 0 && T.exh[i].th < T.nth;
+	for (i = 0; ok && i < T.ngroup; i++)
+		ok = T.nth == 32 || (T.group[i].mask >> T.nth) == 0;
+	if (ok) {
+		L.ntank = T.ntank;  memcpy (L.tank, T.tank, sizeof(L.tank));
+		L.nth = T.nth;      memcpy (L.th, T.th, sizeof(L.th));
+		L.nexh = T.nexh;    memcpy (L.exh, T.exh, sizeof(L.exh));
+		L.ngroup = T.ngroup; memcpy (L.group, T.group, sizeof(L.group));
+	}
+	else {
+		ShuttleLayoutError (cls, "the RCS layout");
+		clean = false;
+	}
+
+	if (!ReadLayoutBlock (cfg, "CARGO_SLOTS", "CARGO_SLOT", MAX_CARGO_SLOTS, T.nslot, T.slot, sizeof(T.slot[0]), ParseCargoSlot)) {
+		ShuttleLayoutError (cls, "CARGO_SLOTS");
+		clean = false;
+	}
+	else {
+		L.nslot = T.nslot;  memcpy (L.slot, T.slot, sizeof(L.slot));
+	}
+	if (!ReadLayoutBlock (cfg, "ACTION_AREAS", "ACTION_AREA", MAX_ACTION_AREAS, T.narea, T.area, sizeof(T.area[0]), ParseActionArea)) {
+		ShuttleLayoutError (cls, "ACTION_AREAS");
+		clean = false;
+	}
+	else {
+		L.narea = T.narea;  memcpy (L.area, T.area, sizeof(L.area));
+	}
+	return clean;
+}
+
+// FNV-1a, the same as the snapshots use
+static DWORD LayoutChecksum (const void *data, size_t size, DWORD h = 2166136261u)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+// checksum of the whole cfg file, 0 if it cant be read
+static DWORD CfgFileChecksum (const char *path)
+{
+	FILE *f = fopen (path, "rb");
+	if (!f) return 0;
+	unsigned char buf[4096];
+	size_t n;
+	DWORD h = 2166136261u;
+	while ((n = fread (buf, 1, sizeof(buf), f)) > 0)
+		h = LayoutChecksum (buf, n, h);
+	fclose (f);
+	return h;
+}
+
+static void LayoutCachePath (const char *cls, char *path)
+{
+	sprintf (path, LAYOUT_CACHE_DIR "%s.bin", cls);
+	for (char *c = path + strlen (LAYOUT_CACHE_DIR); *c; c++)
+		if (*c == '\\' || *c == '/') *c = '_';	// a class in a subfolder of Config\Vessels
+}
+
+// copies the cached layout of cls into L if it was parsed from a cfg with the checksum cfgsum
+static bool ReadLayoutCache (const char *cls, DWORD cfgsum, SHDLAYOUT &L)
+{
+	char path[256];
+	LayoutCachePath (cls, path);
+	FILE *f = fopen (path, "rb");
+	if (!f) return false;
+	LAYOUTCACHE c;
+	bool ok = fread (&c, sizeof(c), 1, f) == 1 && c.magic == LAYOUT_CACHE_MAGIC && c.version == LAYOUT_CACHE_VERSION &&
+		c.size == sizeof(LAYOUTCACHE) && c.cfgsum == cfgsum && c.checksum == LayoutChecksum (&c.L, sizeof(c.L));
+	fclose (f);
+	if (ok) L = c.L;
+	return ok;
+}
+
+static void WriteLayoutCache (const char *cls, DWORD cfgsum, const SHDLAYOUT &L)
+{
+	char path[256];
+	LAYOUTCACHE c;
+	memset (&c, 0, sizeof(c));
+	c.magic = LAYOUT_CACHE_MAGIC;
+	c.version = LAYOUT_CACHE_VERSION;
+	c.size = sizeof(LAYOUTCACHE);
+	c.cfgsum = cfgsum;
+	c.L = L;
+	c.checksum = LayoutChecksum (&c.L, sizeof(c.L));
+	LayoutCachePath (cls, path);
+	CreateDirectory (LAYOUT_CACHE_DIR, NULL);
+	FILE *f = fopen (path, "wb");
+	if (!f) return;
+	fwrite (&c, sizeof(c), 1, f);
+	fclose (f);
+}
+
+// The layout for vessel class cls, whose cfg Orbiter has opened as cfg. Layouts are looked up by the checksum of the cfg file, so
+// two classes with the same cfg text share one, & a class gets parsed again if its cfg has changed on disk since. A cfg that cant
+// be opened here (Orbiter has it anyway) is looked up by class name instead. A new layout comes from the cache file if that was
+// made from the same cfg, otherwise it is parsed & the cache written, unless a block was bad & has to keep being reported.
+const SHDLAYOUT *FindShuttleLayout (FILEHANDLE cfg, const char *cls)
+{
+	char path[256], cbuf[256];
+	int i;
+	sprintf (path, "Config\\Vessels\\%s.cfg", cls);
+	DWORD cfgsum = CfgFileChecksum (path);
+	for (i = 0; i < nShuttleLayouts; i++)
+		if (ShuttleLayouts[i].cfgsum == cfgsum && (cfgsum || !strcmp (ShuttleLayouts[i].cls, cls)))
+			return &ShuttleLayouts[i].L;
+	if (nShuttleLayouts == MAX_LAYOUTS) {
+		sprintf (cbuf, "ShuttleD: more than %d different cfgs, %s uses the layout of %s", MAX_LAYOUTS, cls, ShuttleLayouts[0].cls);
+		oapiWriteLog (cbuf);
+		return &ShuttleLayouts[0].L;
+	}
+	for (i = 0; i < nShuttleLayouts; i++)
+		if (!strcmp (ShuttleLayouts[i].cls, cls)) {
+			sprintf (cbuf, "ShuttleD: %s.cfg has changed since the first %s was created, vessels created from now on use the new one",
+				cls, cls);
+			oapiWriteLog (cbuf);
+			break;
+		}
+
+	LAYOUTENTRY &e = ShuttleLayouts[nShuttleLayouts++];
+	e.cfgsum = cfgsum;
+	strncpy (e.cls, cls, sizeof(e.cls)-1);
+	e.cls[sizeof(e.cls)-1] = '\0';
+	const char *from = "the layout cache";
+	if (!cfgsum || !ReadLayoutCache (cls, cfgsum, e.L)) {
+		from = "its cfg";
+		if (LoadShuttleLayout (cfg, cls, e.L) && cfgsum)
+			WriteLayoutCache (cls, cfgsum, e.L);
+	}
+	sprintf (cbuf, "ShuttleD: %s layout read from %s, %d RCS thrusters, %d cargo slots, %d action areas", cls, from,
+		e.L.nth, e.L.nslot, e.L.narea);
+	oapiWriteLog (cbuf);
+	return &e.L;
+}
+
+//=========================================================
+// Event Scheduler
+// See SCHEDULER in D9base.h. ScheduleEvent puts an event into the wheel & CancelEvent takes it out again, RunEvents is called once
+// a step & hands whatever has come due to FireEvent, in the order the times come in (events due in the same tick in any order). The
+// wheel itself is the Sched functions below, which only know about the SCHEDULER, so debug builds can check them against a plain
+// list at startup (Shuttle_CheckScheduler). An event always fires at least one tick after it was scheduled & never before its
+// time, so an event for "now" comes in the next step, & one that schedules itself again cannot keep RunEvents going round.
+//=========================================================
+
+// index of the lowest bit set in x, which mustnt be 0
+static int LowestBit (unsigned long long x)
+{
+	static const int debruijn[64] = {
+		0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4, 62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+		63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+	};
+	return debruijn[((x & (0-x)) * (unsigned long long)0x03F79D71B4CB0A89) >> 58];
+}
+
+// the slots of a mask from slot on
+static unsigned long long SlotsFrom (unsigned long long mask, int slot)
+{
+	return slot < SCHED_SLOTS ? mask & (~(unsigned long long)0 << slot) : 0;
+}
+
+static void SchedInit (SCHEDULER &s)
+{
+	int i;
+	for (i = 0; i < SCHED_EVENTS; i++) {
+		s.ev[i].list = -1;
+		s.ev[i].next = i+1 < SCHED_EVENTS ? i+1 : -1;
+	}
+	for (i = 0; i <= SCHED_OVERFLOW; i++)
+		s.head[i] = -1;
+	for (i = 0; i < SCHED_LEVELS; i++)
+		s.mask[i] = 0;
+	s.free = 0;
+	s.count = 0;
+	s.now = 0;
+}
+
+// puts event i into the slot its tick goes in, seen from tick from
+static void SchedLink (SCHEDULER &s, int i, LONGLONG from)
+{
+	SCHEDEVENT &e = s.ev[i];
+	LONGLONG delta = e.tick - from;
+	int level;
+	for (level = 0; level < SCHED_LEVELS; level++)
+		if (delta < (LONGLONG)1 << (SCHED_BITS*(level+1))) break;
+	if (level < SCHED_LEVELS) {
+		int slot = (int)(e.tick >> (SCHED_BITS*level)) & (SCHED_SLOTS-1);
+		e.list = level*SCHED_SLOTS + slot;
+		s.mask[level] |= (unsigned long long)1 << slot;
+	} else
+		e.list = SCHED_OVERFLOW;
+	e.prev = -1;
+	e.next = s.head[e.list];
+	if (e.next >= 0) s.ev[e.next].prev = i;
+	s.head[e.list] = i;
+}
+
+static void SchedUnlink (SCHEDULER &s, int i)
+{
+	SCHEDEVENT &e = s.ev[i];
+	if (e.prev >= 0) s.ev[e.prev].next = e.next;
+	else s.head[e.list] = e.next;
+	if (e.next >= 0) s.ev[e.next].prev = e.prev;
+	if (s.head[e.list] < 0 && e.list < SCHED_OVERFLOW)
+		s.mask[e.list / SCHED_SLOTS] &= ~((unsigned long long)1 << (e.list % SCHED_SLOTS));
+}
+
+// -1 if the pool is full
+static int SchedAdd (SCHEDULER &s, LONGLONG tick)
+{
+	int i = s.free;
+	if (i < 0) return -1;
+	s.free = s.ev[i].next;
+	s.ev[i].tick = max (tick, s.now+1);
+	SchedLink (s, i, s.now);
+	s.count++;
+	return i;
+}
+
+static void SchedFree (SCHEDULER &s, int i)
+{
+	s.ev[i].list = -1;
+	s.ev[i].next = s.free;
+	s.free = i;
+	s.count--;
+}
+
+// shares the slots that come up at tick (the start of a level 0 round) out over the levels below
+static void SchedCascade (SCHEDULER &s, LONGLONG tick)
+{
+	for (int level = 1; level <= SCHED_LEVELS; level++) {
+		int slot = (int)(tick >> (SCHED_BITS*level)) & (SCHED_SLOTS-1);
+		int list = level < SCHED_LEVELS ? level*SCHED_SLOTS + slot : SCHED_OVERFLOW;
+		int i = s.head[list];
+		s.head[list] = -1;
+		if (level < SCHED_LEVELS)
+			s.mask[level] &= ~((unsigned long long)1 << slot);
+		while (i >= 0) {
+			int next = s.ev[i].next;
+			SchedLink (s, i, tick);
+			i = next;
+		}
+		if (slot) break;	// the level above only comes round when this one has
+	}
+}
+
+// with nothing in level 0, the first tick after tick that brings something down from the levels above
+static LONGLONG SchedNextCascade (const SCHEDULER &s, LONGLONG tick)
+{
+	for (int level = 1; level < SCHED_LEVELS; level++) {
+		int shift = SCHED_BITS*level;
+		LONGLONG round = (tick >> (shift+SCHED_BITS)) << (shift+SCHED_BITS);
+		int slot = (int)(tick >> shift) & (SCHED_SLOTS-1);
+		unsigned long long ahead = SlotsFrom (s.mask[level], slot+1);
+		if (ahead)
+			return round + ((LONGLONG)LowestBit (ahead) << shift);
+		if (s.mask[level])
+			return round + ((LONGLONG)1 << (shift+SCHED_BITS));	// only behind us, so not before this level comes round
+	}
+	return ((tick >> (SCHED_BITS*SCHED_LEVELS)) + 1) << (SCHED_BITS*SCHED_LEVELS);
+}
+
+// takes the next event due by tick target out of the wheel, or turns the wheel on to target & returns -1 if there are no more.
+// The event is still the caller's to SchedFree.
+static int SchedNextDue (SCHEDULER &s, LONGLONG target)
+{
+	for (;;) {
+		// whatever is in the slot of the tick just run is due at it, nothing for any later tick can be in there
+		int i = s.head[s.now & (SCHED_SLOTS-1)];
+		if (i >= 0) {
+			SchedUnlink (s, i);
+			return i;
+		}
+		if (s.now >= target) return -1;
+		if (!s.count) {
+			s.now = target;
+			return -1;
+		}
+		LONGLONG tick = s.now + 1;
+		int slot = (int)tick & (SCHED_SLOTS-1);
+		if (!slot) SchedCascade (s, tick);
+		unsigned long long ahead = SlotsFrom (s.mask[0], slot);
+		LONGLONG next;
+		if (ahead)
+			next = tick - slot + LowestBit (ahead);
+		else
+			next = (s.mask[0] ? (tick | (SCHED_SLOTS-1)) + 1 : SchedNextCascade (s, tick)) - 1;
+		s.now = min (next, target);
+	}
+}
+
+int ShuttleD::ScheduleEvent (double t, int type, int arg, DWORD seq)
+{
+	if (!(t < 1e12)) return -1;		// never, or near enough
+	int i = SchedAdd (sched, (LONGLONG)ceil (t*SCHED_TICKS));
+	if (i < 0) {
+		// the callers fall back on checking for themselves, so once in the log is enough
+		static bool logged = false;
+		if (!logged) oapiWriteLog ("Shuttle-D: event scheduler full, SCHED_EVENTS is too small");
+		logged = true;
+		return -1;
+	}
+	SCHEDEVENT &e = sched.ev[i];
+	e.t = t;
+	e.type = type;
+	e.arg = arg;
+	e.seq = seq;
+	return i;
+}
+
+void ShuttleD::CancelEvent (int e)
+{
+	if (e < 0 || sched.ev[e].list < 0) return;
+	SchedUnlink (sched, e);
+	SchedFree (sched, e);
+}
+
+// true if anything came due
+bool ShuttleD::RunEvents (double simt)
+{
+	LONGLONG target = (LONGLONG)floor (simt*SCHED_TICKS);
+	if (target <= sched.now) return false;
+	bool fired = false;
+	int i;
+	while ((i = SchedNextDue (sched, target)) >= 0) {
+		SCHEDEVENT e = sched.ev[i];
+		SchedFree (sched, i);		// first, so FireEvent can schedule the next one in its place
+		FireEvent (e, simt);
+		fired = true;
+	}
+	return fired;
+}
+
+void ShuttleD::FireEvent (const SCHEDEVENT &e, double simt)
+{
+	switch (e.type) {
+	case EV_HUD_EXPIRE: {
+		// the message may have been sent again since & stay up longer
+		HUDMSG &m = hudmsg[e.arg];
+		if (!(hud_live & (1u << e.arg)) || m.seq != e.seq) break;
+		if (m.expires > simt)
+			m.event = ScheduleEvent (m.expires, EV_HUD_EXPIRE, e.arg, e.seq);
+		else {
+			m.event = -1;
+			hud_live &= ~(1u << e.arg);
+		}
+		break; }
+	case EV_LIFESUPPORT:
+		ls.event = -1;
+		LifeSupportEmpty (simt);
+		break;
+	case EV_LS_WARNING:
+		ls.warn = -1;
+		LifeSupportWarning (e.arg, simt);
+		break;
+	case EV_ADD_CREW:
+		AddUMmuToVessel ();
+		break;
+	}
+}
+
+#ifdef _DEBUG
+// schedules & cancels a few thousand events at random over a couple of weeks & checks the wheel hands each one out in the first
+// step that gets to its tick, compared with just looking through all of them
+void Shuttle_CheckScheduler ()
+{
+	static SCHEDULER s;
+	LONGLONG tick[SCHED_EVENTS];
+	int errors = 0, fired = 0, i;
+	SchedInit (s);
+	srand (1);
+	for (i = 0; i < SCHED_EVENTS; i++) tick[i] = -1;
+	for (int step = 0; step < 20000; step++) {
+		for (int n = rand() % 3; n > 0; n--) {
+			static const LONGLONG range[4] = {64, 4096, 262144, 100000000};
+			LONGLONG t = s.now + (LONGLONG)(((double)rand()/RAND_MAX) * range[rand() % 4]);
+			if ((i = SchedAdd (s, t)) >= 0) tick[i] = s.ev[i].tick;
+		}
+		if (rand() % 4 == 0 && s.count && tick[i = rand() % SCHED_EVENTS] >= 0) {
+			SchedUnlink (s, i);
+			SchedFree (s, i);
+			tick[i] = -1;
+		}
+		LONGLONG target = s.now + (rand() % 8 ? rand() % 4 : (LONGLONG)(rand() % 32768) * 1000);
+		LONGLONG before = s.now;
+		while ((i = SchedNextDue (s, target)) >= 0) {
+			if (tick[i] <= before || tick[i] > target) errors++;
+			tick[i] = -1;
+			SchedFree (s, i);
+			fired++;
+		}
+		for (i = 0; i < SCHED_EVENTS; i++)
+			if (tick[i] >= 0 && tick[i] <= target) {
+				errors++;
+				tick[i] = -1;
+			}
+	}
+	char cbuf[128];
+	sprintf (cbuf, "Shuttle-D: scheduler check, %d events fired, %d wrong", fired, errors);
+	oapiWriteLog (cbuf);
+}
+#endif
+
 // ==============================================================
 // ShuttleD::ShuttleD (OBJHANDLE hObj, int fmodel)
 // To the best of my knowledge, this is called when a Shuttle-D is first created & allows parameters to be set to specific values right away.
@@ -61,13 +885,71 @@ void Shuttle_MomentCoeff (double aoa,double M,double Re,double *cl,double *cm,do
 ShuttleD::ShuttleD (OBJHANDLE hObj, int fmodel)
 	: VESSEL3 (hObj, fmodel)
 {
-	GEAR_status = GEAR_UP;
-	GEAR_proc = 0.0;
-	PLBAYA_status = PLBAYA_UP;
-	PLBAYA_proc = 0.0;
-	PLBAYB_status = PLBAYB_UP;
-	PLBAYB_proc = 0.0;
-	O2Tank = 1000;
+	for (int m = 0; m < MECH_COUNT; m++) {
+		mech[m].status = MECHANISM::CLOSED;
+		mech[m].proc = 0.0;
+		mech[m].speed = MechanismSpec[m].speed;
+		mech[m].anim = 0;
+		mech[m].wave_open = MechanismSpec[m].wave_open;
+		mech[m].wave_close = MechanismSpec[m].wave_close;
+		mech[m].started = false;
+	}
+	mech_moving = 0;
+	ls.t0 = 0;
+	for (int i = 0; i < LS_COUNT; i++) {
+		ls.level[i] = LS_CAPACITY[i];
+		ls.rate[i] = 0;
+	}
+	ls.crew = 0;
+	ls.empty = 0;
+	ls.tEmpty = 1e30;
+	ls.first = LS_O2;
+	ls.event = -1;
+	ls.warn = -1;
+	O2Tank = ls.level[LS_O2];
+	SchedInit (sched);
+
+	// negative values force the first clbkPostStep to send everything once
+	tdGearProc = -1;
+	massCargo = -1;
+
+	// mass properties start out as the dry vessel, the first clbkPostStep fills the items in
+	mp.mass = EXP_EMPTYMASS;
+	mp.sum_mr = mp.sum_mr2 = mp.cg = _V(0,0,0);
+	mp.pmi = mp.pmi_sent = EXP_PMI;
+	for (int k = 0; k < MASS_ITEMS; k++) {
+		mp.m[k] = 0;
+		mp.pos[k] = _V(0,0,0);	// cargo slot positions are filled in by clbkSetClassCaps
+	}
+	mp.pos[MASS_O2] = EXP_O2TANKPOS;
+	mp.pos[MASS_MAINFUEL] = EXP_MAINTANKPOS;
+
+	// work out the dry inertia that gives exactly EXP_PMI with full O2 & propellant & no cargo, then empty the items again
+	SetMassItem (MASS_O2, 1000);
+	SetMassItem (MASS_MAINFUEL, EXP_FUELMASS);
+	VECTOR3 cg = mp.sum_mr/mp.mass;
+	mp.I0 = _V(EXP_PMI.x, EXP_PMI.y, EXP_PMI.z)*mp.mass - mp.sum_mr2
+		+ _V(cg.y*cg.y+cg.z*cg.z, cg.x*cg.x+cg.z*cg.z, cg.x*cg.x+cg.y*cg.y)*mp.mass;
+	SetMassItem (MASS_O2, 0);
+	SetMassItem (MASS_MAINFUEL, 0);
+	MainFuel = 0;
+	nSteps = nFastSteps = 0;
+	tlm = NULL;
+	fdr = NULL;
+	ilog = NULL;
+	layout = NULL;
+	nLabelRedraws = nLabelSkips = 0;
+	tLabelRedraw = 0;
+	InvalidateLabels (mfdLabel);
+	rcs_failed = 0;
+	rcs_firing = false;
+	rcs.n = 0;
+	for (int t = 0; t < MAX_RCS_TANKS; t++) {
+		rcs.h[t] = 0;
+		rcs.mass[t] = rcs.max[t] = 0;
+	}
+	rcs.total = rcs.capacity = 0;
+	rcs.balancing = true;	// the scenario may have left the tanks uneven, so the first step reads & balances them
 
 	DefineAnimations();
 }
@@ -98,9 +980,9 @@ void ShuttleD::DefineAnimations()
 		_V(1,0,0),
 		(float)(90*RAD)
 		);
-	anim_gear = CreateAnimation (0);
-	AddAnimationComponent (anim_gear, 0, 1, &gear);
-	AddAnimationComponent (anim_gear, 0, 1, &gearf);
+	mech[MECH_GEAR].anim = CreateAnimation (0);
+	AddAnimationComponent (mech[MECH_GEAR].anim, 0, 1, &gear);
+	AddAnimationComponent (mech[MECH_GEAR].anim, 0, 1, &gearf);
 
 	static UINT PLBAYA[1] = {33};
 	static MGROUP_ROTATE PLBAYA1 (
@@ -111,8 +993,8 @@ void ShuttleD::DefineAnimations()
 		_V(0,0,1),
 		(float)(90*RAD)
 		);
-	anim_PLBAYA = CreateAnimation (0);
-	AddAnimationComponent (anim_PLBAYA, 0, 1, &PLBAYA1);
+	mech[MECH_PLBAYA].anim = CreateAnimation (0);
+	AddAnimationComponent (mech[MECH_PLBAYA].anim, 0, 1, &PLBAYA1);
 
 	static UINT PLBAYB[1] = {29};
 	static MGROUP_ROTATE PLBAYB1 (
@@ -123,131 +1005,111 @@ void ShuttleD::DefineAnimations()
 		_V(0,0,1),
 		(float)(-90*RAD)
 		);
-	anim_PLBAYB = CreateAnimation (0);
-	AddAnimationComponent (anim_PLBAYB, 0, 1, &PLBAYB1);
+	mech[MECH_PLBAYB].anim = CreateAnimation (0);
+	AddAnimationComponent (mech[MECH_PLBAYB].anim, 0, 1, &PLBAYB1);
 }
 
 //=========================================================
-// Revert Gear Function
-// This function is designed so that anytime it is called the landing gear will raise, lower, or reverse their previous motion
-// Ive broken up mine into 2 further subdivied functions Geardown & Gearup so that my VC buttons have a more logical layout to them than simply
-// "do what youre not doing right now"
+// Mechanisms
+// RevertMechanism is designed so that anytime it is called the gear or a set of bay doors will raise, lower, or reverse their previous
+// motion. Geardown/Gearup, MainBayOpen/MainBayClose & AuxBayOpen/AuxBayClose are built on top of it through MoveMechanism so that my VC
+// buttons have a more logical layout to them than simply "do what youre not doing right now".
+// StepMechanisms is the only thing that actually moves them, from clbkPostStep. It only visits entries whose bit is set in mech_moving,
+// only calls SetAnimation when the position changed, plays the start sound once when motion begins & calls MechanismStopped once when
+// the end of travel is reached.
 //=========================================================
 
-void ShuttleD::RevertGEAR (void)
+void ShuttleD::RevertMechanism (int m)
 {
-	GEAR_status = ((GEAR_status == GEAR_UP || GEAR_status == GEAR_RAISING) ?
-GEAR_LOWERING : GEAR_RAISING);
+	MECHANISM &mc = mech[m];
+	mc.status = ((mc.status == MECHANISM::CLOSED || mc.status == MECHANISM::CLOSING) ?
+MECHANISM::OPENING : MECHANISM::CLOSING);
+	mc.started = true;
+	mech_moving |= 1u << m;
 }
 
-double ShuttleD::Geardown ()
+void ShuttleD::MoveMechanism (int m, double from, const char *msgok, const char *msgbusy)
 {
-if (GEAR_proc == 1.000)
+if (mech[m].proc == from)
 		{
-RevertGEAR();
-		strcpy(SendHudMessage(),"Gear lowering");
+RevertMechanism(m);
+		HudMessage(HUD_INFO,"%s",msgok);
 	}
 else
 		{
-	strcpy(SendHudMessage(),"Gear down or in motion");
+	HudMessage(HUD_INFO,"%s",msgbusy);
 	}
-return true;
 }
 
-double ShuttleD::Gearup ()
+void ShuttleD::StepMechanisms (double simdt)
 {
-if (GEAR_proc == 0.000)
-		{
-RevertGEAR();
-	strcpy(SendHudMessage(),"Gear raising");
-	}
-else
-		{
-	strcpy(SendHudMessage(),"Gear up or in motion");
+	for (int m = 0; mech_moving >> m; m++) {
+		if (!(mech_moving & (1u << m))) continue;
+		MECHANISM &mc = mech[m];
+		bool opening = (mc.status == MECHANISM::OPENING);
+
+		if (mc.started) {
+			PROFILE_COUNT (PRC_PLAYWAVE);
+			PlayVesselWave(SHD, opening ? mc.wave_open : mc.wave_close);
+			mc.started = false;
+		}
+
+		double da = simdt * mc.speed;
+		double proc = (opening ? min (1.0, mc.proc+da) : max (0.0, mc.proc-da));
+		if (proc != mc.proc) {
+			mc.proc = proc;
+			PROFILE_COUNT (PRC_SETANIMATION);
+			SetAnimation (mc.anim, proc);
+		}
+		if (proc == (opening ? 1.0 : 0.0)) {
+			mc.status = (opening ? MECHANISM::OPEN : MECHANISM::CLOSED);
+			mech_moving &= ~(1u << m);
+			MechanismStopped (m);
+		}
 	}
-return true;
 }
 
-//=========================================================
-// Revert Main Payload Bay Doors Function
-// This function is designed so that anytime it is called the Main bay doors will raise, lower, or reverse their previous motion
-// Ive broken up mine into 2 further subdivied functions MainBayOpen & MainBayClose so that my VC buttons have a more logical layout to them than simply
-// "do what youre not doing right now"
-//=========================================================
-
-void ShuttleD::RevertPLBAYA (void)
+// Called once whenever a mechanism reaches the end of its travel. UCGO only lets cargo in & out while the main bay is fully open.
+void ShuttleD::MechanismStopped (int m)
 {
-	PLBAYA_status = ((PLBAYA_status == PLBAYA_UP || PLBAYA_status == PLBAYA_CLOSING) ?
-PLBAYA_OPENING : PLBAYA_CLOSING);
+	if (m == MECH_PLBAYA)
+		hUcgo.SetSlotDoorState(mech[m].status == MECHANISM::OPEN ? TRUE : FALSE);
 }
 
-double ShuttleD::MainBayOpen ()
+double ShuttleD::Geardown ()
 {
-if (PLBAYA_proc == 0.000)
-		{
-RevertPLBAYA();
-		strcpy(SendHudMessage(),"Main Payload bay opening");
-	}
-else
-		{
-	strcpy(SendHudMessage(),"Main bay open or in motion");
-	}
-return true;
+	MoveMechanism (MECH_GEAR, 1.0, "Gear lowering", "Gear down or in motion");
+	return true;
 }
 
-double ShuttleD::MainBayClose ()
+double ShuttleD::Gearup ()
 {
-if (PLBAYA_proc == 1.000)
-		{
-RevertPLBAYA();
-	strcpy(SendHudMessage(),"Main Payload Bay Closing");
-	}
-else
-		{
-	strcpy(SendHudMessage(),"Main bay closed or in motion");
-	}
-return true;
+	MoveMechanism (MECH_GEAR, 0.0, "Gear raising", "Gear up or in motion");
+	return true;
 }
 
-//=========================================================
-// Revert Auxiliary Payload Bay Doors Function
-// This function is designed so that anytime it is called the Aux bay doors will raise, lower, or reverse their previous motion
-// Ive broken up mine into 2 further subdivied functions AuxBayOpen & AuxBayClose so that my VC buttons have a more logical layout to them than simply
-// "do what youre not doing right now"
-//=========================================================
+double ShuttleD::MainBayOpen ()
+{
+	MoveMechanism (MECH_PLBAYA, 0.0, "Main Payload bay opening", "Main bay open or in motion");
+	return true;
+}
 
-void ShuttleD::RevertPLBAYB (void)
+double ShuttleD::MainBayClose ()
 {
-	PLBAYB_status = ((PLBAYB_status == PLBAYB_UP || PLBAYB_status == PLBAYB_CLOSING) ?
-PLBAYB_OPENING : PLBAYB_CLOSING);
+	MoveMechanism (MECH_PLBAYA, 1.0, "Main Payload Bay Closing", "Main bay closed or in motion");
+	return true;
 }
 
 double ShuttleD::AuxBayOpen ()
 {
-if (PLBAYB_proc == 0.000)
-		{
-RevertPLBAYB();
-		strcpy(SendHudMessage(),"Main Payload bay opening");
-	}
-else
-		{
-	strcpy(SendHudMessage(),"Main bay open or in motion");
-	}
-return true;
+	MoveMechanism (MECH_PLBAYB, 0.0, "Main Payload bay opening", "Main bay open or in motion");
+	return true;
 }
 
 double ShuttleD::AuxBayClose ()
 {
-if (PLBAYB_proc == 1.000)
-		{
-RevertPLBAYB();
-	strcpy(SendHudMessage(),"Main Payload Bay Closing");
-	}
-else
-		{
-	strcpy(SendHudMessage(),"Main bay closed or in motion");
-	}
-return true;
+	MoveMechanism (MECH_PLBAYB, 1.0, "Main Payload Bay Closing", "Main bay closed or in motion");
+	return true;
 }
 
 //=========================================================
@@ -267,6 +1129,239 @@ mass+=O2Tank;
 return mass;
 }
 
+//=========================================================
+// Mass Properties
+// SetMassItem changes the mass of one item in mp & adds just that difference into the totals. UpdateMassProperties is called from
+// clbkPostStep, checks the O2, main propellant & cargo against what mp already has, & only when something changed works out the
+// new centre of gravity & PMI. The PMI about the new centre of gravity goes to SetPMI (only if it moved noticeably), so a 50 t payload
+// in slot 0 handles differently from the same payload in slot 17. The centre of gravity itself is kept in mp.cg but the vessel frame
+// isnt shifted, as the touchdown points, UMmu airlock & VC cameras are all given in fixed vessel coordinates.
+// Returns true if anything had to be sent to Orbiter or UCGO.
+//=========================================================
+
+void ShuttleD::SetMassItem (int item, double m)
+{
+	double dm = m - mp.m[item];
+	const VECTOR3 &r = mp.pos[item];
+	mp.m[item] = m;
+	mp.mass += dm;
+	mp.sum_mr += r*dm;
+	mp.sum_mr2 += _V(r.y*r.y+r.z*r.z, r.x*r.x+r.z*r.z, r.x*r.x+r.y*r.y)*dm;
+}
+
+bool ShuttleD::UpdateMassProperties ()
+{
+	bool empty = false, items = false;
+
+	if (fabs (O2Tank-mp.m[MASS_O2]) >= MASS_UPDATE_STEP) {
+		SetMassItem (MASS_O2, O2Tank);
+		empty = true;
+	}
+
+	double CargoMass = hUcgo.GetCargoTotalMass();
+	if (CargoMass != massCargo) {
+		for (int i = 0; i < layout->nslot; i++)
+			SetMassItem (MASS_CARGO0+i, hUcgo.GetCargoSlotMass(i));
+		massCargo = CargoMass;
+		empty = true;
+	}
+
+	// Orbiter already counts the propellant in the total mass, it only matters here for the mass distribution
+	if (MainFuel) {
+		double fuel = GetPropellantMass (MainFuel);
+		if (fabs (fuel-mp.m[MASS_MAINFUEL]) >= MASS_UPDATE_STEP) {
+			SetMassItem (MASS_MAINFUEL, fuel);
+			items = true;
+		}
+	}
+
+	if (empty) {
+		// UCGO adds the cargo on top of whatever SetEmptyMass set, so the two calls always go together
+		PROFILE_COUNT (PRC_SETMASS);
+		SetEmptyMass(UpdateMass());
+		hUcgo.UpdateEmptyMass();
+	}
+	if (!empty && !items)
+		return false;
+
+	// parallel axis theorem: inertia of the items about the origin, moved to the new centre of gravity
+	VECTOR3 cg = mp.sum_mr/mp.mass;
+	VECTOR3 I = mp.I0 + mp.sum_mr2
+		- _V(cg.y*cg.y+cg.z*cg.z, cg.x*cg.x+cg.z*cg.z, cg.x*cg.x+cg.y*cg.y)*mp.mass;
+	mp.cg = cg;
+	mp.pmi = I/mp.mass;
+
+	if (fabs (mp.pmi.x-mp.pmi_sent.x) > 1e-3*mp.pmi_sent.x ||
+		fabs (mp.pmi.y-mp.pmi_sent.y) > 1e-3*mp.pmi_sent.y ||
+		fabs (mp.pmi.z-mp.pmi_sent.z) > 1e-3*mp.pmi_sent.z) {
+		PROFILE_COUNT (PRC_SETMASS);
+		SetPMI (mp.pmi);
+		mp.pmi_sent = mp.pmi;
+	}
+	return true;
+}
+
+//=========================================================
+// RCS Allocation
+// The thruster groups in the layout only say which thrusters are meant to help with an axis. BuildRcsAllocation works out how
+// hard each thruster has to fire from where they actually sit & point. For every group it looks for the thruster levels that give
+// a pure rotation (or translation) about that groups axis, as strong as the group itself, with nothing left over on the other
+// five axes (the yaw & sideways groups on their own push the nose sideways a little as well). Thrusters can only push, so this is
+// a least squares fit with the levels kept at zero or above, done one level at a time until it settles. A failed thruster simply
+// isnt allowed to take part, so the others cover for it as far as they can. Each column is then scaled so the busiest thruster is
+// at full throttle, which keeps the same control authority as the old fixed groups.
+// All of that only runs when the vessel is created or a thruster fails or comes back. Every step clbkPreStep just multiplies the
+// group levels Orbiter set through rcs_alloc, & when no group is firing it doesnt even do that.
+//=========================================================
+
+// which of the six axes a group acts on: rotation about x, y, z, then translation along x, y, z
+static int RcsGroupAxis (THGROUP_TYPE type)
+{
+	switch (type) {
+	case THGROUP_ATT_PITCHUP: case THGROUP_ATT_PITCHDOWN:	return 0;
+	case THGROUP_ATT_YAWLEFT: case THGROUP_ATT_YAWRIGHT:	return 1;
+	case THGROUP_ATT_BANKLEFT: case THGROUP_ATT_BANKRIGHT:	return 2;
+	case THGROUP_ATT_LEFT: case THGROUP_ATT_RIGHT:			return 3;
+	case THGROUP_ATT_UP: case THGROUP_ATT_DOWN:				return 4;
+	default:												return 5;
+	}
+}
+
+void ShuttleD::BuildRcsAllocation ()
+{
+	const SHDLAYOUT &L = *layout;
+	double B[6][MAX_RCS_THRUSTERS], scale[6];
+	int i, j, k, g;
+
+	// torque & force of each thruster at full throttle about the vessel origin (which is where Orbiter puts the centre of gravity)
+	for (i = 0; i < L.nth; i++) {
+		VECTOR3 F = L.th[i].dir*L.th[i].maxth;
+		VECTOR3 T = crossp (L.th[i].pos, F);
+		B[0][i] = T.x; B[1][i] = T.y; B[2][i] = T.z;
+		B[3][i] = F.x; B[4][i] = F.y; B[5][i] = F.z;
+	}
+	// torques & forces dont share units, so each axis is scaled by its strongest thruster before they are weighed against each other
+	for (k = 0; k < 6; k++) {
+		scale[k] = 0;
+		for (i = 0; i < L.nth; i++)
+			scale[k] = max (scale[k], fabs (B[k][i]));
+		for (i = 0; i < L.nth; i++)
+			B[k][i] = (scale[k] > 0 ? B[k][i]/scale[k] : 0);
+	}
+	for (i = 0; i < L.nth; i++)
+		if (rcs_failed & TH(i))
+			for (k = 0; k < 6; k++) B[k][i] = 0;
+
+	for (g = 0; g < L.ngroup; g++) {
+		// the target is whatever the groups members do together on the groups own axis, & nothing on the others. The search starts
+		// from the group itself, so a group that was already clean comes out unchanged.
+		int axis = RcsGroupAxis (L.group[g].type);
+		double target[6] = {0,0,0,0,0,0}, r[6], u[MAX_RCS_THRUSTERS], umax = 0;
+		for (i = 0; i < L.nth; i++) {
+			u[i] = ((L.group[g].mask & ~rcs_failed) & TH(i) ? 1.0 : 0.0);
+			if (L.group[g].mask & TH(i)) target[axis] += B[axis][i];
+		}
+
+		// r is always B*u - target
+		for (k = 0; k < 6; k++) {
+			r[k] = -target[k];
+			for (i = 0; i < L.nth; i++) r[k] += B[k][i]*u[i];
+		}
+		for (int pass = 0; pass < 200; pass++) {
+			double moved = 0;
+			for (i = 0; i < L.nth; i++) {
+				double bb = 0, br = 0;
+				for (k = 0; k < 6; k++) {
+					bb += B[k][i]*B[k][i];
+					br += B[k][i]*r[k];
+				}
+				if (bb == 0) continue;
+				double ui = max (0.0, u[i] - br/bb), du = ui - u[i];
+				if (du == 0) continue;
+				for (k = 0; k < 6; k++) r[k] += B[k][i]*du;
+				u[i] = ui;
+				moved = max (moved, fabs (du));
+			}
+			if (moved < 1e-9) break;
+		}
+
+		for (i = 0; i < L.nth; i++) umax = max (umax, u[i]);
+		for (i = 0; i < L.nth; i++)
+			rcs_alloc[i][g] = (umax > 0 ? u[i]/umax : 0);
+	}
+	for (j = 0; j < L.nth; j++)
+		if (rcs_failed & TH(j)) SetThrusterLevel (th_rcs[j], 0);
+	rcs_firing = true;	// make the next clbkPreStep set every level again
+}
+
+void ShuttleD::SetRcsThrusterFailed (int th, bool failed)
+{
+	if (th < 0 || th >= layout->nth) return;
+	unsigned int mask = (failed ? rcs_failed | TH(th) : rcs_failed & ~TH(th));
+	if (mask == rcs_failed) return;
+	rcs_failed = mask;
+	BuildRcsAllocation ();
+}
+
+//=========================================================
+// RCS Propellant
+// Each RCS quad still draws from its own tank, but the tanks are cross-fed so none of them runs dry while the others are still full.
+// BalanceRcsTanks moves propellant from the fuller tanks to the emptier ones until they are all at the same fraction of their
+// capacity, no faster than EXP_RCSXFEED per tank. The whole transfer is scaled down together when it is limited, so no propellant
+// is made or lost. The tanks are only looked at in a step where an RCS thruster fired, or while they are still being evened out
+// afterwards; in a quiet step nothing here runs at all. rcs.total is kept up to date as it goes, so RcsDeltaV doesnt have to ask
+// Orbiter about every tank.
+//=========================================================
+
+void ShuttleD::BalanceRcsTanks (double simdt)
+{
+	int i, n = (rcs.n+1) & ~1;
+	double total = 0;
+	for (i = 0; i < rcs.n; i++) {
+		rcs.mass[i] = GetPropellantMass (rcs.h[i]);
+		total += rcs.mass[i];
+	}
+	rcs.total = total;
+	if (rcs.capacity <= 0) {
+		rcs.balancing = false;
+		return;
+	}
+
+	// dm is what each tank needs to reach the common fill level; those add up to zero by construction
+	double dm[MAX_RCS_TANKS];
+	const __m128d fill = _mm_set1_pd (total/rcs.capacity);
+	const __m128d sign = _mm_set1_pd (-0.0);
+	__m128d big = _mm_setzero_pd ();
+	for (i = 0; i < n; i += 2) {
+		__m128d d = _mm_sub_pd (_mm_mul_pd (fill, _mm_loadu_pd (rcs.max+i)), _mm_loadu_pd (rcs.mass+i));
+		_mm_storeu_pd (dm+i, d);
+		big = _mm_max_pd (big, _mm_andnot_pd (sign, d));
+	}
+	double dmax = max (_mm_cvtsd_f64 (big), _mm_cvtsd_f64 (_mm_unpackhi_pd (big, big)));
+	if (dmax < 1e-6) {
+		rcs.balancing = false;
+		return;
+	}
+
+	double flow = EXP_RCSXFEED*simdt;
+	double k = (dmax > flow ? flow/dmax : 1.0);
+	const __m128d vk = _mm_set1_pd (k);
+	for (i = 0; i < n; i += 2)
+		_mm_storeu_pd (rcs.mass+i, _mm_add_pd (_mm_loadu_pd (rcs.mass+i), _mm_mul_pd (vk, _mm_loadu_pd (dm+i))));
+	for (i = 0; i < rcs.n; i++)
+		if (dm[i] != 0) SetPropellantMass (rcs.h[i], rcs.mass[i]);
+	rcs.balancing = (k < 1.0);
+}
+
+// usable RCS delta-v at the current total mass, in m/s
+double ShuttleD::RcsDeltaV ()
+{
+	double m = GetMass ();
+	if (rcs.total <= 0 || m <= rcs.total)
+		return 0;
+	return VACRCS_ISP*log (m/(m-rcs.total));
+}
+
 //=========================================================
 // O2Check Function
 // A very simple function here, that allows me to return the value of oxygen remaining in the tanks.
@@ -277,6 +1372,112 @@ double ShuttleD::O2Check ()
 return O2Tank;
 }
 
+//=========================================================
+// Life Support
+// See LIFESUPPORT in D9base.h. LifeSupportChanged brings the levels up to date & sets the rates for the crew now aboard; it is
+// called whenever someone comes aboard, leaves or is added, & once the scenario is loaded. NextLifeSupportEmpty works out when the
+// first consumable will run out & puts an EV_LIFESUPPORT event in for that time, so nothing looks at it until then, &
+// LifeSupportEmpty deals with whatever has run out once it does. On the way there EV_LS_WARNING events tell the crew at each
+// of LS_WARN_TIME. Anything already empty when someone comes aboard only gets them an alert, it doesnt kill them on the spot.
+// As the levels come from the time rather than from adding up steps, it all comes out the same at any time acceleration; a step
+// that goes past the time something ran out only makes the crew die a little later than they should have.
+//=========================================================
+
+static const char *LifeSupportName[LS_COUNT] = {"O2 Main Tank", "CO2 scrubbers", "Water tank", "Batteries"};
+static const char *LifeSupportEmptyText[LS_COUNT] = {
+	"O2 Main Tank empty", "CO2 scrubbers saturated", "Water tank empty", "Batteries flat, life support off"
+};
+
+double ShuttleD::LifeSupportLevel (int i, double simt) const
+{
+	return max (0.0, ls.level[i] - ls.rate[i]*(simt-ls.t0));
+}
+
+void ShuttleD::LifeSupportChanged ()
+{
+	double simt = oapiGetSimTime();
+	int crew = Crew.GetCrewTotalNumber();
+	ls.empty = 0;
+	for (int i = 0; i < LS_COUNT; i++)
+		if (LifeSupportLevel (i, simt) <= 0) {
+			ls.empty |= 1u << i;
+			if (crew) HudMessage(HUD_ALERT,"%s, no life support for the crew aboard",LifeSupportEmptyText[i]);
+		}
+	SetLifeSupportCrew (crew);
+}
+
+// brings the levels up to date & sets the rates for this many crew from now on
+void ShuttleD::SetLifeSupportCrew (int crew)
+{
+	double simt = oapiGetSimTime();
+	for (int i = 0; i < LS_COUNT; i++) {
+		ls.level[i] = LifeSupportLevel (i, simt);
+		ls.rate[i] = crew ? LS_BASERATE[i] + LS_CREWRATE[i]*crew : 0;
+	}
+	ls.t0 = simt;
+	ls.crew = crew;
+	O2Tank = ls.level[LS_O2];
+	NextLifeSupportEmpty ();
+}
+
+void ShuttleD::NextLifeSupportEmpty ()
+{
+	ls.tEmpty = 1e30;
+	for (int i = 0; i < LS_COUNT; i++)
+		if (ls.rate[i] > 0 && !(ls.empty & (1u << i)) && ls.t0 + ls.level[i]/ls.rate[i] < ls.tEmpty) {
+			ls.tEmpty = ls.t0 + ls.level[i]/ls.rate[i];
+			ls.first = i;
+		}
+	CancelEvent (ls.event);
+	ls.event = ScheduleEvent (ls.tEmpty, EV_LIFESUPPORT);
+	if (ls.event < 0 && ls.tEmpty < 1e12)
+		oapiWriteLog ("Shuttle-D: life support event not scheduled, checking it every step instead");
+
+	// the first warning still to come, or one straight away if we are already past the first of them
+	CancelEvent (ls.warn);
+	ls.warn = -1;
+	if (ls.tEmpty < 1e12) {
+		double simt = oapiGetSimTime();
+		int k = 0;
+		while (k < LS_WARNINGS-1 && ls.tEmpty - LS_WARN_TIME[k+1] <= simt) k++;
+		ls.warn = ScheduleEvent (max (simt, ls.tEmpty - LS_WARN_TIME[k]), EV_LS_WARNING, k);
+	}
+}
+
+// warning k of LS_WARN_TIME, & the next one after it
+void ShuttleD::LifeSupportWarning (int k, double simt)
+{
+	double left = ls.tEmpty - simt;
+	if (left > 86400)
+		HudMessage(HUD_WARNING,"%s runs out in %.1f days",LifeSupportName[ls.first],left/86400);
+	else
+		HudMessage(k == LS_WARNINGS-1 ? HUD_ALERT : HUD_WARNING,"%s runs out in %.1f hours",LifeSupportName[ls.first],max(0.0,left)/3600);
+	if (k+1 < LS_WARNINGS)
+		ls.warn = ScheduleEvent (ls.tEmpty - LS_WARN_TIME[k+1], EV_LS_WARNING, k+1);
+}
+
+void ShuttleD::LifeSupportEmpty (double simt)
+{
+	bool dead = false;
+	for (int i = 0; i < LS_COUNT; i++) {
+		if (ls.rate[i] <= 0 || (ls.empty & (1u << i)) || ls.t0 + ls.level[i]/ls.rate[i] > simt) continue;
+		ls.empty |= 1u << i;
+		if (ls.crew) {
+			// You ran out, sorry dude, time to kill you all :(
+			if (!dead)
+				for (int I = 0; I < Crew.GetCrewTotalNumber(); I++)
+					Crew.SetCrewMemberPulseBySlotNumber(I,0);	// set cardiac pulse to zero
+			dead = true;
+			HudMessage(HUD_ALERT,"%s-All crew dead",LifeSupportEmptyText[i]);
+		} else
+			HudMessage(HUD_WARNING,"%s",LifeSupportEmptyText[i]);
+	}
+	if (dead)
+		SetLifeSupportCrew (0);		// the dead dont use anything
+	else
+		NextLifeSupportEmpty ();
+}
+
 //=========================================================
 // Vessel Capabilities
 // This is what you might consider the core of the addon. In clbkSetClassCaps, all of the core information about the way a vessel behaves
@@ -287,16 +1488,31 @@ return O2Tank;
 //=========================================================
 void ShuttleD::clbkSetClassCaps (FILEHANDLE cfg)
 {
+	PROFILE_SCOPE (PRF_SETCLASSCAPS);
+	int i, j, n;
+	layout = FindShuttleLayout (cfg, GetClassName());
+	if (!bShuttleOptionsLoaded) {
+		oapiReadItem_bool (cfg, "BINARY_SNAPSHOT", bShuttleSnapshot);
+		oapiReadItem_bool (cfg, "TELEMETRY", bShuttleTelemetry);
+		oapiReadItem_bool (cfg, "FLIGHT_RECORDER", bShuttleRecorder);
+		char mode[32];
+		if (oapiReadItem_string (cfg, "INPUT_LOG", mode))
+			ShuttleInputLog = (!_stricmp (mode, "RECORD") ? 1 : !_stricmp (mode, "REPLAY") ? 2 : 0);
+		oapiReadItem_bool (cfg, "PROFILE", bShuttleProfile);
+		LoadKeyBindings (cfg);
+		bShuttleOptionsLoaded = true;
+	}
+	const SHDLAYOUT &L = *layout;
+
 	Crew.InitUmmu(GetHandle());	
 	Crew.DefineAirLockShape(TRUE,-1,1,-5.04,2.84, 23.93,26.93);
 	Crew.SetMembersPosRotOnEVA(_V(0,-0.937,25.935),_V(0,-225,0));
-	float UMmuVersion=Crew.GetUserUMmuVersion();
+	fUMmuVersion=Crew.GetUserUMmuVersion();
 	//	double UMmuVersion=Crew.GetUserUMmuVersion();
 	Crew.SetMaxSeatAvailableInShip(2);
 
-	Crew.DeclareActionArea(0,_V(2,-3.05,12.63),2.9,TRUE,"Sound\\ShuttleD\\ActionCommand.wav","Payload Bay A Activated");
-	Crew.DeclareActionArea(1,_V(0,3.120,-22.568),2.9,TRUE, "Sound\\ShuttleD\\ActionCommand.wav","Payload Bay B Activated");
-	Crew.DeclareActionArea(2,_V(0,-0.937,26.2),4.5,TRUE,"Sound\\ShuttleD\\ActionCommand.wav","Airlock Activated");
+	for (i = 0; i < L.narea; i++)
+		Crew.DeclareActionArea(i,L.area[i].pos,L.area[i].radius,TRUE,"Sound\\ShuttleD\\ActionCommand.wav",L.area[i].msg);
 
 
 
@@ -305,55 +1521,23 @@ void ShuttleD::clbkSetClassCaps (FILEHANDLE cfg)
 	SelectedUmmuMember =0;  // our current selected member
 
 
-	// The HUD display method variables, see PDF doc
-	cUmmuHudDisplay[0] =0;	// Initialisation of UMmu hud char variable
-	dHudMessageDelay =0;	// Initialisation of UMmu delay variable
-	strcpy(SendHudMessage(),"Welcome aboard. Press E to EVA, 1/2 to select crew, A to Open/Close airlock, 0 or 8 for info, and M to add crew.");
+	// The HUD messages, see clbkDrawHUD
+	hud_live = 0;
+	hud_seq = 0;
+	HudMessage(HUD_INFO,"Welcome aboard. Press E to EVA, 1/2 to select crew, A to Open/Close airlock, 0 or 8 for info, and M to add crew.");
 
 	// The Add mmu without scenery editor variable see PDF doc
 	cAddUMmuToVessel[0]=0;
 
 	//UCGO 2.0 Initialisation, cargo slot pos, rot declaration
 	hUcgo.Init(GetHandle());
-	// in contrary of the PDF code we declare 6 slots
-	// because it's fun :)
-	hUcgo.DeclareCargoSlot(0,_V(-0.65,-3.3,11.53),_V(0,0,270)); // slot 0
-	hUcgo.DeclareCargoSlot(1,_V(-0.65,-3.3,10.23),_V(0,0,270)); // slot 1
-	hUcgo.DeclareCargoSlot(2,_V(-0.65,-3.3,8.93),_V(0,0,270)); // slot 2
-	hUcgo.DeclareCargoSlot(3,_V(-0.65,-3.3,7.63),_V(0,0,270)); // slot 3
-	hUcgo.DeclareCargoSlot(4,_V(-0.65,-3.3,6.33),_V(0,0,270)); // slot 4
-	hUcgo.DeclareCargoSlot(5,_V(-0.65,-3.3,5.03),_V(0,0,270)); // slot 5
-	hUcgo.DeclareCargoSlot(6,_V(-0.65,-3.3,3.73),_V(0,0,270)); // slot 6
-	hUcgo.DeclareCargoSlot(7,_V(-0.65,-3.3,2.43),_V(0,0,270)); // slot 7
-	hUcgo.DeclareCargoSlot(8,_V(-0.65,-3.3,1.13),_V(0,0,270)); // slot 8
-	hUcgo.DeclareCargoSlot(9,_V(-0.65,-3.3,-0.17),_V(0,0,270)); // slot 9
-	hUcgo.DeclareCargoSlot(10,_V(-0.65,-3.3,-1.47),_V(0,0,270)); // slot 10
-	hUcgo.DeclareCargoSlot(11,_V(-0.65,-3.3,-2.77),_V(0,0,270)); // slot 11
-	hUcgo.DeclareCargoSlot(12,_V(-0.65,-3.3,-4.07),_V(0,0,270)); // slot 12
-	hUcgo.DeclareCargoSlot(13,_V(-0.65,-3.3,-5.37),_V(0,0,270)); // slot 13
-	hUcgo.DeclareCargoSlot(14,_V(-0.65,-3.3,-6.67),_V(0,0,270)); // slot 14
-	hUcgo.DeclareCargoSlot(15,_V(-0.65,-3.3,-7.97),_V(0,0,270)); // slot 15
-	hUcgo.DeclareCargoSlot(16,_V(-0.65,-3.3,-9.27),_V(0,0,270)); // slot 16
-	hUcgo.DeclareCargoSlot(17,_V(-0.65,-3.3,-10.57),_V(0,0,270)); // slot 17
-
-	hUcgo.SetSlotGroundReleasePos(0,_V(2,-3.6,11.53)); // slot 0
-	hUcgo.SetSlotGroundReleasePos(1,_V(2,-3.6,10.23)); // slot 1
-	hUcgo.SetSlotGroundReleasePos(2,_V(2,-3.6,8.93)); // slot 2
-	hUcgo.SetSlotGroundReleasePos(3,_V(2,-3.6,7.63)); // slot 3
-	hUcgo.SetSlotGroundReleasePos(4,_V(2,-3.6,6.33)); // slot 4
-	hUcgo.SetSlotGroundReleasePos(5,_V(2,-3.6,5.03)); // slot 5
-	hUcgo.SetSlotGroundReleasePos(6,_V(2,-3.6,3.73)); // slot 6
-	hUcgo.SetSlotGroundReleasePos(7,_V(2,-3.6,2.43)); // slot 7
-	hUcgo.SetSlotGroundReleasePos(8,_V(2,-3.6,1.13)); // slot 8
-	hUcgo.SetSlotGroundReleasePos(9,_V(2,-3.6,-0.17)); // slot 9
-	hUcgo.SetSlotGroundReleasePos(10,_V(2,-3.6,-1.47)); // slot 10
-	hUcgo.SetSlotGroundReleasePos(11,_V(2,-3.6,-2.77)); // slot 11
-	hUcgo.SetSlotGroundReleasePos(12,_V(2,-3.6,-4.07)); // slot 12
-	hUcgo.SetSlotGroundReleasePos(13,_V(2,-3.6,-5.37)); // slot 13
-	hUcgo.SetSlotGroundReleasePos(14,_V(2,-3.6,-6.67)); // slot 14
-	hUcgo.SetSlotGroundReleasePos(15,_V(2,-3.6,-7.97)); // slot 15
-	hUcgo.SetSlotGroundReleasePos(16,_V(2,-3.6,-9.27)); // slot 16
-	hUcgo.SetSlotGroundReleasePos(17,_V(2,-3.6,-10.57)); // slot 17
+	// in contrary of the PDF code we declare a whole payload bay of slots
+	// because it's fun :) They come from the vessel layout, see above.
+	for (i = 0; i < L.nslot; i++) {
+		hUcgo.DeclareCargoSlot(i,L.slot[i].pos,L.slot[i].rot);
+		hUcgo.SetSlotGroundReleasePos(i,L.slot[i].release);
+		mp.pos[MASS_CARGO0+i] = L.slot[i].pos;
+	}
 
 	// UCGO 2.0 Parameters settings
 	hUcgo.SetReleaseSpeedInSpace(0.001f);	   // release speed of cargo in space in m/s
@@ -362,13 +1546,11 @@ void ShuttleD::clbkSetClassCaps (FILEHANDLE cfg)
 
 
 	// UCGO Variables initialisation
-	cCargoHudDisplay[0]=0;						// Cargo hud display char variable
-	dCargHudMessageDelay=0;						// Cargo hud display delay
 	iSelectedCargo=-1;							// for the selection of cargos (-1 mean "default" see header)
 	// welcome message with keys for users
-	strcpy(SendCargHudMessage(),"Payload Controls C/Shift+C to grapple/release, 9/Shift+9 to add cargo.");
+	HudMessage(HUD_INFO,"Payload Controls C/Shift+C to grapple/release, 9/Shift+9 to add cargo.");
 
-	THRUSTER_HANDLE th_main, th_rcs[14], th_group[4];
+	THRUSTER_HANDLE th_main;
 	DOCKHANDLE Dock0;
 
 
@@ -389,7 +1571,7 @@ void ShuttleD::clbkSetClassCaps (FILEHANDLE cfg)
 
 
 
-	SetPMI (EXP_PMI);
+	SetPMI (mp.pmi_sent);
 	SetCrossSections (EXP_CS);
 	SetSurfaceFrictionCoeff (0.55, 0.79);
 	SetRotDrag (_V(0.9, 0.76, 0.2));
@@ -399,19 +1581,14 @@ void ShuttleD::clbkSetClassCaps (FILEHANDLE cfg)
 
 
 	// propellant resources
-	PROPELLANT_HANDLE MainFuel = CreatePropellantResource (EXP_FUELMASS);
-	PROPELLANT_HANDLE RCS1 = CreatePropellantResource (EXP_RCS1FUELMASS);
-	PROPELLANT_HANDLE RCS2 = CreatePropellantResource (EXP_RCS2FUELMASS);
-	PROPELLANT_HANDLE RCS3 = CreatePropellantResource (EXP_RCS3FUELMASS);
-	PROPELLANT_HANDLE RCS4 = CreatePropellantResource (EXP_RCS4FUELMASS);
-	PROPELLANT_HANDLE RCS5 = CreatePropellantResource (EXP_RCS5FUELMASS);
-	PROPELLANT_HANDLE RCS6 = CreatePropellantResource (EXP_RCS6FUELMASS);
-	PROPELLANT_HANDLE RCS7 = CreatePropellantResource (EXP_RCS7FUELMASS);
-	PROPELLANT_HANDLE RCS8 = CreatePropellantResource (EXP_RCS8FUELMASS);
-	PROPELLANT_HANDLE RCS9 = CreatePropellantResource (EXP_RCS9FUELMASS);
-	PROPELLANT_HANDLE RCS10 = CreatePropellantResource (EXP_RCS10FUELMASS);
-	PROPELLANT_HANDLE RCS11 = CreatePropellantResource (EXP_RCS11FUELMASS);
-	PROPELLANT_HANDLE RCS12 = CreatePropellantResource (EXP_RCS12FUELMASS);
+	MainFuel = CreatePropellantResource (EXP_FUELMASS);
+	rcs.n = L.ntank;
+	rcs.capacity = 0;
+	for (i = 0; i < L.ntank; i++) {
+		rcs.h[i] = CreatePropellantResource (L.tank[i]);
+		rcs.max[i] = L.tank[i];
+		rcs.capacity += L.tank[i];
+	}
 
 	// main engine
 	th_main = CreateThruster (_V(0,0,-35.82), _V(0,0,1), EXP_MAXMAINTH, MainFuel, VACSHD_ISP, NMLSHD_ISP, P_NML);
@@ -432,113 +1609,30 @@ void ShuttleD::clbkSetClassCaps (FILEHANDLE cfg)
 	AddExhaustStream (th_main, _V(0,0.13,-37.52), &contrail_main);
 	AddExhaustStream (th_main, _V(0,0.13,-37.52), &exhaust_main);
 
-	// RCS engines
-	th_rcs[0] = CreateThruster (_V( 1.611,0, 24.707), _V(0,0,1), RCSTH0, RCS1,  VACRCS_ISP, NMLRCS_ISP, P_NML);//CM FRONT RIGHT SIDE FORWARD
-	th_rcs[1] = CreateThruster (_V( -1.611,0, 24.707), _V(0,0,1), RCSTH1, RCS2,  VACRCS_ISP, NMLRCS_ISP, P_NML);//CM FRONT LEFT SIDE FORWARD
-
-	th_rcs[2] = CreateThruster (_V(1.8505,0, 24.306), _V(-1, 0,0), RCSTH2, RCS1,  VACRCS_ISP, NMLRCS_ISP, P_NML);//CM FRONT RIGHT SIDE RIGHT
-	th_rcs[3] = CreateThruster (_V(-1.8505,0, 24.306), _V(1,0,0), RCSTH3, RCS2,  VACRCS_ISP, NMLRCS_ISP, P_NML);//CM FRONT LEFT SIDE LEFT
-
-	th_rcs[4] = CreateThruster (_V( 1.124,2.03,16.182), _V(0, 1,0), RCSTH4, RCS3,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS FORWARD RIGHT SIDE UP
-	th_rcs[5] = CreateThruster (_V( -1.124,2.03,16.182), _V(0,1,0), RCSTH5, RCS4,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS FORWARD LEFT SIDE UP
-	th_rcs[6] = CreateThruster (_V(1.124,-1.951,16.182), _V(0,-1,0), RCSTH6, RCS5,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS FORWARD RIGHT SIDE DOWN
-	th_rcs[7] = CreateThruster (_V(-1.124,-1.951,16.182), _V(0,-1,0), RCSTH7, RCS6,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS FORWARD LEFT SIDE DOWN
-
-	th_rcs[8] = CreateThruster (_V( 1.124,2.03, -16.125), _V(0,1,0), RCSTH8, RCS7,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS AFT RIGHT SIDE UP
-	th_rcs[9] = CreateThruster (_V( -1.124,2.03, -16.125), _V( 0,1,0), RCSTH9, RCS8,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS AFT LEFT SIDE UP
-	th_rcs[10] = CreateThruster (_V(1.124,-1.951,-16.125), _V(0,-1,0), RCSTH10, RCS9,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS AFT RIGHT SIDE DOWN
-	th_rcs[11] = CreateThruster (_V(-1.124,-1.951,-16.125), _V( 0,-1,0), RCSTH11, RCS10,  VACRCS_ISP, NMLRCS_ISP, P_NML);//TRUSS AFT LEFT SIDE DOWN
-
-	th_rcs[12] = CreateThruster (_V( 1.89,0,-29.371), _V(0,0, -1), RCSTH12, RCS11,  VACRCS_ISP, NMLRCS_ISP, P_NML);//SM BACK RIGHT SIDE BACKWARDS
-	th_rcs[13] = CreateThruster (_V( -1.89,0,-29.371), _V(0,0,-1), RCSTH13, RCS12,  VACRCS_ISP, NMLRCS_ISP, P_NML);//SM BACK LEFT SIDE BACKWARDS
-
-	th_rcs[14] = CreateThruster (_V(2.22,0,-28.963), _V( -1,0,0), RCSTH14, RCS11,  VACRCS_ISP, NMLRCS_ISP, P_NML);//SM BACK RIGHT SIDE RIGHT
-	th_rcs[15] = CreateThruster (_V(-2.22,0,-28.963), _V(1,0, 0), RCSTH15, RCS12,  VACRCS_ISP, NMLRCS_ISP, P_NML);//SM BACK LEFT SIDE LEFT
+	// RCS engines, their exhausts & thruster groups, all from the vessel layout
+	for (i = 0; i < L.nth; i++)
+		th_rcs[i] = CreateThruster (L.th[i].pos, L.th[i].dir, L.th[i].maxth, rcs.h[L.th[i].tank], VACRCS_ISP, NMLRCS_ISP, P_NML);
 
 	SURFHANDLE texH2O2RCS = oapiRegisterExhaustTexture ("exhaust_atrcsShuttleD");
-
-	AddExhaust (th_rcs[12], 1.9,  0.278, _V( 1.611,0,24.707), _V(0,0,1), texH2O2RCS);
-	AddExhaust (th_rcs[13], 1.9,  0.278, _V( -1.611,0,24.707), _V(0,0,1), texH2O2RCS);
-
-	AddExhaust (th_rcs[2], 1.9, 0.278, _V(1.8905,0, 24.306), _V(1, 0,0), texH2O2RCS);
-	AddExhaust (th_rcs[3], 1.9, 0.278, _V(-1.8905,0, 24.306), _V(-1,0,0), texH2O2RCS);
-
-	AddExhaust (th_rcs[6], 1.9,  0.278, _V( 1.124,2.03,16.182), _V(0, 1,0), texH2O2RCS);
-	AddExhaust (th_rcs[7], 1.9,  0.278, _V( -1.124,2.03,16.182), _V(0,1,0), texH2O2RCS);
-	AddExhaust (th_rcs[4], 1.9, 0.278, _V(1.124,-1.951,16.182), _V(0,-1,0), texH2O2RCS);
-	AddExhaust (th_rcs[5], 1.9, 0.278, _V(-1.124,-1.951,16.182), _V(0,-1,0), texH2O2RCS);
-
-	AddExhaust (th_rcs[10], 1.9,  0.278, _V( 1.124,2.03, -16.125), _V(0,1,0), texH2O2RCS);
-	AddExhaust (th_rcs[11], 1.9,  0.278, _V( -1.124,2.03, -16.125), _V( 0,1,0), texH2O2RCS);
-	AddExhaust (th_rcs[8], 1.9, 0.278, _V(1.124,-1.951,-16.125), _V(0,-1,0), texH2O2RCS);
-	AddExhaust (th_rcs[9], 1.9, 0.278, _V(-1.124,-1.951,-16.125), _V( 0,-1,0), texH2O2RCS);
-
-	AddExhaust (th_rcs[0], 1.9,  0.278, _V( 1.89,0,-29.371), _V(0,0, -1), texH2O2RCS);
-	AddExhaust (th_rcs[1], 1.9,  0.278, _V( -1.89,0,-29.371), _V(0,0,-1), texH2O2RCS);
-
-	AddExhaust (th_rcs[14], 1.9, 0.278, _V(2.22,0,-28.963), _V( 1,0,0), texH2O2RCS);
-	AddExhaust (th_rcs[15], 1.9, 0.278, _V(-2.22,0,-28.963), _V(-1,0, 0), texH2O2RCS);
-
-
-	th_group[0] = th_rcs[4];
-	th_group[1] = th_rcs[5];
-	th_group[2] = th_rcs[10];
-	th_group[3] = th_rcs[11];
-	CreateThrusterGroup (th_group, 4, THGROUP_ATT_PITCHUP);
-
-	th_group[0] = th_rcs[6];
-	th_group[1] = th_rcs[7];
-	th_group[2] = th_rcs[8];
-	th_group[3] = th_rcs[9];
-	CreateThrusterGroup (th_group, 4, THGROUP_ATT_PITCHDOWN);
-
-	th_group[0] = th_rcs[4];
-	th_group[1] = th_rcs[7];
-	th_group[2] = th_rcs[8];
-	th_group[3] = th_rcs[11];
-	CreateThrusterGroup (th_group, 4, THGROUP_ATT_BANKLEFT);
-
-	th_group[0] = th_rcs[5];
-	th_group[1] = th_rcs[6];
-	th_group[2] = th_rcs[9];
-	th_group[3] = th_rcs[10];
-	CreateThrusterGroup (th_group, 4, THGROUP_ATT_BANKRIGHT);
-
-	th_group[0] = th_rcs[4];
-	th_group[1] = th_rcs[5];
-	th_group[2] = th_rcs[8];
-	th_group[3] = th_rcs[9];
-	CreateThrusterGroup (th_group, 4, THGROUP_ATT_UP);
-
-	th_group[0] = th_rcs[6];
-	th_group[1] = th_rcs[7];
-	th_group[2] = th_rcs[10];
-	th_group[3] = th_rcs[11];
-	CreateThrusterGroup (th_group, 4, THGROUP_ATT_DOWN);
-
-	th_group[0] = th_rcs[2];
-	th_group[1] = th_rcs[15];
-	CreateThrusterGroup (th_group, 2, THGROUP_ATT_YAWLEFT);
-
-	th_group[0] = th_rcs[3];
-	th_group[1] = th_rcs[14];
-	CreateThrusterGroup (th_group, 2, THGROUP_ATT_YAWRIGHT);
-
-	th_group[0] = th_rcs[2];
-	th_group[1] = th_rcs[14];
-	CreateThrusterGroup (th_group, 2, THGROUP_ATT_LEFT);
-
-	th_group[0] = th_rcs[3];
-	th_group[1] = th_rcs[15];
-	CreateThrusterGroup (th_group, 2, THGROUP_ATT_RIGHT);
-
-	th_group[0] = th_rcs[0];
-	th_group[1] = th_rcs[1];
-	CreateThrusterGroup (th_group, 2, THGROUP_ATT_FORWARD);
-
-	th_group[0] = th_rcs[12];
-	th_group[1] = th_rcs[13];
-	CreateThrusterGroup (th_group, 2, THGROUP_ATT_BACK);
+	for (i = 0; i < L.nexh; i++)
+		AddExhaust (th_rcs[L.exh[i].th], L.exh[i].lscale, L.exh[i].wscale, L.exh[i].pos, L.exh[i].dir, texH2O2RCS);
+
+	// Orbiter drives the RCS through the thruster groups, but the real thrusters arent in any of them. Each group gets a single
+	// thruster with no propellant instead, placed like the first member of the group with the thrust of all of them. It never pushes
+	// on anything, its level is just what the pilot or the autopilot asked for on that axis, & clbkPreStep turns that into levels for
+	// the real thrusters through the allocation matrix.
+	for (i = 0; i < L.ngroup; i++) {
+		double maxth = 0;
+		for (j = 0, n = -1; j < L.nth; j++)
+			if (L.group[i].mask & TH(j)) {
+				if (n < 0) n = j;
+				maxth += L.th[j].maxth;
+			}
+		if (n < 0) n = 0;	// an empty group gets an all zero column in the allocation, so it never fires
+		th_cmd[i] = CreateThruster (L.th[n].pos, L.th[n].dir, maxth, NULL, VACRCS_ISP, NMLRCS_ISP, P_NML);
+		CreateThrusterGroup (&th_cmd[i], 1, L.group[i].type);
+	}
+	BuildRcsAllocation ();
 
 	Dock0 = CreateDock(_V(0,-0.737,25.385),_V(0,0,1),_V(0,1,0));
 
@@ -557,15 +1651,113 @@ void ShuttleD::clbkMFDMode (int mfd, int mode)
 	//	use oapiTriggerVCRedrawArea for this ship, however, as there is no 2D panel.
 	switch (mfd) {
 	case MFD_LEFT:
-		oapiTriggerRedrawArea (1, 2, AID_MFD1_LBUTTONS);
-		oapiTriggerRedrawArea (1, 3, AID_MFD1_RBUTTONS);
+		oapiVCTriggerRedrawArea (-1, AID_MFD1_LBUTTONS);
+		oapiVCTriggerRedrawArea (-1, AID_MFD1_RBUTTONS);
 		break;
 		case MFD_RIGHT:
-		oapiTriggerRedrawArea (1, 2, AID_MFD2_LBUTTONS);
-		oapiTriggerRedrawArea (1, 3, AID_MFD2_RBUTTONS);
+		oapiVCTriggerRedrawArea (-1, AID_MFD2_LBUTTONS);
+		oapiVCTriggerRedrawArea (-1, AID_MFD2_RBUTTONS);
 	}
 }
 
+//=========================================================
+// VC Click Areas
+// Every hotspot in the VC, in mesh coordinates, with the cameras it is registered for. Orbiter forgets the areas each time the view
+// changes, so clbkLoadVC has to register them again for every camera, but now that is just one loop over this table. The MFD buttons
+// used to be typed out separately for the first two cameras, & the copies had drifted apart (MFD 2 sat 2 cm further left in camera 0
+// & the left column of MFD 1 had a 1 cm radius there, 3 cm everywhere else). They are generated from one set of numbers now, with a
+// radius that leaves a few millimetres between neighbouring buttons, including the right column of MFD 1 & the left column of MFD 2.
+// SHDBench -check holds the whole table to a minimum gap between spheres (see Shuttle_VCAreaGap).
+//=========================================================
+
+#define VC_CAM(n) (1u << (n))
+
+// MFD button layout: top button of each column, the step from one button to the next, & the bottom row
+const double VC_MFDBTN_Y0 = 2.4464, VC_MFDBTN_Z0 = 23.77135, VC_MFDBTN_DY = -0.0352, VC_MFDBTN_DZ = 0.0161;
+const double VC_MFDBTN_BY = 2.2081, VC_MFDBTN_BZ = 23.87965, VC_MFDBTN_BDX = 0.0387;
+const double VC_MFDBTN_RADIUS = 0.0160;
+const double VC_MFD1_LX = -0.07125, VC_MFD1_RX = 0.25895, VC_MFD1_BX = 0.05295;
+const double VC_MFD2_LX = 0.29325,  VC_MFD2_RX = 0.62355, VC_MFD2_BX = 0.4175;
+const double VC_SWITCH_RADIUS = 0.0140;
+const unsigned int VC_CAMS_MFD = VC_CAM(0) | VC_CAM(1);	// the two seats that can reach the MFDs
+const unsigned int VC_CAMS_SWITCH = VC_CAM(0);
+
+// what a click on an area does, see clbkVCMouseEvent
+enum { VCA_COMMAND, VCA_MFD_BUTTON, VCA_MFD_POWER, VCA_MFD_KEY };
+
+#define VC_SIDEBTN(id,x,i,mfd,n0) {(id)+(i), {x, VC_MFDBTN_Y0+(i)*VC_MFDBTN_DY, VC_MFDBTN_Z0+(i)*VC_MFDBTN_DZ}, VC_MFDBTN_RADIUS, \
+	PANEL_MOUSE_LBDOWN, VC_CAMS_MFD, VCA_MFD_BUTTON, mfd, (n0)+(i)}
+#define VC_SIDECOLUMN(id,x,mfd,n0) VC_SIDEBTN(id,x,0,mfd,n0), VC_SIDEBTN(id,x,1,mfd,n0), VC_SIDEBTN(id,x,2,mfd,n0), \
+	VC_SIDEBTN(id,x,3,mfd,n0), VC_SIDEBTN(id,x,4,mfd,n0), VC_SIDEBTN(id,x,5,mfd,n0)
+#define VC_BOTTOMBTN(id,x,i,mfd,action,arg) {(id)+(i), {(x)+(i)*VC_MFDBTN_BDX, VC_MFDBTN_BY, VC_MFDBTN_BZ}, VC_MFDBTN_RADIUS, \
+	PANEL_MOUSE_LBDOWN, VC_CAMS_MFD, action, mfd, arg}
+#define VC_BOTTOMROW(id,x,mfd) VC_BOTTOMBTN(id,x,0,mfd,VCA_MFD_POWER,0), VC_BOTTOMBTN(id,x,1,mfd,VCA_MFD_KEY,OAPI_KEY_F1), \
+	VC_BOTTOMBTN(id,x,2,mfd,VCA_MFD_KEY,OAPI_KEY_GRAVE)
+#define VC_SWITCH(id,x,y,z,cmd) {id, {x, y, z}, VC_SWITCH_RADIUS, PANEL_MOUSE_LBDOWN, VC_CAMS_SWITCH, VCA_COMMAND, 0, cmd}
+
+static const struct VCAREADEF {
+	int id;
+	VECTOR3 pos;		// centre of the click sphere
+	double radius;
+	int mousemode;
+	unsigned int cams;	// VC_CAM bits of the camera positions it is registered in
+	int action;			// VCA_ above
+	int mfd;			// MFD_LEFT or MFD_RIGHT for the MFD actions
+	int arg;			// command, MFD button number or MFD key
+} VCAreas[] = {
+	VC_SWITCH(AID_GEARDOWNSWITCH,    -0.06900, 2.5373, 23.7297, CMD_GEAR_DOWN),
+	VC_SWITCH(AID_GEARUPSWITCH,      -0.06900, 2.5637, 23.7176, CMD_GEAR_UP),
+	VC_SWITCH(AID_PLBAYACLOSESWITCH,  0.04784, 2.5373, 23.7297, CMD_PLBAYA_CLOSE),
+	VC_SWITCH(AID_PLBAYAOPENSWITCH,   0.04784, 2.5637, 23.7176, CMD_PLBAYA_OPEN),
+	VC_SWITCH(AID_PLBAYBCLOSESWITCH,  0.16468, 2.5373, 23.7297, CMD_PLBAYB_CLOSE),
+	VC_SWITCH(AID_PLBAYBOPENSWITCH,   0.16468, 2.5637, 23.7176, CMD_PLBAYB_OPEN),
+	VC_SIDECOLUMN(MFD1_LBUTTON1, VC_MFD1_LX, MFD_LEFT, 0),
+	VC_SIDECOLUMN(MFD1_RBUTTON1, VC_MFD1_RX, MFD_LEFT, 6),
+	VC_BOTTOMROW(MFD1_BBUTTON1, VC_MFD1_BX, MFD_LEFT),
+	VC_SIDECOLUMN(MFD2_LBUTTON1, VC_MFD2_LX, MFD_RIGHT, 0),
+	VC_SIDECOLUMN(MFD2_RBUTTON1, VC_MFD2_RX, MFD_RIGHT, 6),
+	VC_BOTTOMROW(MFD2_BBUTTON1, VC_MFD2_BX, MFD_RIGHT),
+};
+
+// VCAreas entry for each area id, filled in by Shuttle_IndexVCAreas when the module loads
+static const VCAREADEF *VCAreaById[VC_AREA_COUNT];
+
+void Shuttle_IndexVCAreas ()
+{
+	for (int i = 0; i < (int)(sizeof(VCAreas)/sizeof(VCAreas[0])); i++)
+		if (VCAreas[i].id >= 0 && VCAreas[i].id < VC_AREA_COUNT)
+			VCAreaById[VCAreas[i].id] = VCAreas + i;
+}
+
+// the MFD button label strips, redrawn into the MFD button texture (see clbkVCRedrawEvent). MFD 2 used to be registered on top of
+// the MFD 1 strips, now it has the next 64 pixels of the texture to itself.
+static const struct { int id, left, top, right, bottom; } VCLabelAreas[] = {
+	{AID_MFD1_LBUTTONS, 0, 0, 32, 220},
+	{AID_MFD1_RBUTTONS, 32, 0, 64, 220},
+	{AID_MFD2_LBUTTONS, 64, 0, 96, 220},
+	{AID_MFD2_RBUTTONS, 96, 0, 128, 220},
+};
+
+// The smallest gap between two click spheres registered for the same camera, & the ids of the two. Spheres that overlap (a negative
+// gap) send a click to whichever of them Orbiter happens to test first. SHDBench -check holds the table to a minimum gap.
+double Shuttle_VCAreaGap (int &id1, int &id2)
+{
+	const int n = sizeof(VCAreas)/sizeof(VCAreas[0]);
+	double gap = 1e10;
+	for (int i = 0; i < n; i++)
+		for (int j = i+1; j < n; j++) {
+			const VCAREADEF &a = VCAreas[i], &b = VCAreas[j];
+			double dx = a.pos.x-b.pos.x, dy = a.pos.y-b.pos.y, dz = a.pos.z-b.pos.z;
+			double d = sqrt (dx*dx + dy*dy + dz*dz) - a.radius - b.radius;
+			if ((a.cams & b.cams) && d < gap) {
+				gap = d;
+				id1 = a.id;
+				id2 = b.id;
+			}
+		}
+	return gap;
+}
+
 //=========================================================
 // clbkLoadVC
 // This is where most code for the VC is added. oapiVCRegisterMFD & VCHUDSPEC are used to "create" the MFDs and the Heads-up display. After that,
@@ -577,6 +1769,7 @@ void ShuttleD::clbkMFDMode (int mfd, int mode)
 
 bool ShuttleD::clbkLoadVC (int id)
 {
+	PROFILE_SCOPE (PRF_LOADVC);
 
 	//	 VCHUDSPEC hud;
 	VCMFDSPEC mfd;
@@ -601,6 +1794,19 @@ bool ShuttleD::clbkLoadVC (int id)
 	//	Get the MFDButtons.dds D texture for redrawing purposes.
 
 	int i;
+	InvalidateLabels (mfdLabel);	// the texture may have been reloaded, so draw every strip again
+	if (id >= 0 && id < 32) {
+		if (VC_CAMS_MFD & VC_CAM(id))
+			for (i = 0; i < (int)(sizeof(VCLabelAreas)/sizeof(VCLabelAreas[0])); i++)
+				oapiVCRegisterArea (VCLabelAreas[i].id, _R(VCLabelAreas[i].left, VCLabelAreas[i].top, VCLabelAreas[i].right,
+					VCLabelAreas[i].bottom), PANEL_REDRAW_USER, PANEL_MOUSE_IGNORE, PANEL_MAP_BACKGROUND, MFDbuttons1);
+		for (i = 0; i < (int)(sizeof(VCAreas)/sizeof(VCAreas[0])); i++)
+			if (VCAreas[i].cams & VC_CAM(id)) {
+				oapiVCRegisterArea (VCAreas[i].id, PANEL_REDRAW_NEVER, VCAreas[i].mousemode);
+				oapiVCSetAreaClickmode_Spherical (VCAreas[i].id, VCAreas[i].pos, VCAreas[i].radius);
+			}
+	}
+
 	switch (id) {
 
 	case 0:	//	The first VC cockpit view (id 0). Carefull with mixing up id.
@@ -616,70 +1822,6 @@ bool ShuttleD::clbkLoadVC (int id)
 		oapiVCRegisterMFD (MFD_RIGHT, &mfds_right);
 		oapiVCRegisterHUD (&hud_pilot); // HUD parameters
 
-
-		oapiVCRegisterArea (AID_GEARDOWNSWITCH, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-
-		oapiVCSetAreaClickmode_Spherical(AID_GEARDOWNSWITCH, _V(-0.06900, 2.5373, 23.7297), 0.0140);
-
-		oapiVCRegisterArea (AID_GEARUPSWITCH, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-
-		oapiVCSetAreaClickmode_Spherical(AID_GEARUPSWITCH, _V(-0.06900, 2.5637, 23.7176), 0.0140);
-
-		oapiVCRegisterArea (AID_PLBAYACLOSESWITCH, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-
-		oapiVCSetAreaClickmode_Spherical(AID_PLBAYACLOSESWITCH, _V(0.04784, 2.5373, 23.7297), 0.0140);
-
-		oapiVCRegisterArea (AID_PLBAYAOPENSWITCH, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-
-		oapiVCSetAreaClickmode_Spherical(AID_PLBAYAOPENSWITCH, _V(0.04784, 2.5637, 23.7176), 0.0140);
-
-		oapiVCRegisterArea (AID_PLBAYBCLOSESWITCH, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-
-		oapiVCSetAreaClickmode_Spherical(AID_PLBAYBCLOSESWITCH, _V(0.16468, 2.5373, 23.7297), 0.0140);
-
-		oapiVCRegisterArea (AID_PLBAYBOPENSWITCH, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-
-		oapiVCSetAreaClickmode_Spherical(AID_PLBAYBOPENSWITCH, _V(0.16468, 2.5637, 23.7176), 0.0140);
-
-
-		oapiVCRegisterArea (AID_MFD1_LBUTTONS, _R( 0, 0, 32, 220), PANEL_REDRAW_USER, PANEL_MOUSE_IGNORE, PANEL_MAP_BACKGROUND, MFDbuttons1);		
-
-		oapiVCRegisterArea (AID_MFD1_RBUTTONS, _R( 32, 0, 64, 220), PANEL_REDRAW_USER, PANEL_MOUSE_IGNORE, PANEL_MAP_BACKGROUND, MFDbuttons1);
-
-		oapiVCRegisterArea (AID_MFD2_LBUTTONS, _R( 0, 0, 32, 220), PANEL_REDRAW_USER, PANEL_MOUSE_IGNORE, PANEL_MAP_BACKGROUND, MFDbuttons1);		
-
-		oapiVCRegisterArea (AID_MFD2_RBUTTONS, _R( 32, 0, 64, 220), PANEL_REDRAW_USER, PANEL_MOUSE_IGNORE, PANEL_MAP_BACKGROUND, MFDbuttons1);
-
-		for (i = 0; i < 6; i++) {
-			oapiVCRegisterArea (MFD1_LBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD1_LBUTTON1+i, _V(-0.07125, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0100);
-
-			oapiVCRegisterArea (MFD1_RBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD1_RBUTTON1+i, _V(0.25895, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-		}
-		//	Define the area for mouse events on each button of left and right columns.
-
-		for (i = 0; i < 3; i++) {
-			oapiVCRegisterArea (MFD1_BBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD1_BBUTTON1+i, _V(0.05295 + (i * 0.0387), 2.2081, 23.87965), 0.0300);
-		}
-
-				for (i = 0; i < 6; i++) {
-			oapiVCRegisterArea (MFD2_LBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD2_LBUTTON1+i, _V(0.27325, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-
-			oapiVCRegisterArea (MFD2_RBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD2_RBUTTON1+i, _V(0.60355, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-		}
-		//	Define the area for mouse events on each button of left and right columns.
-
-		for (i = 0; i < 3; i++) {
-			oapiVCRegisterArea (MFD2_BBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD2_BBUTTON1+i, _V(0.3975 + (i * 0.0387), 2.2081, 23.87965), 0.0300);
-		}
-		//	Define the area for mouse events on the bottom buttons. Coordinates are in
-		//	mesh 3D coords (see why you needed to get this info?)
-
 		campos = CAM_VCPILOT;
 		break;
 
@@ -694,37 +1836,6 @@ bool ShuttleD::clbkLoadVC (int id)
 
 		oapiVCRegisterMFD (MFD_LEFT, &mfds_left);
 		oapiVCRegisterMFD (MFD_RIGHT, &mfds_right);
-
-				for (i = 0; i < 6; i++) {
-			oapiVCRegisterArea (MFD1_LBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD1_LBUTTON1+i, _V(-0.07125, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-
-			oapiVCRegisterArea (MFD1_RBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD1_RBUTTON1+i, _V(0.25895, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-		}
-		//	Define the area for mouse events on each button of left and right columns.
-
-		for (i = 0; i < 3; i++) {
-			oapiVCRegisterArea (MFD1_BBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD1_BBUTTON1+i, _V(0.05295 + (i * 0.0387), 2.2081, 23.87965), 0.0300);
-		}
-
-				for (i = 0; i < 6; i++) {
-			oapiVCRegisterArea (MFD2_LBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD2_LBUTTON1+i, _V(0.29325, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-
-			oapiVCRegisterArea (MFD2_RBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD2_RBUTTON1+i, _V(0.62355, 2.4464 - (i *0.0352), 23.77135 + (i *0.0161)), 0.0300);
-		}
-		//	Define the area for mouse events on each button of left and right columns.
-
-		for (i = 0; i < 3; i++) {
-			oapiVCRegisterArea (MFD2_BBUTTON1+i, PANEL_REDRAW_NEVER, PANEL_MOUSE_LBDOWN);
-			oapiVCSetAreaClickmode_Spherical(MFD2_BBUTTON1+i, _V(0.4175 + (i * 0.0387), 2.2081, 23.87965), 0.0300);
-		}
-		//	Define the area for mouse events on the bottom buttons. Coordinates are in
-		//	mesh 3D coords
-
 		campos = CAM_VCPSNGR1;
 		break;
 
@@ -763,143 +1874,170 @@ bool ShuttleD::clbkLoadVC (int id)
 //=========================================================
 // clbkDrawHUD
 // This code helps in drawing the custom hud displays that UMMU & UCGO use to send messages. All I really know about this at this point is that in
-//   5,hps->H/60*25,cUmmuHudDisplay 
-// 60 & 25 appear to change where the text appears on the display.
+//   5,hps->H/60*20
+// 60 & 20 appear to change where the text appears on the display.
+// The messages come out of the queue (see HUD Messages below), most severe first & newest first after that, one line each. Only the
+// entries whose bit is set in hud_live are looked at; the ones that have run out are taken off by their EV_HUD_EXPIRE event.
 //=========================================================
 
 bool ShuttleD::clbkDrawHUD(int mode, const HUDPAINTSPEC *hps, oapi::Sketchpad *skp)
 {
+	PROFILE_SCOPE (PRF_DRAWHUD);
 	// draw the default HUD
 	VESSEL3::clbkDrawHUD (mode, hps, skp);
 
-	// UMmu display messages
-	if(dHudMessageDelay>0)
-	{
-		skp->Text(5,hps->H/60*25,cUmmuHudDisplay,strlen(cUmmuHudDisplay));
-		dHudMessageDelay-=oapiGetSimStep();
-		if(dHudMessageDelay<0)
-			dHudMessageDelay=0;
+	// RCS propellant left & what it is worth
+	char cbuf[64];
+	sprintf (cbuf, "RCS %.0f kg  dV %.1f m/s", rcs.total, RcsDeltaV());
+	skp->Text(5,hps->H/60*15,cbuf,strlen(cbuf));
+
+	// UMmu, UCGO & our own messages
+	if (hud_live) {
+		int order[HUD_QUEUE], n = 0, i, j;
+		for (i = 0; hud_live >> i; i++) {
+			if (!(hud_live & (1u << i))) continue;
+			const HUDMSG &m = hudmsg[i];
+			if (m.event < 0 && m.expires <= oapiGetSimTime()) {
+				hud_live &= ~(1u << i);		// the scheduler had no room for its event
+				continue;
+			}
+			for (j = n++; j > 0; j--) {
+				const HUDMSG &o = hudmsg[order[j-1]];
+				if (o.severity > m.severity || (o.severity == m.severity && o.seq > m.seq)) break;
+				order[j] = order[j-1];
+			}
+			order[j] = i;
+		}
+		for (i = 0; i < n; i++) {
+			const HUDMSG &m = hudmsg[order[i]];
+			DWORD col = 0;
+			if (m.severity != HUD_INFO) col = skp->SetTextColor (m.severity == HUD_ALERT ? 0x0000FF : 0x00FFFF);
+			skp->Text (5, hps->H/60*(20+2*i), m.text, m.len);
+			if (m.severity != HUD_INFO) skp->SetTextColor (col);
+		}
 	}
-	// UCGO display messages
-	if(dCargHudMessageDelay>0)
-	{
-		skp->Text(5,hps->H/60*20,cCargoHudDisplay,strlen(cCargoHudDisplay));
-		dCargHudMessageDelay-=oapiGetSimStep();
-		if(dCargHudMessageDelay<0)
-			dCargHudMessageDelay=0;
+
+	// the profile, see Profiling
+	if (bShowProfile) {
+		char line[128];
+		for (int i = 0, n = ProfileReport (line, 0); n; n = ProfileReport (line, ++i))
+			skp->Text (hps->W/2, hps->H/60*15 + i*hps->H/45, line, n);
 	}
 	return true; 
 }
-char *ShuttleD::SendHudMessage() //<---- Change the class name here
+
+//=========================================================
+// HUD Messages
+// HudMessage works like sprintf into the message queue, see HUDMSG in the header. PostHudMessage puts a finished message in: if the
+// same text is already up it only stays up longer (& takes the higher severity), otherwise it goes into a free entry or the one
+// given up by the oldest of the least severe messages. If every message up is more severe than the new one, the new one is dropped.
+// A new entry schedules its EV_HUD_EXPIRE event, & the event of the message it replaces is cancelled, so there are never more
+// than HUD_QUEUE of them waiting; one that is only made to stay up longer finds that out when the event comes.
+// Nothing here allocates, the queue is part of the vessel.
+//=========================================================
+
+void ShuttleD::HudMessage (int severity, const char *fmt, ...)
+{
+	char text[HUD_MSGLEN];
+	va_list ap;
+	va_start (ap, fmt);
+	_vsnprintf (text, HUD_MSGLEN-1, fmt, ap);	// leaves it unterminated if it doesnt fit
+	va_end (ap);
+	text[HUD_MSGLEN-1] = 0;
+	PostHudMessage (severity, text, oapiGetSimTime() + (severity == HUD_ALERT ? HUD_ALERT_TIME : HUD_TIME));
+}
+
+void ShuttleD::PostHudMessage (int severity, const char *text, double expires)
 {
-	dHudMessageDelay=15;
-	return cUmmuHudDisplay;
+	double simt = oapiGetSimTime();
+	int len = (int)strlen (text);
+	if (len >= HUD_MSGLEN) len = HUD_MSGLEN-1;
+	DWORD hash = 2166136261u;	// FNV-1a, as for the snapshot checksum
+	for (int c = 0; c < len; c++)
+		hash = (hash ^ (unsigned char)text[c]) * 16777619u;
+
+	int i, slot = -1;
+	for (i = 0; i < HUD_QUEUE; i++) {
+		HUDMSG &m = hudmsg[i];
+		if (!(hud_live & (1u << i)) || m.expires <= simt) {
+			if (slot < 0) slot = i;
+			continue;
+		}
+		if (m.hash == hash && m.len == len && !memcmp (m.text, text, len)) {
+			if (expires > m.expires) m.expires = expires;
+			if (severity > m.severity) m.severity = severity;
+			return;
+		}
+	}
+	if (slot < 0) {
+		for (i = slot = 0; i < HUD_QUEUE; i++) {
+			const HUDMSG &m = hudmsg[i], &s = hudmsg[slot];
+			if (m.severity < s.severity || (m.severity == s.severity && m.seq < s.seq)) slot = i;
+		}
+		if (hudmsg[slot].severity > severity) return;
+	}
+
+	HUDMSG &m = hudmsg[slot];
+	if (hud_live & (1u << slot))
+		CancelEvent (m.event);		// given up before it ran out, or ran out but the event hasnt come yet
+	m.expires = expires;
+	m.seq = hud_seq++;
+	m.hash = hash;
+	m.severity = severity;
+	m.len = len;
+	memcpy (m.text, text, len);
+	m.text[len] = 0;
+	hud_live |= 1u << slot;
+	m.event = ScheduleEvent (expires, EV_HUD_EXPIRE, slot, m.seq);
 }
 
 //=========================================================
 // clbkVCMouseEvent
 // clbkVCMouseEvent acts as a sort of organizer for VC switch actions. Basically, when you create a VC mouseclick area up in clbkLoadVC, you give it an
 // id like AID_GEARDOWNSWITCH, then whenever it gets called (button pressed), whatever function you list here gets called, in this case Geardown()
+// What happens is now part of the area's entry in VCAreas (see VC Click Areas), either an MFD button or one of the keyboard commands,
+// so a click costs one lookup no matter how many controls the cockpit ends up with.
 //=========================================================
 
 bool ShuttleD::clbkVCMouseEvent (int id, int event, VECTOR3 &p)
 {
-	if ((id) >= MFD1_LBUTTON1 && (id) < MFD1_LBUTTON1 + 12)
-	{
-		oapiProcessMFDButton (MFD_LEFT, id - MFD1_LBUTTON1, event);
-		return true;
-	}
-	//	Processes the events for mouse clicks on VC view MFD buttons, left and
-	//	right columns, by matching the id of the event to the #defined identifier of
-	//	the button.
-
-	if ((id) == MFD1_BBUTTON1)
-	{
-		oapiToggleMFD_on (MFD_LEFT);
-		return true;
-	}
-	//	The ON / OFF button (left MFD button on the bottom).
-
-	if ((id) == MFD1_BBUTTON2)
-	{
-		oapiSendMFDKey (MFD_LEFT, OAPI_KEY_F1);
-		return true;
-	}
-	//	The MODE button (center MFD button on the bottom).
-
-	if ((id) == MFD1_BBUTTON3)
-	{
-		oapiSendMFDKey (MFD_LEFT, OAPI_KEY_GRAVE);
-		return true;
-	}
-	//	The MENU button (right MFD button on the bottom).
-
-		if ((id) >= MFD2_LBUTTON1 && (id) < MFD2_LBUTTON1 + 12)
-	{
-		oapiProcessMFDButton (MFD_RIGHT, id - MFD2_LBUTTON1, event);
-		return true;
-	}
-	//	Processes the events for mouse clicks on VC view MFD buttons, left and
-	//	right columns, by matching the id of the event to the #defined identifier of
-	//	the button (see AstroMatiz.h file).
-
-	if ((id) == MFD2_BBUTTON1)
-	{
-		oapiToggleMFD_on (MFD_RIGHT);
-		return true;
-	}
-	//	The ON / OFF button (left MFD button on the bottom).
-
-	if ((id) == MFD2_BBUTTON2)
-	{
-		oapiSendMFDKey (MFD_RIGHT, OAPI_KEY_F1);
-		return true;
-	}
-	//	The MODE button (center MFD button on the bottom).
-
-	if ((id) == MFD2_BBUTTON3)
-	{
-		oapiSendMFDKey (MFD_RIGHT, OAPI_KEY_GRAVE);
-		return true;
-	}
-	//	The MENU button (right MFD button on the bottom).
-
-	if ((id) == AID_GEARDOWNSWITCH)
-	{
-		Geardown();
-		return true;
-	}
+	if (ilog) {
+		if (ilog->replay)		// the clicks come from the log now
+			return true;
+		unsigned char c[30];
+		short sid = (short)id;
+		memcpy (c, &sid, 2);
+		memcpy (c+2, &event, 4);
+		memcpy (c+6, &p, 24);
+		LogEvent (IL_CLICK, c, 30);
+	}
+	return VCClick (id, event, p);
+}
 
-		if ((id) == AID_GEARUPSWITCH)
-	{
-		Gearup();
-		return true;
-	}
+bool ShuttleD::VCClick (int id, int event, VECTOR3 &p)
+{
+	// id is the area id from VCAreas, so the area itself is a single lookup away
+	if (id < 0 || id >= VC_AREA_COUNT || !VCAreaById[id])
+		return false;
+	const VCAREADEF &a = *VCAreaById[id];
 
-		if ((id) == AID_PLBAYAOPENSWITCH)
-	{
-		MainBayOpen();
+	switch (a.action) {
+	case VCA_COMMAND:		// the switches run the same commands as the keyboard
+		RunCommand (a.arg);
 		return true;
-	}
 
-		if ((id) == AID_PLBAYACLOSESWITCH)
-	{
-		MainBayClose();
+	case VCA_MFD_BUTTON:	// MFD buttons, left & right columns
+		oapiProcessMFDButton (a.mfd, a.arg, event);
 		return true;
-	}
 
-		if ((id) == AID_PLBAYBOPENSWITCH)
-	{
-		AuxBayOpen();
+	case VCA_MFD_POWER:		// the ON / OFF button (left MFD button on the bottom)
+		oapiToggleMFD_on (a.mfd);
 		return true;
-	}
 
-		if ((id) == AID_PLBAYBCLOSESWITCH)
-	{
-		AuxBayClose();
+	case VCA_MFD_KEY:		// the MODE & MENU buttons (center & right MFD buttons on the bottom)
+		oapiSendMFDKey (a.mfd, a.arg);
 		return true;
 	}
-
 	return false;
 }
 
@@ -907,35 +2045,104 @@ bool ShuttleD::clbkVCMouseEvent (int id, int event, VECTOR3 &p)
 // clbkVCRedrawEvent
 // Here there be dragons ;). The only thing I know about this is that it seems to be related to the text normally drawn onto a MFDs side switches.
 // That text did appear on various mesh groups in the VC during development, but I never could properly track it down & get it where I wanted it.
-// Maybe I can get it working in a future release.
+// Each of the four label strips (left & right column of each MFD) now remembers the labels it was last drawn with in mfdLabel, & when
+// Orbiter asks for a redraw with the same labels it returns false & leaves the texture alone. When something did change, the labels
+// are put together from GlyphAtlas, a strip of every character drawn once with hFont when it is first needed, so a redraw is a few
+// blits instead of a GDI DC & a TextOut per label. nLabelRedraws, nLabelSkips & tLabelRedraw keep count.
 //=========================================================
 
+const int GLYPH_FIRST = 32, GLYPH_COUNT = 96;	// printable ASCII
+const int GLYPH_CELL = 16, GLYPH_HEIGHT = 24;	// atlas cell size in pixels
+static SURFHANDLE GlyphAtlas = 0;
+static int GlyphWidth[GLYPH_COUNT];
+
+static void BuildGlyphAtlas ()
+{
+	GlyphAtlas = oapiCreateSurface (GLYPH_COUNT*GLYPH_CELL, GLYPH_HEIGHT);
+	oapiClearSurface (GlyphAtlas, 0);
+	HDC hDC = oapiGetDC (GlyphAtlas);
+	SelectObject (hDC, hFont);
+	SetTextColor (hDC, RGB(250, 250, 100));
+	SetBkMode (hDC, TRANSPARENT);
+	for (int g = 0; g < GLYPH_COUNT; g++) {
+		char c = (char)(GLYPH_FIRST+g);
+		SIZE size;
+		GetTextExtentPoint32 (hDC, &c, 1, &size);
+		GlyphWidth[g] = min ((int)size.cx, GLYPH_CELL);
+		TextOut (hDC, g*GLYPH_CELL, 0, &c, 1);
+	}
+	oapiReleaseDC (GlyphAtlas, hDC);
+}
+
+// sets every remembered label to one no MFD could have, so the next redraw of each strip draws
+void InvalidateLabels (char label[4][6][8])
+{
+	memset (label, 0, 4*6*8);
+	for (int i = 0; i < 4; i++)
+		for (int bt = 0; bt < 6; bt++) label[i][bt][0] = 1;
+}
+
+// label centred on cx with its top at y, the black atlas background is the colour key
+static void BlitLabel (SURFHANDLE surf, int cx, int y, const char *label)
+{
+	const char *c;
+	int x = 0;
+	for (c = label; *c; c++)
+		if (*c >= GLYPH_FIRST && *c < GLYPH_FIRST+GLYPH_COUNT) x += GlyphWidth[*c-GLYPH_FIRST];
+	x = cx - x/2;
+	for (c = label; *c; c++)
+		if (*c >= GLYPH_FIRST && *c < GLYPH_FIRST+GLYPH_COUNT) {
+			int g = *c-GLYPH_FIRST;
+			PROFILE_COUNT (PRC_BLT);
+			oapiBlt (surf, GlyphAtlas, x, y, g*GLYPH_CELL, 0, GlyphWidth[g], GLYPH_HEIGHT, 0);
+			x += GlyphWidth[g];
+		}
+}
+
 bool ShuttleD::clbkVCRedrawEvent (int id, int event, SURFHANDLE surf)
 {
-	int bt, side;
+	PROFILE_SCOPE (PRF_VCREDRAW);
+	int strip, bt;
 	switch (id) {
-		const char *label;
-	case AID_MFD1_LBUTTONS:
-	case AID_MFD1_RBUTTONS:
-		side = (id == AID_MFD1_LBUTTONS ? 0: 1);
-		HDC hDC = oapiGetDC (surf);
-		SelectObject (hDC, hFont);
-		SetTextColor (hDC, RGB(250, 250, 100));
-		SetTextAlign (hDC, TA_CENTER);
-		SetBkMode (hDC, TRANSPARENT);
-		for (bt = 0; bt < 6; bt++) {
-			if (label = oapiMFDButtonLabel (MFD_LEFT, bt+side*6))
-				TextOut (hDC, 16, 8+36*bt, label, strlen(label));
-			else break;
+	case AID_MFD1_LBUTTONS: strip = 0; break;
+	case AID_MFD1_RBUTTONS: strip = 1; break;
+	case AID_MFD2_LBUTTONS: strip = 2; break;
+	case AID_MFD2_RBUTTONS: strip = 3; break;
+	default: return false;
+	}
+	int mfd = (strip < 2 ? MFD_LEFT : MFD_RIGHT), side = strip & 1;
+
+	// the labels as they are now, up to the first button without one
+	char label[6][8];
+	bool same = true;
+	for (bt = 0; bt < 6; bt++) {
+		const char *l = oapiMFDButtonLabel (mfd, bt+side*6);
+		strncpy (label[bt], l ? l : "", 7);
+		label[bt][7] = 0;
+		if (strcmp (label[bt], mfdLabel[strip][bt])) same = false;
+		if (!l) {
+			for (bt++; bt < 6; bt++) label[bt][0] = 0;
+			break;
 		}
-
-
-		oapiReleaseDC (surf, hDC);
-		return true;
 	}
-	return false;
+	if (same) {
+		nLabelSkips++;
+		return false;
+	}
 
-};
+	LARGE_INTEGER t0, t1, freq;
+	QueryPerformanceCounter (&t0);
+	if (!GlyphAtlas)
+		BuildGlyphAtlas ();
+	for (bt = 0; bt < 6 && label[bt][0]; bt++)
+		BlitLabel (surf, 16, 8+36*bt, label[bt]);
+	memcpy (mfdLabel[strip], label, sizeof(label));
+	QueryPerformanceCounter (&t1);
+	QueryPerformanceFrequency (&freq);
+	nLabelRedraws++;
+	tLabelRedraw += (double)(t1.QuadPart-t0.QuadPart)/(double)freq.QuadPart;
+	return true;
+}
 
 //=========================================================
 // clbkLoadStateEx
@@ -949,72 +2156,376 @@ bool ShuttleD::clbkVCRedrawEvent (int id, int event, SURFHANDLE surf)
 //
 // The number 6 refers to the number of characters in O2Tank - 6. This is the length of the id string, NOT how many lines it has to slip down in the
 // scn file.
+// That is how it used to look, one check like that per key, each one tried on every line of the scenario. Now the keys are all in the
+// ScenarioKeys table below, the first word of a line is looked up there once & the line goes to exactly one place: our handler, UMmu,
+// UCGO or Orbiter. The numbers are read with strtod & friends, so a new key only needs a handler & a line in the table. clbkSaveState
+// goes through the same table, in the same order, so a key cant be saved without being loaded or the other way round.
 //=========================================================
+
+#define SCNKEY_ENTRY(key,read,write,arg) {key, sizeof(key)-1, read, write, arg}
+const ShuttleD::SCNKEY ShuttleD::ScenarioKeys[] = {
+	SCNKEY_ENTRY("GEAR",     &ShuttleD::ScnMechanism, &ShuttleD::ScnSaveMechanism, MECH_GEAR),
+	SCNKEY_ENTRY("PLBAYA",   &ShuttleD::ScnMechanism, &ShuttleD::ScnSaveMechanism, MECH_PLBAYA),
+	SCNKEY_ENTRY("PLBAYB",   &ShuttleD::ScnMechanism, &ShuttleD::ScnSaveMechanism, MECH_PLBAYB),
+	SCNKEY_ENTRY("O2Tank",   &ShuttleD::ScnConsumable, &ShuttleD::ScnSaveConsumable, LS_O2),
+	SCNKEY_ENTRY("CO2SCRUB", &ShuttleD::ScnConsumable, &ShuttleD::ScnSaveConsumable, LS_CO2),
+	SCNKEY_ENTRY("WATER",    &ShuttleD::ScnConsumable, &ShuttleD::ScnSaveConsumable, LS_WATER),
+	SCNKEY_ENTRY("POWER",    &ShuttleD::ScnConsumable, &ShuttleD::ScnSaveConsumable, LS_POWER),
+	SCNKEY_ENTRY("RCSFAIL",  &ShuttleD::ScnRcsFail,   &ShuttleD::ScnSaveRcsFail,   0),
+	SCNKEY_ENTRY("SNAPSHOT", &ShuttleD::ScnSnapshot,  &ShuttleD::ScnSaveSnapshot,  0),
+};
+
+// The vessel keys Orbiter itself writes. A line starting with anything else that nobody took is most likely a typo or left over from
+// a different vessel class, so its key goes in Orbiter.log. Only the first time though, a fleet of stock scenarios would otherwise
+// fill the log with the same line over & over.
+static const char *OrbiterScenarioKeys[] = {
+	"STATUS", "BASE", "RPOS", "RVEL", "AROT", "VROT", "ALT", "HEADING", "FUEL", "PRPLEVEL", "THLEVEL", "DOCKINFO", "IDS",
+	"NAVFREQ", "XPDR", "ATTACHED", "AFCMODE", "NAVMODE", "RCSMODE", "FLIGHTDATA", "LAND", "DAMAGE", "TRIM"
+};
+const int MAX_UNKNOWN_KEYS = 16;
+static char UnknownScenarioKeys[MAX_UNKNOWN_KEYS][32];
+static int nUnknownScenarioKeys = 0;
+
+static void ReportUnknownScenarioKey (const char *line, size_t len)
+{
+	int i, n;
+	if (!len) return;
+	for (i = 0, n = sizeof(OrbiterScenarioKeys)/sizeof(OrbiterScenarioKeys[0]); i < n; i++)
+		if (strlen (OrbiterScenarioKeys[i]) == len && !_strnicmp (line, OrbiterScenarioKeys[i], len)) return;
+	if (len > 31) len = 31;
+	for (i = 0; i < nUnknownScenarioKeys && i < MAX_UNKNOWN_KEYS; i++)
+		if (strlen (UnknownScenarioKeys[i]) == len && !_strnicmp (line, UnknownScenarioKeys[i], len)) return;
+	if (nUnknownScenarioKeys > MAX_UNKNOWN_KEYS) return;
+
+	char cbuf[128];
+	if (nUnknownScenarioKeys < MAX_UNKNOWN_KEYS) {
+		strncpy (UnknownScenarioKeys[nUnknownScenarioKeys], line, len);
+		UnknownScenarioKeys[nUnknownScenarioKeys][len] = 0;
+		sprintf (cbuf, "Shuttle-D: unknown scenario key %s, passed on to Orbiter", UnknownScenarioKeys[nUnknownScenarioKeys]);
+	} else
+		sprintf (cbuf, "Shuttle-D: more than %d unknown scenario keys, the rest are not reported", MAX_UNKNOWN_KEYS);
+	oapiWriteLog (cbuf);
+	nUnknownScenarioKeys++;
+}
+
+// a status outside MECHANISM::Status (a hand edited scenario) is taken as the nearest one
+void ShuttleD::ScnMechanism (const char *value, int m)
+{
+	char *end;
+	long status = strtol (value, &end, 10);
+	if (end == value) return;
+	mech[m].status = (MECHANISM::Status)max ((long)MECHANISM::CLOSED, min ((long)MECHANISM::OPENING, status));
+	mech[m].proc = max (0.0, min (1.0, strtod (end, NULL)));
+}
+
+// life support levels, see Life Support. They start from here once clbkPostCreation calls LifeSupportChanged.
+void ShuttleD::ScnConsumable (const char *value, int i)
+{
+	ls.level[i] = max (0.0, strtod (value, NULL));
+	if (i == LS_O2) O2Tank = ls.level[i];
+}
+
+void ShuttleD::ScnRcsFail (const char *value, int)
+{
+	rcs_failed = strtoul (value, NULL, 16);
+	BuildRcsAllocation ();
+}
+
+// only read once everything else is in, as it replaces the lines above & Orbiters own propellant levels
+void ShuttleD::ScnSnapshot (const char *value, int)
+{
+	char *end;
+	const char *p;
+	snapshotSum = strtoul (value, &end, 16);
+	for (p = end; *p == ' ' || *p == '\t'; p++);
+	if (end == value || strlen (p) >= sizeof(cSnapshotFile)) cSnapshotFile[0] = 0;
+	else strcpy (cSnapshotFile, p);
+}
+
 void ShuttleD::clbkLoadStateEx (FILEHANDLE scn, void *status)
 {
+	PROFILE_SCOPE (PRF_LOADSTATE);
 	char *line;
+	int i, n;
+	cSnapshotFile[0] = 0;
 	while (oapiReadScenario_nextline (scn, line)) 
 	{
-
-		if (!_strnicmp (line, "GEAR", 4)) {
-			sscanf (line+4, "%d%lf", &GEAR_status, &GEAR_proc);
-		}
-
-		if (!_strnicmp (line, "PLBAYA", 6)) {
-			sscanf (line+6, "%d%lf", &PLBAYA_status, &PLBAYA_proc);
-		}
-
-		if (!_strnicmp (line, "PLBAYB", 6)) {
-			sscanf (line+6, "%d%lf", &PLBAYB_status, &PLBAYB_proc);
+		// the key is the first word of the line, whatever comes after the spaces following it is the value
+		size_t len = strcspn (line, " \t");
+		const char *value = line+len;
+		while (*value == ' ' || *value == '\t') value++;
+
+		for (i = 0, n = sizeof(ScenarioKeys)/sizeof(ScenarioKeys[0]); i < n; i++)
+			if (ScenarioKeys[i].len == len && !_strnicmp (line, ScenarioKeys[i].key, len)) break;
+		if (i < n) {
+			(this->*ScenarioKeys[i].read) (value, ScenarioKeys[i].arg);
+			continue;
 		}
 
-		if (!_strnicmp (line, "O2Tank", 6)) {
-			sscanf (line+6, "%lf", &O2Tank);
+		BOOL taken;
+		{
+			PROFILE_SCOPE (PRF_UMMU_LOAD);
+			taken = Crew.LoadAllMembersFromOrbiterScenario(line);
 		}
-
-		if(Crew.LoadAllMembersFromOrbiterScenario(line)==TRUE)
+		if(taken==TRUE)
 			continue;
 
 		// Load UCGO 2.0 cargo from scenario
-		if(hUcgo.LoadCargoFromScenario(line)==TRUE) // UCGO load cargo 
+		{
+			PROFILE_SCOPE (PRF_UCGO_LOAD);
+			taken = hUcgo.LoadCargoFromScenario(line);
+		}
+		if(taken==TRUE) // UCGO load cargo 
 			continue;
 
+		// everything else is Orbiter's
+		ReportUnknownScenarioKey (line, len);
 		ParseScenarioLineEx (line, status);
 	}
-	SetAnimation (anim_gear, GEAR_proc);
-	SetAnimation (anim_PLBAYA, PLBAYA_proc);
-	SetAnimation (anim_PLBAYB, PLBAYB_proc);
+	if (cSnapshotFile[0] && !LoadSnapshot (cSnapshotFile, snapshotSum)) {
+		char cbuf[512];
+		sprintf (cbuf, "Shuttle-D: snapshot %s is missing or doesnt match the scenario, using the scenario values", cSnapshotFile);
+		oapiWriteLog (cbuf);
+	}
+	mech_moving = 0;
+	for (int m = 0; m < MECH_COUNT; m++) {
+		SetAnimation (mech[m].anim, mech[m].proc);
+		if (mech[m].status >= MECHANISM::CLOSING)
+			mech_moving |= 1u << m;
+	}
 
 }
 
 //=========================================================
 // clbkSaveState
-// Nothing too exciting here, just the same rules as above, but it is worth noting that in "%d %0.4f", the d & f appear to specify
-// the data type being saved. In other words, the specifier "%d" or "%0.4f" will determine how many zeroes get written to the SCN, &
-// as a result remembered.
+// Nothing too exciting here, just the same rules as above: every key in ScenarioKeys gets its line, in table order. The values are
+// formatted into ScnBuf, one buffer for the whole module, so a quicksave of a big fleet doesnt allocate anything or build each line
+// twice. Doubles get the fewest digits that still read back as exactly the same number (15, then 16, then 17 significant digits),
+// so a save & reload doesnt slowly wear the values down the way the old fixed "%0.4f" did.
 //=========================================================
 
-void ShuttleD::clbkSaveState (FILEHANDLE scn)
+// clbkSaveState is only ever called from Orbiters main thread, so one buffer does for every vessel
+static char ScnBuf[512];
+
+static char *PutInt (char *p, long v)
 {
-	char cbuf[256];
+	char tmp[16];
+	int n = 0;
+	unsigned long u = (v < 0 ? 0ul-(unsigned long)v : (unsigned long)v);
+	do { tmp[n++] = (char)('0' + u%10); u /= 10; } while (u);
+	if (v < 0) *p++ = '-';
+	while (n) *p++ = tmp[--n];
+	*p = 0;
+	return p;
+}
 
-	VESSEL3::clbkSaveState (scn);
-	sprintf (cbuf, "%d %0.4f", GEAR_status, GEAR_proc);
-	oapiWriteScenario_string (scn, "GEAR", cbuf);
+static char *PutHex (char *p, unsigned long v)
+{
+	char tmp[16];
+	int n = 0;
+	do { tmp[n++] = "0123456789abcdef"[v & 15]; v >>= 4; } while (v);
+	while (n) *p++ = tmp[--n];
+	*p = 0;
+	return p;
+}
+
+// shortest of %.15g, %.16g & %.17g that reads back bit-exactly (%.17g always does)
+static char *PutDouble (char *p, double v)
+{
+	int n = 0;
+	for (int prec = 15; prec <= 17; prec++) {
+		n = sprintf (p, "%.*g", prec, v);
+		if (strtod (p, NULL) == v) break;
+	}
+	return p+n;
+}
+
+char *ShuttleD::ScnSaveMechanism (char *buf, int m)
+{
+	buf = PutInt (buf, mech[m].status);
+	*buf++ = ' ';
+	return PutDouble (buf, mech[m].proc);
+}
+
+char *ShuttleD::ScnSaveConsumable (char *buf, int i)
+{
+	return PutDouble (buf, LifeSupportLevel (i, oapiGetSimTime()));
+}
 
-	sprintf (cbuf, "%d %0.4f", PLBAYA_status, PLBAYA_proc);
-	oapiWriteScenario_string (scn, "PLBAYA", cbuf);
+// failed RCS thrusters, one bit per thruster in layout order
+char *ShuttleD::ScnSaveRcsFail (char *buf, int)
+{
+	return (rcs_failed ? PutHex (buf, rcs_failed) : NULL);
+}
 
-	sprintf (cbuf, "%d %0.4f", PLBAYB_status, PLBAYB_proc);
-	oapiWriteScenario_string (scn, "PLBAYB", cbuf);
+// the checksum goes in the scenario before the path (which may have spaces in it), so a snapshot left behind by some other save
+// with the same vessel name isnt used
+char *ShuttleD::ScnSaveSnapshot (char *buf, int)
+{
+	if (!bShuttleSnapshot)
+		return NULL;
+	char path[256];
+	DWORD checksum;
+	sprintf (path, SNAPSHOT_DIR "%s.shd", GetName());
+	if (!SaveSnapshot (path, checksum))
+		return NULL;
+	buf += sprintf (buf, "%08lx ", checksum);
+	strcpy (buf, path);
+	return buf+strlen (path);
+}
 
-	sprintf (cbuf, "%0.4f", O2Tank);
-	oapiWriteScenario_string (scn, "O2Tank", cbuf);
+void ShuttleD::clbkSaveState (FILEHANDLE scn)
+{
+	PROFILE_SCOPE (PRF_SAVESTATE);
+	VESSEL3::clbkSaveState (scn);
+	for (int i = 0, n = sizeof(ScenarioKeys)/sizeof(ScenarioKeys[0]); i < n; i++)
+		if ((this->*ScenarioKeys[i].write) (ScnBuf, ScenarioKeys[i].arg))
+			oapiWriteScenario_string (scn, (char*)ScenarioKeys[i].key, ScnBuf);
 
-	Crew.SaveAllMembersInOrbiterScenarios(scn);
+	{
+		PROFILE_SCOPE (PRF_UMMU_SAVE);
+		Crew.SaveAllMembersInOrbiterScenarios(scn);
+	}
 
 	// Save UCGO 2.0 cargo in scenario
-	hUcgo.SaveCargoToScenario(scn);	
+	{
+		PROFILE_SCOPE (PRF_UCGO_SAVE);
+		hUcgo.SaveCargoToScenario(scn);	
+	}
+}
+
+//=========================================================
+// Binary Snapshot
+// SaveSnapshot fills in a SHDSNAPSHOT (see D9base.h) & writes it out as it is. LoadSnapshot maps the file into memory, checks the
+// header & checksum, & only then copies the values into the vessel, so a damaged, old or mismatched file changes nothing. In a debug
+// build every snapshot is read straight back after saving, compared with what was written & the load time goes to Orbiter.log.
+//=========================================================
+
+// FNV-1a over everything after the header
+static DWORD SnapshotChecksum (const SHDSNAPSHOT &snap)
+{
+	const unsigned char *p = (const unsigned char*)&snap + 4*sizeof(DWORD);
+	const unsigned char *end = (const unsigned char*)&snap + sizeof(SHDSNAPSHOT);
+	DWORD h = 2166136261u;
+	while (p < end)
+		h = (h ^ *p++) * 16777619u;
+	return h;
+}
+
+// maps the file & copies it into snap if it is a valid snapshot with the given checksum
+static bool ReadSnapshot (const char *path, DWORD checksum, SHDSNAPSHOT &snap)
+{
+	HANDLE hFile = CreateFile (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	bool ok = false;
+	if (GetFileSize (hFile, NULL) == sizeof(SHDSNAPSHOT)) {
+		HANDLE hMap = CreateFileMapping (hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMap) {
+			const SHDSNAPSHOT *view = (const SHDSNAPSHOT*)MapViewOfFile (hMap, FILE_MAP_READ, 0, 0, 0);
+			if (view) {
+				ok = view->magic == SNAPSHOT_MAGIC && view->version == SNAPSHOT_VERSION && view->size == sizeof(SHDSNAPSHOT) &&
+					view->checksum == checksum && SnapshotChecksum (*view) == checksum;
+				if (ok) memcpy (&snap, view, sizeof(SHDSNAPSHOT));
+				UnmapViewOfFile (view);
+			}
+			CloseHandle (hMap);
+		}
+	}
+	CloseHandle (hFile);
+	return ok;
+}
+
+bool ShuttleD::SaveSnapshot (const char *path, DWORD &checksum)
+{
+	SHDSNAPSHOT snap;
+	memset (&snap, 0, sizeof(snap));	// padding too, it is part of the checksum
+	snap.magic = SNAPSHOT_MAGIC;
+	snap.version = SNAPSHOT_VERSION;
+	snap.size = sizeof(SHDSNAPSHOT);
+	for (int m = 0; m < MECH_COUNT; m++) {
+		snap.mech_status[m] = mech[m].status;
+		snap.mech_proc[m] = mech[m].proc;
+	}
+	for (int i = 0; i < LS_COUNT; i++)
+		snap.ls_level[i] = LifeSupportLevel (i, oapiGetSimTime());
+	snap.mainfuel = (MainFuel ? GetPropellantMass (MainFuel) : 0);
+	for (int i = 0; i < rcs.n; i++)
+		snap.rcs_mass[i] = GetPropellantMass (rcs.h[i]);
+	snap.rcs_failed = rcs_failed;
+	snap.SelectedUmmuMember = SelectedUmmuMember;
+	snap.iSelectedCargo = iSelectedCargo;
+	double simt = oapiGetSimTime();
+	for (int i = 0; i < HUD_QUEUE; i++)
+		if ((hud_live & (1u << i)) && hudmsg[i].expires > simt) {
+			snap.hud[i] = hudmsg[i];
+			snap.hud[i].expires -= simt;
+			snap.hud[i].event = -1;		// an index into this vessel's scheduler, which the next load hands out afresh
+		}
+	snap.checksum = checksum = SnapshotChecksum (snap);
+
+	CreateDirectory (SNAPSHOT_DIR, NULL);
+	FILE *f = fopen (path, "wb");
+	if (!f) return false;
+	bool ok = fwrite (&snap, sizeof(snap), 1, f) == 1;
+	if (fclose (f) != 0) ok = false;
+
+#ifdef _DEBUG
+	if (ok) {
+		SHDSNAPSHOT back;
+		LARGE_INTEGER t0, t1, freq;
+		QueryPerformanceCounter (&t0);
+		bool same = ReadSnapshot (path, checksum, back) && !memcmp (&back, &snap, sizeof(snap));
+		QueryPerformanceCounter (&t1);
+		QueryPerformanceFrequency (&freq);
+		char cbuf[512];
+		sprintf (cbuf, "Shuttle-D: snapshot %s round trip %s, read in %.1f us", path, same ? "ok" : "FAILED",
+			(double)(t1.QuadPart-t0.QuadPart)*1e6/(double)freq.QuadPart);
+		oapiWriteLog (cbuf);
+	}
+#endif
+	return ok;
+}
+
+bool ShuttleD::LoadSnapshot (const char *path, DWORD checksum)
+{
+	SHDSNAPSHOT snap;
+	if (!ReadSnapshot (path, checksum, snap))
+		return false;
+
+	for (int m = 0; m < MECH_COUNT; m++) {	// held to the same range as ScnMechanism does
+		mech[m].status = (MECHANISM::Status)max ((long)MECHANISM::CLOSED, min ((long)MECHANISM::OPENING, (long)snap.mech_status[m]));
+		mech[m].proc = max (0.0, min (1.0, snap.mech_proc[m]));
+	}
+	for (int i = 0; i < LS_COUNT; i++)
+		ls.level[i] = snap.ls_level[i];
+	O2Tank = ls.level[LS_O2];
+	if (MainFuel) SetPropellantMass (MainFuel, snap.mainfuel);
+	for (int i = 0; i < rcs.n; i++)
+		SetPropellantMass (rcs.h[i], snap.rcs_mass[i]);
+	rcs.balancing = true;
+	if (snap.rcs_failed != rcs_failed) {
+		rcs_failed = snap.rcs_failed;
+		BuildRcsAllocation ();
+	}
+	SelectedUmmuMember = snap.SelectedUmmuMember;
+	iSelectedCargo = snap.iSelectedCargo;
+	double simt = oapiGetSimTime();
+	for (int i = 0; i < HUD_QUEUE; i++)
+		if (hud_live & (1u << i)) CancelEvent (hudmsg[i].event);
+	hud_live = 0;
+	for (int i = 0; i < HUD_QUEUE; i++) {
+		hudmsg[i] = snap.hud[i];
+		hudmsg[i].event = -1;
+		if (snap.hud[i].expires > 0) {
+			hudmsg[i].expires += simt;
+			hudmsg[i].text[HUD_MSGLEN-1] = 0;
+			hud_live |= 1u << i;
+			hudmsg[i].event = ScheduleEvent (hudmsg[i].expires, EV_HUD_EXPIRE, i, hudmsg[i].seq);
+		}
+		if (hudmsg[i].seq >= hud_seq) hud_seq = hudmsg[i].seq+1;
+	}
+	return true;
 }
 
 //=========================================================
@@ -1028,14 +2539,35 @@ void ShuttleD::clbkVisualCreated (VISHANDLE vis, int refcount)
 }
 
 //=========================================================
-// SendCargHudMessage
-// Another UCGO specific function, which you would think would be related to the hud.
+// clbkPreStep
+// Hands the RCS commands on to the real thrusters, see RCS Allocation. Orbiter has set the command thruster levels from the keyboard,
+// joystick or autopilot by now, so the real levels are just rcs_alloc times those.
 //=========================================================
 
-char *ShuttleD::SendCargHudMessage(void)
+void ShuttleD::clbkPreStep (double simt, double simdt, double mjd)
 {
-	dCargHudMessageDelay=15; // 15 seconds display delay for msg
-	return cCargoHudDisplay;
+	ProfileFrame (simt);
+	if (ilog)
+		LogStep (simdt);
+	PROFILE_SCOPE (PRF_PRESTEP);
+	const SHDLAYOUT &L = *layout;
+	double cmd[MAX_RCS_GROUPS];
+	bool firing = false;
+	int i, g;
+
+	for (g = 0; g < L.ngroup; g++) {
+		cmd[g] = GetThrusterLevel (th_cmd[g]);
+		if (cmd[g] > 0) firing = true;
+	}
+	if (!firing && !rcs_firing)
+		return;
+	for (i = 0; i < L.nth; i++) {
+		double level = 0;
+		for (g = 0; g < L.ngroup; g++)
+			level += rcs_alloc[i][g]*cmd[g];
+		SetThrusterLevel (th_rcs[i], min (level, 1.0));
+	}
+	rcs_firing = firing;
 }
 
 //=========================================================
@@ -1048,129 +2580,89 @@ char *ShuttleD::SendCargHudMessage(void)
 
 void ShuttleD::clbkPostStep(double simt, double simdt, double mjd)
 {
+	// Anything below that has to push new state to Orbiter, UMmu or UCGO sets this, the rest of the time the step only does the
+	// checks that depend on the flight itself (crashes, reentry, O2 use). In a quiet cruise that is all that happens.
+	bool changed = false;
+	nSteps++;
+	PROFILE_SCOPE (PRF_POSTSTEP);
 
-SetEmptyMass(UpdateMass());
-hUcgo.UpdateEmptyMass();
+	// The empty mass & PMI only get resent when the O2, propellant or cargo moved enough to matter
+	if (UpdateMassProperties())
+		changed = true;
 
-	int ReturnCode=Crew.ProcessUniversalMMu();
+	int ReturnCode;
+	{
+		PROFILE_SCOPE (PRF_UMMU_PROCESS);
+		ReturnCode=Crew.ProcessUniversalMMu();
+	}
 	switch(ReturnCode)
 	{
 	case UMMU_TRANSFERED_TO_OUR_SHIP: 
-		sprintf(SendHudMessage(),"%s \"%s\" transfered to %s",
+		changed = true;
+		HudMessage(HUD_INFO,"%s \"%s\" transfered to %s",
 			Crew.GetCrewMiscIdByName(Crew.GetLastEnteredCrewName()),Crew.GetLastEnteredCrewName()
 			,GetName());
 		break;
 	case UMMU_RETURNED_TO_OUR_SHIP:
-		sprintf(SendHudMessage(),"%s \"%s\" ingressed %s",
+		changed = true;
+		HudMessage(HUD_INFO,"%s \"%s\" ingressed %s",
 			Crew.GetCrewMiscIdByName(Crew.GetLastEnteredCrewName()),
 			Crew.GetLastEnteredCrewName(),GetName());
 		break;
 	}
+	if (ReturnCode == UMMU_TRANSFERED_TO_OUR_SHIP || ReturnCode == UMMU_RETURNED_TO_OUR_SHIP)
+		LifeSupportChanged ();
 
-		int ActionAreaReturnCode=Crew.DetectActionAreaActivated();
+	int ActionAreaReturnCode;
+	{
+		PROFILE_SCOPE (PRF_UMMU_ACTIONAREA);
+		ActionAreaReturnCode=Crew.DetectActionAreaActivated();
+	}
 	if(ActionAreaReturnCode>-1)
 	{
+		changed = true;
 		// this is just an example, we have four area declared
 		// action area ID 0 triggered 
 		if(ActionAreaReturnCode==0)
 		{
-		RevertPLBAYA();
+		RevertMechanism(MECH_PLBAYA);
 		}
 		// action area ID 1 triggered
-		else if(ActionAreaReturnCode==1)
-		{
-		RevertPLBAYB();
-		}
-		// action area ID 2 triggered
-		else if(ActionAreaReturnCode==2)
-		{
-		// switch state
-		Crew.SetAirlockDoorState(!Crew.GetAirlockDoorState());
-		// display state
-		if(Crew.GetAirlockDoorState()==TRUE)
-			strcpy(SendHudMessage(),"Airlock open");	
-		else
-			strcpy(SendHudMessage(),"Airlock closed");	
-		}
-	}
-
-	if (GEAR_status >= GEAR_RAISING) { 
-		double da = simdt * GEAR_OPERATING_SPEED;
-		if (GEAR_status == GEAR_RAISING) {
-			if (GEAR_proc > 0.0) GEAR_proc = max (0.0, GEAR_proc-da);
-			else                GEAR_status = GEAR_UP;
-		} else {
-			if (GEAR_proc < 1.0) GEAR_proc = min (1.0, GEAR_proc+da);
-			else                GEAR_status = GEAR_DOWN;
-		}
-		SetAnimation (anim_gear, GEAR_proc);
-
-	}
-
-	SetTouchdownPoints (_V(0,-4.89+GEAR_proc*0.99,1), _V(-1,-4.89+GEAR_proc*0.99,-1), _V(1,-4.89+GEAR_proc*0.99,-1));
-
-	if (PLBAYA_status >= PLBAYA_CLOSING) {
-		double da = simdt * PLBAYA_OPERATING_SPEED;
-		if (PLBAYA_status == PLBAYA_CLOSING) {
-			if (PLBAYA_proc > 0.0) PLBAYA_proc = max (0.0, PLBAYA_proc-da);
-			else                PLBAYA_status = PLBAYA_UP;
-		} else {
-			if (PLBAYA_proc < 1.0) PLBAYA_proc = min (1.0, PLBAYA_proc+da);
-			else                PLBAYA_status = PLBAYA_DOWN;
-		}
-		SetAnimation (anim_PLBAYA, PLBAYA_proc);
-
-
-
-	}
-
-	if (PLBAYB_status >= PLBAYB_CLOSING) {
-		double da = simdt * PLBAYB_OPERATING_SPEED;
-		if (PLBAYB_status == PLBAYB_CLOSING) {
-			if (PLBAYB_proc > 0.0) PLBAYB_proc = max (0.0, PLBAYB_proc-da);
-			else                PLBAYB_status = PLBAYB_UP;
-		} else {
-			if (PLBAYB_proc < 1.0) PLBAYB_proc = min (1.0, PLBAYB_proc+da);
-			else                PLBAYB_status = PLBAYB_DOWN;
-		}
-		SetAnimation (anim_PLBAYB, PLBAYB_proc);
-
-
-
-	}
-
-	if (GEAR_status == GEAR_RAISING) {
-		{if(GEAR_proc > 0.99)
-			PlayVesselWave(SHD,GEARDOWN);
-		}
-	}
-
-	if (GEAR_status == GEAR_LOWERING) {
-		{if(GEAR_proc < 0.01)
-			PlayVesselWave(SHD,GEARUP);
+		else if(ActionAreaReturnCode==1)
+		{
+		RevertMechanism(MECH_PLBAYB);
 		}
-	}
-	if (PLBAYA_status == PLBAYA_CLOSING) {
-		{if(PLBAYA_proc > 0.99)
-			PlayVesselWave(SHD,PLBAYACLOSE);
+		// action area ID 2 triggered
+		else if(ActionAreaReturnCode==2)
+		{
+		// switch state
+		Crew.SetAirlockDoorState(!Crew.GetAirlockDoorState());
+		// display state
+		if(Crew.GetAirlockDoorState()==TRUE)
+			HudMessage(HUD_INFO,"Airlock open");	
+		else
+			HudMessage(HUD_INFO,"Airlock closed");	
 		}
 	}
 
-	if (PLBAYA_status == PLBAYA_OPENING) {
-		{if(PLBAYA_proc < 0.01)
-			PlayVesselWave(SHD,PLBAYAOPEN);
-		}
+	// RCS cross-feed, only after the thrusters have been used
+	if (rcs_firing || rcs.balancing) {
+		BalanceRcsTanks (simdt);
+		changed = true;
 	}
-	if (PLBAYB_status == PLBAYB_CLOSING) {
-		{if(PLBAYB_proc > 0.9)
-			PlayVesselWave(SHD,PLBAYBCLOSE);
-		}
+
+	if (mech_moving)
+	{
+		StepMechanisms (simdt);
+		changed = true;
 	}
 
-	if (PLBAYB_status == PLBAYB_OPENING) {
-		{if(PLBAYB_proc < 0.1)
-			PlayVesselWave(SHD,PLBAYBOPEN);
-		}
+	if (mech[MECH_GEAR].proc != tdGearProc)
+	{
+		tdGearProc = mech[MECH_GEAR].proc;
+		PROFILE_COUNT (PRC_SETTOUCHDOWN);
+		SetTouchdownPoints (_V(0,-4.89+tdGearProc*0.99,1), _V(-1,-4.89+tdGearProc*0.99,-1), _V(1,-4.89+tdGearProc*0.99,-1));
+		changed = true;
 	}
 
 	if(GroundContact()==TRUE)
@@ -1187,7 +2679,7 @@ hUcgo.UpdateEmptyMass();
 			{
 				Crew.SetCrewMemberPulseBySlotNumber(I,0);	// set cardiac pulse to zero
 			}
-			strcpy(SendHudMessage(),"Crashed into terrain");
+			HudMessage(HUD_ALERT,"Crashed into terrain");
 		}
 	}
 
@@ -1200,89 +2692,644 @@ hUcgo.UpdateEmptyMass();
 			{
 				Crew.SetCrewMemberPulseBySlotNumber(I,0);	// set cardiac pulse to zero
 			}
-			strcpy(SendHudMessage(),"Hull Breach due to Atmospheric Reentry");
+			HudMessage(HUD_ALERT,"Hull Breach due to Atmospheric Reentry");
 	}
 
 
-	if (PLBAYA_status == PLBAYA_UP) {
-		hUcgo.SetSlotDoorState(FALSE);
+	// Life support, see Life Support. The levels follow from the time, running out is an event, unless the scheduler had no
+	// room for it.
+	O2Tank = LifeSupportLevel (LS_O2, simt);
+	if (ls.event < 0 && simt >= ls.tEmpty)
+		LifeSupportEmpty (simt);
+
+	// anything that was waiting for this time, see Event Scheduler
+	if (RunEvents (simt))
+		changed = true;
+
+Randomizer = simdt;
+
+		// the UMmu warning has nothing to say once we know UMmu answered with a version number
+		if (fUMmuVersion <= 0) {
+			PROFILE_SCOPE (PRF_UMMU_WARN);
+			Crew.WarnUserUMMUNotInstalled("Shuttle-D");
+		}
+		// At the very end of clbkPostStep or clbkPreStep. UCGO has no version to ask for, so the warning only gets the first
+		// UCGO_WARN_TIME seconds to show itself, after that the step doesnt call into UCGO for it any more.
+		if (simt < tUcgoWarn) {
+			PROFILE_SCOPE (PRF_UCGO_WARN);
+			hUcgo.WarnUserUCGONotInstalled("Shuttle-D");
+		}
+
+		if (tlm)
+			PushTelemetry (simt, simdt);
+		if (fdr)
+			RecordStep (simt);
+		if (ilog && ilog->replay)
+			ReplayEvents ();
+
+		if (!changed)
+			nFastSteps++;
+}
+
+//=========================================================
+// Telemetry
+// See TLMSTREAM in D9base.h. StartTelemetry opens the file & starts the writer thread once the vessel is complete, PushTelemetry
+// is the only part that runs on the sim thread, & StopTelemetry lets the writer empty the ring & waits for it when the vessel goes
+// away. The record count, drops & (in a debug build) the time spent pushing end up in Orbiter.log, which is the easiest way to see
+// what the stream costs a frame.
+//=========================================================
+
+static DWORD WINAPI TelemetryWriter (LPVOID arg)
+{
+	TLMSTREAM &t = *(TLMSTREAM*)arg;
+	LONG reported = 0;
+	for (;;) {
+		bool stopping = (t.stop != 0);	// read before emptying the ring, so nothing pushed before the stop is lost
+		LONG head = t.head;
+		while (t.tail != head) {
+			const TLMRECORD &r = t.rec[t.tail & (TLM_RING-1)];
+			fprintf (t.f, "%.4f,%.5f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%.1f,%.3f,%.1f,%d\n", r.simt, r.simdt,
+				r.mech_proc[MECH_GEAR], r.mech_proc[MECH_PLBAYA], r.mech_proc[MECH_PLBAYB],
+				r.O2Tank, r.mainfuel, r.rcsfuel, r.dynp, r.vspeed, r.cargo, r.crew);
+			InterlockedExchange (&t.tail, t.tail+1);	// hands the slot back to the sim thread
+		}
+		LONG dropped = t.dropped;
+		if (dropped != reported) {
+			fprintf (t.f, "# %ld records dropped\n", dropped-reported);
+			reported = dropped;
+		}
+		if (stopping) break;
+		Sleep (TLM_SLEEP);
+	}
+	return 0;
+}
+
+void ShuttleD::StartTelemetry ()
+{
+	TLMSTREAM *t = new TLMSTREAM;
+	t->head = t->tail = t->dropped = t->stop = 0;
+	t->pushed = 0;
+	sprintf (t->path, TELEMETRY_DIR "%s.csv", GetName());
+	CreateDirectory (TELEMETRY_DIR, NULL);
+	t->f = fopen (t->path, "w");
+	if (t->f) {
+		fprintf (t->f, "simt,simdt,GEAR_proc,PLBAYA_proc,PLBAYB_proc,O2Tank,mainfuel,rcsfuel,dynp,vspeed,cargo,crew\n");
+		DWORD id;
+		t->thread = CreateThread (NULL, 0, TelemetryWriter, t, 0, &id);
+		if (t->thread) {
+			tlm = t;
+			return;
+		}
+		fclose (t->f);
 	}
+	char cbuf[512];
+	sprintf (cbuf, "Shuttle-D: unable to start telemetry to %s", t->path);
+	oapiWriteLog (cbuf);
+	delete t;
+}
 
-	if (PLBAYA_status == PLBAYA_DOWN) {
-		hUcgo.SetSlotDoorState(TRUE);
+void ShuttleD::PushTelemetry (double simt, double simdt)
+{
+	TLMSTREAM &t = *tlm;
+	LONG head = t.head;
+	if (head - t.tail >= TLM_RING) {
+		InterlockedIncrement (&t.dropped);
+		HudMessage (HUD_WARNING, "Telemetry writer is falling behind, records dropped");
+		return;
 	}
+	TLMRECORD &r = t.rec[head & (TLM_RING-1)];
+	r.simt = simt;
+	r.simdt = simdt;
+	for (int m = 0; m < MECH_COUNT; m++)
+		r.mech_proc[m] = mech[m].proc;
+	r.O2Tank = O2Tank;
+	r.mainfuel = (MainFuel ? GetPropellantMass (MainFuel) : 0);
+	r.rcsfuel = rcs.total;
+	r.dynp = GetDynPressure();
+	VECTOR3 v;
+	GetHorizonAirspeedVector (v);
+	r.vspeed = v.y;
+	r.cargo = hUcgo.GetCargoTotalMass();
+	r.crew = Crew.GetCrewTotalNumber();
+	InterlockedExchange (&t.head, head+1);	// publishes the record, the exchange is a full barrier
+	t.pushed++;
+}
+
+void ShuttleD::StopTelemetry ()
+{
+	InterlockedExchange (&tlm->stop, 1);
+	WaitForSingleObject (tlm->thread, INFINITE);
+	CloseHandle (tlm->thread);
+	fclose (tlm->f);
+	char cbuf[512];
+	sprintf (cbuf, "Shuttle-D: telemetry %s, %lu records, %ld dropped", tlm->path, tlm->pushed, tlm->dropped);
+	oapiWriteLog (cbuf);
+	delete tlm;
+	tlm = NULL;
+}
+
+//=========================================================
+// Flight Recorder
+// See FDRBUFFER in D9base.h & FlightRecorder.h. RecordStep only copies the step's values into the current chunk; the encoding &
+// writing happen once per chunk, at most every FDR_CHUNK_TIME seconds, in WriteRecorderChunk. The index entry for each chunk is
+// written & flushed along with it, so a recording cut short by a crash can still be read up to its last whole chunk.
+//=========================================================
 
-	if (PLBAYB_status == PLBAYB_OPENING) {
-		{if(PLBAYB_proc < 0.1)
-			PlayVesselWave(SHD,PLBAYBOPEN);
+void ShuttleD::StartRecorder ()
+{
+	FDRBUFFER *r = new FDRBUFFER;
+	r->n = 0;
+	r->steps = r->chunks = 0;
+	CreateDirectory (RECORDER_DIR, NULL);
+	sprintf (r->path, RECORDER_DIR "%s.fdr", GetName());
+	r->f = fopen (r->path, "wb");
+	strcpy (r->path + strlen(r->path) - 4, ".fdx");
+	r->fx = fopen (r->path, "wb");
+	r->path[strlen(r->path)-4] = 0;
+	if (r->f && r->fx) {
+		FDRHEADER hdr = {FDR_MAGIC, FDR_VERSION, FDR_COLS, FDR_CHUNK};
+		if (fwrite (&hdr, sizeof(hdr), 1, r->f) == 1) {
+			r->offset = sizeof(hdr);
+			fdr = r;
+			return;
 		}
 	}
+	if (r->f) fclose (r->f);
+	if (r->fx) fclose (r->fx);
+	char cbuf[512];
+	sprintf (cbuf, "Shuttle-D: unable to start the flight recorder in %s.fdr", r->path);
+	oapiWriteLog (cbuf);
+	delete r;
+}
 
-	double CrewNumber = Crew.GetCrewTotalNumber();
-	double OxygenConsumption = 1.2*1.157407E-5*CrewNumber;
-	double OxygenLevel = O2Tank;
+void ShuttleD::RecordStep (double simt)
+{
+	FDRBUFFER &r = *fdr;
+	if (r.n && (r.n == FDR_CHUNK || simt - r.col[0][0] >= FDR_CHUNK_TIME))
+		WriteRecorderChunk ();
+
+	int i = r.n++;
+	VECTOR3 v;
+	GetHorizonAirspeedVector (v);
+	r.col[0][i] = simt;
+	r.col[1][i] = O2Tank;
+	r.col[2][i] = mech[MECH_GEAR].proc;
+	r.col[3][i] = mech[MECH_PLBAYA].proc;
+	r.col[4][i] = mech[MECH_PLBAYB].proc;
+	r.col[5][i] = (MainFuel ? GetPropellantMass (MainFuel) : 0);
+	r.col[6][i] = rcs.total;
+	r.col[7][i] = GetMass();
+	r.col[8][i] = v.x;
+	r.col[9][i] = v.y;
+	r.col[10][i] = v.z;
+	r.col[11][i] = GetDynPressure();
+	r.steps++;
+}
 
+void ShuttleD::WriteRecorderChunk ()
 {
-	if (O2Tank>0)
-	{
-	O2Tank = (O2Tank - OxygenConsumption*simdt);
+	FDRBUFFER &r = *fdr;
+	FDRCHUNKHEADER hdr;
+	hdr.magic = FDR_CHUNKMAGIC;
+	hdr.n = r.n;
+	hdr.t0 = r.col[0][0];
+	hdr.t1 = r.col[0][r.n-1];
+	unsigned long long size = sizeof(hdr);
+	for (int c = 0; c < FDR_COLS; c++)
+		size += hdr.size[c] = FdrEncodeColumn (r.col[c], r.n, r.enc[c], r.tmp);
+
+	fwrite (&hdr, sizeof(hdr), 1, r.f);
+	for (int c = 0; c < FDR_COLS; c++)
+		fwrite (r.enc[c], hdr.size[c], 1, r.f);
+	FDRINDEX ix = {hdr.t0, hdr.t1, r.offset};
+	fwrite (&ix, sizeof(ix), 1, r.fx);
+	fflush (r.f);
+	fflush (r.fx);
+	r.offset += size;
+	r.chunks++;
+	r.n = 0;
+}
+
+void ShuttleD::StopRecorder ()
+{
+	if (fdr->n)
+		WriteRecorderChunk ();
+	fclose (fdr->f);
+	fclose (fdr->fx);
+	char cbuf[512];
+	sprintf (cbuf, "Shuttle-D: flight recorder %s.fdr, %lu steps in %lu chunks, %.0f bytes, %.2f bytes a value",
+		fdr->path, fdr->steps, fdr->chunks, (double)fdr->offset, (double)fdr->offset/max ((double)fdr->steps*FDR_COLS, 1.0));
+	oapiWriteLog (cbuf);
+	delete fdr;
+	fdr = NULL;
+}
+
+//=========================================================
+// Input Log
+// See INPUTLOG in D9base.h. Recording, LogStep writes an IL_STEP entry at the start of every step & clbkConsumeBufferedKey,
+// clbkVCMouseEvent & UMmuCrewAddCallback write whatever reaches them in between, so every entry sits after the step it followed.
+// Replaying, LogStep reads the IL_STEP entry back & ReplayEvents, at the end of the same step, runs everything up to the next one
+// through KeyDown, VCClick & UMmuCrewAddCallback, the same way the live input went. Orbiter picks the step lengths itself, so a
+// replay cant force the recorded ones; it counts the steps where they differ instead, which is where a replay can drift away from
+// the recording. Headless/SHDBench -replay can, it steps the vessel with the recorded lengths without Orbiter.
+//=========================================================
+
+void ShuttleD::StartInputLog (bool replay)
+{
+	INPUTLOG *l = new INPUTLOG;
+	l->replay = replay;
+	l->last = 0;
+	l->steps = l->events = l->differ = 0;
+	sprintf (l->path, INPUTLOG_DIR "%s.sil", GetName());
+	DWORD magic = IL_MAGIC;
+	if (replay) {
+		l->f = fopen (l->path, "rb");
+		if (l->f && (fread (&magic, 4, 1, l->f) != 1 || magic != IL_MAGIC)) {
+			fclose (l->f);
+			l->f = NULL;
+		}
+	} else {
+		CreateDirectory (INPUTLOG_DIR, NULL);
+		l->f = fopen (l->path, "wb");
+		if (l->f && fwrite (&magic, 4, 1, l->f) != 1) {
+			fclose (l->f);
+			l->f = NULL;
+		}
 	}
-	else 
-	{
-	O2Tank=0;
+	if (l->f) {
+		ilog = l;
+		if (replay) HudMessage (HUD_INFO, "Replaying %s", l->path);
+		return;
 	}
+	char cbuf[512];
+	sprintf (cbuf, "Shuttle-D: unable to %s input log %s", replay ? "replay" : "record", l->path);
+	oapiWriteLog (cbuf);
+	delete l;
 }
-	int I;
-	if(O2Tank == 0)
+
+void ShuttleD::LogStep (double simdt)
 {
-			// You ran out of oxygen, sorry dude, time to kill you all :(
-			for(I=0;I<Crew.GetCrewTotalNumber();I++)
-			{
-				Crew.SetCrewMemberPulseBySlotNumber(I,0);	// set cardiac pulse to zero
+	INPUTLOG &l = *ilog;
+	unsigned long long bits, x = 0;
+	memcpy (&bits, &simdt, 8);
+	unsigned int nb, b;
+	if (!l.replay) {
+		x = FdrResidual (FDR_XOR, bits, l.last, 0);
+		for (nb = 0; nb < 8 && (x >> (nb*8)); nb++);
+		fputc (IL_STEP | (nb << 4), l.f);
+		for (b = 0; b < nb; b++)
+			fputc ((int)(x >> (b*8)) & 255, l.f);
+		l.last = bits;
+		l.steps++;
+		return;
+	}
+
+	int tag = fgetc (l.f);
+	if (tag == EOF) {
+		StopInputLog ("finished");
+		return;
+	}
+	if ((tag & 15) != IL_STEP) {
+		StopInputLog ("stopped, the log is damaged");
+		return;
+	}
+	for (nb = tag >> 4, b = 0; b < nb; b++)
+		x |= (unsigned long long)(fgetc (l.f) & 255) << (b*8);
+	l.last = FdrUnresidual (FDR_XOR, x, l.last, 0);
+	if (l.last != bits) l.differ++;
+	l.steps++;
+}
+
+void ShuttleD::LogEvent (int type, const void *data, int size)
+{
+	INPUTLOG &l = *ilog;
+	fputc (type, l.f);
+	if (type == IL_INPUT) fputc (size, l.f);
+	fwrite (data, size, 1, l.f);
+	l.events++;
+}
+
+void ShuttleD::ReplayEvents ()
+{
+	INPUTLOG &l = *ilog;
+	unsigned char buf[256];
+	int tag;
+	while ((tag = fgetc (l.f)) != EOF) {
+		if ((tag & 15) == IL_STEP) {	// the next step's, leave it for LogStep
+			ungetc (tag, l.f);
+			return;
+		}
+		bool ok = false;
+		if (tag == IL_KEY) {
+			if ((ok = (fread (buf, 2, 1, l.f) == 1)))
+				KeyDown (buf[0], buf[1] & 3);
+		} else if (tag == IL_CLICK) {
+			if ((ok = (fread (buf, 30, 1, l.f) == 1))) {
+				short id;
+				int event;
+				VECTOR3 p;
+				memcpy (&id, buf, 2);
+				memcpy (&event, buf+2, 4);
+				memcpy (&p, buf+6, 24);
+				VCClick (id, event, p);
+			}
+		} else if (tag == IL_INPUT) {
+			int len = fgetc (l.f);
+			if ((ok = (len != EOF && fread (buf, len, 1, l.f) == 1))) {
+				buf[len] = 0;
+				UMmuCrewAddCallback (0, (char*)buf, this);
+			}
+		}
+		if (!ok) {
+			StopInputLog ("stopped, the log is damaged");
+			return;
 		}
-		strcpy(SendHudMessage(),"O2 Main Tank empty-All crew dead");
+		l.events++;
+	}
+	StopInputLog ("finished");
 }
 
-Randomizer = simdt;
+void ShuttleD::StopInputLog (const char *why)
+{
+	INPUTLOG &l = *ilog;
+	fclose (l.f);
+	char cbuf[512];
+	if (l.replay) {
+		sprintf (cbuf, "Shuttle-D: replay of %s %s, %lu steps & %lu inputs, %lu steps not as long as recorded",
+			l.path, why, l.steps, l.events, l.differ);
+		HudMessage (l.differ ? HUD_WARNING : HUD_INFO, "Replay %s, %lu steps & %lu inputs, %lu steps not as long as recorded",
+			why, l.steps, l.events, l.differ);
+	} else
+		sprintf (cbuf, "Shuttle-D: input log %s, %lu steps & %lu inputs", l.path, l.steps, l.events);
+	oapiWriteLog (cbuf);
+	delete ilog;
+	ilog = NULL;
+}
+
+//=========================================================
+// Profiling
+// The timers & counters from D9base.h end up here. Every PROFILE_SCOPE adds its time to a histogram with power of 2 buckets, which
+// is enough to tell a steady 20 us step from one that mostly takes 5 us & now & then 5 ms. The SDK counters are kept per frame:
+// ProfileFrame notices a new frame by its sim time (every Shuttle-D sees the same one) & folds the last frame's counts into the
+// totals & maxima. All of this runs on Orbiter's simulation thread, where all the vessel callbacks are made, so plain counters do;
+// the telemetry writer thread doesnt touch any of it. ProfileReport gives one line of the report at a time for the HUD (the
+// PROFILE key), & WriteProfile writes the whole thing with every bucket (the PROFILE_DUMP key).
+//=========================================================
+
+struct PROFILEHIST
+{
+	DWORD n;
+	DWORD hist[PRF_BUCKETS];
+	double total;	// us
+	double max;		// us
+};
+
+static const char *ProfileName[] = {
+	"clbkPreStep", "clbkPostStep", "clbkDrawHUD", "clbkVCRedrawEvent", "clbkLoadVC", "clbkSetClassCaps", "clbkLoadStateEx",
+	"clbkSaveState", "UMmu Process", "UMmu ActionArea", "UMmu Warn", "UMmu Load", "UMmu Save", "UCGO Warn", "UCGO Load", "UCGO Save",
+};
+static const char *ProfileCallName[] = {
+	"SetAnimation", "SetTouchdownPoints", "PlayVesselWave", "SetEmptyMass/PMI", "oapiBlt",
+};
+STATIC_CHECK(COUNTOF(ProfileName) == PRF_COUNT, profile_names);
+STATIC_CHECK(COUNTOF(ProfileCallName) == PRC_COUNT, profile_call_names);
+
+static PROFILEHIST Profile[PRF_COUNT];
+DWORD ProfileCalls[PRC_COUNT];
+static DWORD ProfileCallsTotal[PRC_COUNT];
+static DWORD ProfileCallsMax[PRC_COUNT];
+static DWORD ProfileFrames = 0;
+static double ProfileSimt = -1e10;
+static double ProfileTickUs = 0;	// us per QueryPerformanceCounter tick
+
+void Shuttle_InitProfile ()
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency (&freq);
+	ProfileTickUs = 1e6/(double)freq.QuadPart;
+}
+
+void ProfileRecord (int id, const LARGE_INTEGER &t0)
+{
+	LARGE_INTEGER t1;
+	QueryPerformanceCounter (&t1);
+	double us = (double)(t1.QuadPart-t0.QuadPart)*ProfileTickUs;
+	PROFILEHIST &p = Profile[id];
+	int b = 0;
+	for (DWORD u = (DWORD)us; u && b < PRF_BUCKETS-1; u >>= 1) b++;
+	p.hist[b]++;
+	p.n++;
+	p.total += us;
+	if (us > p.max) p.max = us;
+}
+
+void ProfileFrame (double simt)
+{
+	if (simt == ProfileSimt) return;
+	ProfileSimt = simt;
+	for (int c = 0; c < PRC_COUNT; c++) {
+		if (bShuttleProfile) {
+			ProfileCallsTotal[c] += ProfileCalls[c];
+			if (ProfileCalls[c] > ProfileCallsMax[c]) ProfileCallsMax[c] = ProfileCalls[c];
+		}
+		ProfileCalls[c] = 0;
+	}
+	if (bShuttleProfile)
+		ProfileFrames++;
+}
+
+// upper end in us of the bucket holding the given fraction of the calls
+static double ProfilePercentile (const PROFILEHIST &p, double frac)
+{
+	DWORD want = (DWORD)ceil (p.n*frac), sum = 0;
+	for (int b = 0; b < PRF_BUCKETS-1; b++)
+		if ((sum += p.hist[b]) >= want) return (double)(1u << b);
+	return p.max;
+}
 
-		AddUMmuToVessel();
+// line i of the report, returns its length, 0 past the end
+int ProfileReport (char *line, int i)
+{
+	if (i == 0)
+		return sprintf (line, "%-20s %8s %9s %9s %9s %9s", "Profile", "calls", "mean us", "p50 <", "p99 <", "max us");
+	for (int id = 0; id < PRF_COUNT; id++) {
+		const PROFILEHIST &p = Profile[id];
+		if (!p.n || --i) continue;
+		return sprintf (line, "%-20s %8lu %9.1f %9.0f %9.0f %9.0f", ProfileName[id], p.n, p.total/p.n,
+			ProfilePercentile (p, 0.5), ProfilePercentile (p, 0.99), p.max);
+	}
+	if (--i == 0)
+		return sprintf (line, "%-20s %8lu %9s %9s", "SDK calls", ProfileFrames, "/frame", "max");
+	for (int c = 0; c < PRC_COUNT; c++) {
+		if (!ProfileCallsTotal[c] || --i) continue;
+		return sprintf (line, "%-20s %8lu %9.2f %9lu", ProfileCallName[c], ProfileCallsTotal[c],
+			(double)ProfileCallsTotal[c]/max (ProfileFrames, (DWORD)1), ProfileCallsMax[c]);
+	}
+	return 0;
+}
 
-		Crew.WarnUserUMMUNotInstalled("Shuttle-D");
-		// At the very end of clbkPostStep or clbkPreStep
-		hUcgo.WarnUserUCGONotInstalled("Shuttle-D");
+bool WriteProfile (const char *path)
+{
+	FILE *f = fopen (path, "w");
+	if (!f) return false;
+	char line[128];
+	for (int i = 0, n = ProfileReport (line, 0); n; n = ProfileReport (line, ++i))
+		fprintf (f, "%s\n", line);
+	fprintf (f, "\nHistograms, calls per bucket\n%-20s", "us <");
+	for (int b = 0; b < PRF_BUCKETS-1; b++)
+		fprintf (f, " %7u", 1u << b);
+	fprintf (f, " %7s\n", "more");
+	for (int id = 0; id < PRF_COUNT; id++) {
+		fprintf (f, "%-20s", ProfileName[id]);
+		for (int b = 0; b < PRF_BUCKETS; b++)
+			fprintf (f, " %7lu", Profile[id].hist[b]);
+		fprintf (f, "\n");
+	}
+	return fclose (f) == 0;
 }
 
 
 //=========================================================
-// clbkConsumeBufferedKey
-// Another important function, this particular section is used to execute functions whenever the Orbiter application detects a given keystroke by a user.
-// Really not very complicated (usually), very similar to clbkVCMouseEvent. The ony complicated part is getting the structure right, as calls specific
-// to a ctrl-keypress or shift-keypress have to be grouped under a separate heading. Best example of that will be under the Hubble Space Telescope sample
-// also in the OrbiterSDK directory.
+// Commands & Key Bindings
+// Every action the keyboard used to trigger directly is now a named command (the CMD_ list in D9base.h), run by RunCommand. The keys
+// are looked up in KeyBinding, which has one entry per key & Shift/Ctrl combination, so a keypress costs a single table lookup
+// however many bindings there are. The defaults are the ones the Shuttle-D always had, & any of them can be changed in Shuttle-D.cfg
+// with a line like KEY_CARGO_RELEASE = SHIFT+C (or CTRL+, CTRL+SHIFT+, ANY+ for every combination, or NONE to unbind it).
 //=========================================================
 
-int ShuttleD::clbkConsumeBufferedKey (DWORD key, bool down, char *kstate)
+// which Shift/Ctrl combinations a binding applies to
+const int MOD_NONE = 1, MOD_SHIFT = 2, MOD_CTRL = 4, MOD_CTRLSHIFT = 8, MOD_ANY = 15;
+
+static const struct { const char *name; DWORD key; int mods; } CommandDefault[CMD_COUNT] = {
+	{"GEAR",          OAPI_KEY_G, MOD_ANY},
+	{"PLBAYA",        OAPI_KEY_O, MOD_ANY},
+	{"PLBAYB",        OAPI_KEY_K, MOD_ANY},
+	{"GEAR_DOWN",     0, 0},		// the VC switches, no key by default
+	{"GEAR_UP",       0, 0},
+	{"PLBAYA_OPEN",   0, 0},
+	{"PLBAYA_CLOSE",  0, 0},
+	{"PLBAYB_OPEN",   0, 0},
+	{"PLBAYB_CLOSE",  0, 0},
+	{"EVA",           OAPI_KEY_E, MOD_NONE},
+	{"CREW_NEXT",     OAPI_KEY_1, MOD_NONE},
+	{"CREW_PREV",     OAPI_KEY_2, MOD_NONE},
+	{"AIRLOCK",       OAPI_KEY_A, MOD_NONE},
+	{"CREW_INFO",     OAPI_KEY_0, MOD_ANY},
+	{"ADD_CREW",      OAPI_KEY_M, MOD_NONE},
+	{"SLOT_NEXT",     OAPI_KEY_4, MOD_NONE},
+	{"SLOT_PREV",     OAPI_KEY_3, MOD_NONE},
+	{"CARGO_PICK",    OAPI_KEY_9, MOD_NONE},
+	{"CARGO_ADD",     OAPI_KEY_9, MOD_SHIFT},
+	{"CARGO_GRAPPLE", OAPI_KEY_C, MOD_NONE},
+	{"CARGO_RELEASE", OAPI_KEY_C, MOD_SHIFT},
+	{"CARGO_INFO",    OAPI_KEY_8, MOD_NONE},
+	{"O2_INFO",       OAPI_KEY_7, MOD_NONE},
+	{"PROFILE",       OAPI_KEY_8, MOD_SHIFT},
+	{"PROFILE_DUMP",  OAPI_KEY_7, MOD_SHIFT},
+};
+
+// the key names that can be used in Shuttle-D.cfg
+static const struct { const char *name; DWORD key; } KeyNames[] = {
+	{"A", OAPI_KEY_A}, {"B", OAPI_KEY_B}, {"C", OAPI_KEY_C}, {"D", OAPI_KEY_D}, {"E", OAPI_KEY_E}, {"F", OAPI_KEY_F},
+	{"G", OAPI_KEY_G}, {"H", OAPI_KEY_H}, {"I", OAPI_KEY_I}, {"J", OAPI_KEY_J}, {"K", OAPI_KEY_K}, {"L", OAPI_KEY_L},
+	{"M", OAPI_KEY_M}, {"N", OAPI_KEY_N}, {"O", OAPI_KEY_O}, {"P", OAPI_KEY_P}, {"Q", OAPI_KEY_Q}, {"R", OAPI_KEY_R},
+	{"S", OAPI_KEY_S}, {"T", OAPI_KEY_T}, {"U", OAPI_KEY_U}, {"V", OAPI_KEY_V}, {"W", OAPI_KEY_W}, {"X", OAPI_KEY_X},
+	{"Y", OAPI_KEY_Y}, {"Z", OAPI_KEY_Z},
+	{"0", OAPI_KEY_0}, {"1", OAPI_KEY_1}, {"2", OAPI_KEY_2}, {"3", OAPI_KEY_3}, {"4", OAPI_KEY_4},
+	{"5", OAPI_KEY_5}, {"6", OAPI_KEY_6}, {"7", OAPI_KEY_7}, {"8", OAPI_KEY_8}, {"9", OAPI_KEY_9},
+	{"F1", OAPI_KEY_F1}, {"F2", OAPI_KEY_F2}, {"F3", OAPI_KEY_F3}, {"F4", OAPI_KEY_F4}, {"F5", OAPI_KEY_F5}, {"F6", OAPI_KEY_F6},
+	{"F7", OAPI_KEY_F7}, {"F8", OAPI_KEY_F8}, {"F9", OAPI_KEY_F9}, {"F10", OAPI_KEY_F10}, {"F11", OAPI_KEY_F11}, {"F12", OAPI_KEY_F12},
+};
+
+// command+1 for each key & modifier combination (none, shift, ctrl, ctrl+shift), 0 if the key isnt ours
+static unsigned char KeyBinding[256][4];
+
+static void BindKey (int cmd, DWORD key, int mods)
+{
+	for (int m = 0; m < 4; m++) {
+		// whatever this command was bound to before goes
+		for (int k = 0; k < 256; k++)
+			if (KeyBinding[k][m] == cmd+1) KeyBinding[k][m] = 0;
+		if (key < 256 && (mods & (1 << m))) KeyBinding[key][m] = (unsigned char)(cmd+1);
+	}
+}
+
+// "SHIFT+C" & the like, false if it doesnt make sense
+static bool ParseKey (const char *str, DWORD &key, int &mods)
+{
+	if (!_stricmp (str, "NONE")) {
+		key = 256;
+		mods = 0;
+		return true;
+	}
+	mods = MOD_NONE;
+	if      (!_strnicmp (str, "CTRL+SHIFT+", 11)) { mods = MOD_CTRLSHIFT; str += 11; }
+	else if (!_strnicmp (str, "SHIFT+", 6))       { mods = MOD_SHIFT;     str += 6; }
+	else if (!_strnicmp (str, "CTRL+", 5))        { mods = MOD_CTRL;      str += 5; }
+	else if (!_strnicmp (str, "ANY+", 4))         { mods = MOD_ANY;       str += 4; }
+	for (int i = 0; i < (int)(sizeof(KeyNames)/sizeof(KeyNames[0])); i++)
+		if (!_stricmp (str, KeyNames[i].name)) {
+			key = KeyNames[i].key;
+			return true;
+		}
+	return false;
+}
+
+void LoadKeyBindings (FILEHANDLE cfg)
+{
+	char item[64], str[64];
+	int cmd;
+	memset (KeyBinding, 0, sizeof(KeyBinding));
+	for (cmd = 0; cmd < CMD_COUNT; cmd++)
+		BindKey (cmd, CommandDefault[cmd].key, CommandDefault[cmd].mods);
+	for (cmd = 0; cmd < CMD_COUNT; cmd++) {
+		DWORD key;
+		int mods;
+		sprintf (item, "KEY_%s", CommandDefault[cmd].name);
+		if (!oapiReadItem_string (cfg, item, str)) continue;
+		if (ParseKey (str, key, mods))
+			BindKey (cmd, key, mods);
+		else {
+			char cbuf[256];
+			sprintf (cbuf, "Shuttle-D: cant make sense of %s = %s in Shuttle-D.cfg, keeping the default key", item, str);
+			oapiWriteLog (cbuf);
+		}
+	}
+}
+
+bool ShuttleD::RunCommand (const char *name)
+{
+	for (int cmd = 0; cmd < CMD_COUNT; cmd++)
+		if (!_stricmp (name, CommandDefault[cmd].name)) {
+			RunCommand (cmd);
+			return true;
+		}
+	return false;
+}
+
+void ShuttleD::RunCommand (int cmd)
 {
+	switch (cmd) {
+	case CMD_GEAR:
+		RevertMechanism(MECH_GEAR);
+		break;
+
+	case CMD_PLBAYA:
+		RevertMechanism(MECH_PLBAYA);
+		break;
+
+	case CMD_PLBAYB:
+		RevertMechanism(MECH_PLBAYB);
+		break;
+
+	case CMD_GEAR_DOWN:		Geardown();		break;
+	case CMD_GEAR_UP:		Gearup();		break;
+	case CMD_PLBAYA_OPEN:	MainBayOpen();	break;
+	case CMD_PLBAYA_CLOSE:	MainBayClose();	break;
+	case CMD_PLBAYB_OPEN:	AuxBayOpen();	break;
+	case CMD_PLBAYB_CLOSE:	AuxBayClose();	break;
 
-	if (!down) return 0;       // only process keydown events
-
-	if(key==OAPI_KEY_G)
-	{ //Gear
-		RevertGEAR();
-		return 1;
-	}  
-	if(key==OAPI_KEY_K)
-	{// Payload Bay B
-		RevertPLBAYB();
-		return 1;
-	}  
-	if(key==OAPI_KEY_O)
-	{// Payload Bay A
-		RevertPLBAYA();
-		return 1;
-	} 
-
-	if(key==OAPI_KEY_E&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
+	case CMD_EVA:
 	{
 		// PERFORM THE EVA, first we get is name with "GetCrewNameBySlotNumber" then we perform EVA with "EvaCrewMember"
 		int Returned=Crew.EvaCrewMember(Crew.GetCrewNameBySlotNumber(SelectedUmmuMember));
@@ -1291,237 +3338,269 @@ int ShuttleD::clbkConsumeBufferedKey (DWORD key, bool down, char *kstate)
 		switch(Returned)
 		{
 		case TRANSFER_TO_DOCKED_SHIP_OK:
-			sprintf(SendHudMessage(),"%s transfered through main hatch",
+			HudMessage(HUD_INFO,"%s transfered through main hatch",
 				Crew.GetLastEvaedCrewName());SelectedUmmuMember=0;
+			LifeSupportChanged ();
 			break;
 		case EVA_OK:
-			sprintf(SendHudMessage(),"%s on EVA",
+			HudMessage(HUD_INFO,"%s on EVA",
 				Crew.GetLastEvaedCrewName());SelectedUmmuMember=0;
+			LifeSupportChanged ();
 			break;
 		case ERROR_AIRLOCK_CLOSED:
-			strcpy(SendHudMessage(),"Airlock closed. press A to open");
+			HudMessage(HUD_INFO,"Airlock closed. press A to open");
 			break;
 		case ERROR_DOCKED_SHIP_HAVE_AIRLOCK_CLOSED:
-			strcpy(SendHudMessage(),"Docked vessel airlock closed");
+			HudMessage(HUD_INFO,"Docked vessel airlock closed");
 			break;
 		case ERROR_CREW_MEMBER_NOT_FOUND:
-			strcpy(SendHudMessage(),"No crew by this name aboard");
+			HudMessage(HUD_WARNING,"No crew by this name aboard");
 			break;
 		case ERROR_DOCKEDSHIP_DONOT_USE_UMMU:
-			strcpy(SendHudMessage(),"Docked ship is not compatible with UMmu 2.0");
+			HudMessage(HUD_WARNING,"Docked ship is not compatible with UMmu 2.0");
 			break;
 		case ERROR_MISC_ERROR_EVAFAILED:
-			strcpy(SendHudMessage(),"Misc error with UMMU. Please reinstall");
+			HudMessage(HUD_WARNING,"Misc error with UMMU. Please reinstall");
 			break;
 		}
-		return TRUE;
+		break;
 	}
 
 	//---------------------------------------------------------------------------
-	// Ummu Key "1" - Select next member This is just internal to the demo
+	// Select next member This is just internal to the demo
 	// you may do your own selection system by panel button, name etc etc
-	if(key==OAPI_KEY_1&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
+	case CMD_CREW_NEXT:
 	{
 		// we test there is someone aboard
 		if(Crew.GetCrewTotalNumber()==0)
 		{
-			strcpy(SendHudMessage(),"No crew aboard");	
-			return 1;
+			HudMessage(HUD_INFO,"No crew aboard");	
+			break;
 		}
 
 		// we test that we select existing member
 		if(SelectedUmmuMember<Crew.GetCrewTotalNumber()-1)
 			SelectedUmmuMember++;
 		char * Name=Crew.GetCrewNameBySlotNumber(SelectedUmmuMember);
-		sprintf(SendHudMessage(),"%i  %s \"%s\"Selected for EVA or Transfer",
+		HudMessage(HUD_INFO,"%i  %s \"%s\"Selected for EVA or Transfer",
 			SelectedUmmuMember,Crew.GetCrewMiscIdBySlotNumber(SelectedUmmuMember),
 			Name);
-		return 1;
+		break;
 	}
 
 	//---------------------------------------------------------------------------
-	// Ummu Key "2" - Select previous member This is just internal to the demo
+	// Select previous member This is just internal to the demo
 	// you may do your own selection system by panel button
-	if(key==OAPI_KEY_2&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
+	case CMD_CREW_PREV:
 	{
 		// we test there is someone aboard
 		if(Crew.GetCrewTotalNumber()==0)
 		{
-			strcpy(SendHudMessage(),"No crew aboard");	
-			return 1;
+			HudMessage(HUD_INFO,"No crew aboard");	
+			break;
 		}
 		if(SelectedUmmuMember>0)
 			SelectedUmmuMember--;
 		char * Name=Crew.GetCrewNameBySlotNumber(SelectedUmmuMember);
-		sprintf(SendHudMessage(),"Slot %i %s \"%s\" Selected for EVA or Transfer"
+		HudMessage(HUD_INFO,"Slot %i %s \"%s\" Selected for EVA or Transfer"
 			", please press \"E\" to EVA",SelectedUmmuMember,
 			Crew.GetCrewMiscIdBySlotNumber(SelectedUmmuMember),Name);
-		return 1;
-	}
-
-
-		//---------------------------------------------------------------------------
-	// UCGO Key "4" Select next Cargo Slot 
-	if(key==OAPI_KEY_4&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
-
-
-		// we test that we select existing member
-		if(iSelectedCargo<18-1)
-			iSelectedCargo++;
-		double GetCargoSlotMass(int Num); 
-		sprintf(SendCargHudMessage(),"Cargo Slot %i selected",
-			iSelectedCargo);
-		return 1;
-	}
-
-	//---------------------------------------------------------------------------
-	// UCGO Key "3" Select previous Cargo Slot
-	if(key==OAPI_KEY_3&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
-
-		if(iSelectedCargo>0)
-			iSelectedCargo--;
-		double GetCargoSlotMass(int Num); 
-		sprintf(SendCargHudMessage(),"Cargo Slot %i selected",
-			iSelectedCargo);
-		return 1;
+		break;
 	}
 
 	//---------------------------------------------------------------------------
-	// Ummu Key "A" Open & Close the virtual UMMU airlock door
-	if(key==OAPI_KEY_A&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
+	// Open & Close the virtual UMMU airlock door
+	case CMD_AIRLOCK:
 		// switch state
 		Crew.SetAirlockDoorState(!Crew.GetAirlockDoorState());
 		// display state
 		if(Crew.GetAirlockDoorState()==TRUE)
-			strcpy(SendHudMessage(),"Airlock open");	
+			HudMessage(HUD_INFO,"Airlock open");	
 		else
-			strcpy(SendHudMessage(),"Airlock closed");	
-		return 1;
-	}
+			HudMessage(HUD_INFO,"Airlock closed");	
+		break;
 
 	//---------------------------------------------------------------------------
 	// Get some infos Name of ship and total soul aboard
-	if(key==OAPI_KEY_0)
-	{
-		sprintf(SendHudMessage(),"%i crew aboard %s",
+	case CMD_CREW_INFO:
+		HudMessage(HUD_INFO,"%i crew aboard %s",
 			Crew.GetCrewTotalNumber(),GetName());
-		return 1;
-	}
+		break;
 
 	// THIS IS FOR ADDING CREW SEE PDF doc "Allow user to add crew to your ship 
 	// without scenery editor"
-	if(key==OAPI_KEY_M&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
+	case CMD_ADD_CREW:
 		AddUMmuToVessel(TRUE);
-	}
-	// 9 key "select" one cargo on disk (cycle)
-	if(key==OAPI_KEY_9&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
-		sprintf(SendCargHudMessage(),"%s",hUcgo.ScnEditor_SelectNextCargoAvailableOnDisk());
-		return 1;
-	}
-	// SHIFT+9 key "add last cargo selected by key 9"
+		break;
+
+	//---------------------------------------------------------------------------
+	// Select next Cargo Slot 
+	case CMD_SLOT_NEXT:
+		if(iSelectedCargo<layout->nslot-1)
+			iSelectedCargo++;
+		HudMessage(HUD_INFO,"Cargo Slot %i selected",
+			iSelectedCargo);
+		break;
+
+	//---------------------------------------------------------------------------
+	// Select previous Cargo Slot
+	case CMD_SLOT_PREV:
+		if(iSelectedCargo>0)
+			iSelectedCargo--;
+		HudMessage(HUD_INFO,"Cargo Slot %i selected",
+			iSelectedCargo);
+		break;
+
+	// "select" one cargo on disk (cycle)
+	case CMD_CARGO_PICK:
+		HudMessage(HUD_INFO,"%s",hUcgo.ScnEditor_SelectNextCargoAvailableOnDisk());
+		break;
+
+	// "add last cargo selected by CARGO_PICK"
 	// If iSelectedCargo=-1 (default) add to the first free slot found
-	if(key==OAPI_KEY_9&&KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
+	case CMD_CARGO_ADD:
 		if(hUcgo.ScnEditor_AddLastSelectedCargoToSlot(iSelectedCargo)==TRUE)
-		{
-			strcpy(SendCargHudMessage(),"Cargo loaded");
-		}
+			HudMessage(HUD_INFO,"Cargo loaded");
 		else
-		{
-			if(iSelectedCargo<0)
-			{
-				strcpy(SendCargHudMessage(),"Unable to load Cargo");
-			}
-			else
-			{
-				strcpy(SendCargHudMessage(),"Unable to load Cargo");
-			}
-		}
-		return 1;
-	}
-	// "C" grapple cargo. If iSelectedCargo=-1 (default) add to the first free slot found
-	if(key==OAPI_KEY_C&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
+			HudMessage(HUD_WARNING,"Unable to load Cargo");
+		break;
+
+	// grapple cargo. If iSelectedCargo=-1 (default) add to the first free slot found
+	case CMD_CARGO_GRAPPLE:
 	{
 		int ReturnedCode=hUcgo.GrappleOneCargo(iSelectedCargo);
 		// for return code list see function "GrappleOneCargo" in the header
 		switch(ReturnedCode)
 		{
 		case 1:
-			strcpy(SendCargHudMessage(),"Cargo grappled");
+			HudMessage(HUD_INFO,"Cargo grappled");
 			break;
 		case 0:
-			strcpy(SendCargHudMessage(),"No cargo in range");
+			HudMessage(HUD_WARNING,"No cargo in range");
 			break;
 		case -1:
-			strcpy(SendCargHudMessage(),"Maximum payload mass exceeded");
+			HudMessage(HUD_WARNING,"Maximum payload mass exceeded");
 			break;
 		case -2:
-			strcpy(SendCargHudMessage(),"bad config, mesh not found or slot not declared");
+			HudMessage(HUD_WARNING,"bad config, mesh not found or slot not declared");
 			break;
 		case -3:
-			strcpy(SendCargHudMessage(),"Cargo slot full, unable to grapple cargo");
+			HudMessage(HUD_WARNING,"Cargo slot full, unable to grapple cargo");
 			break;
 		case -4:
-			strcpy(SendCargHudMessage(),"Payload Bay A closed");
+			HudMessage(HUD_WARNING,"Payload Bay A closed");
 			break;
 		case -5:
-			strcpy(SendCargHudMessage(),"Unable to load Cargo. All slots full");
+			HudMessage(HUD_WARNING,"Unable to load Cargo. All slots full");
 			break;
 		default:
-			strcpy(SendCargHudMessage(),"Misc error. Unable to grapple cargo");
+			HudMessage(HUD_WARNING,"Misc error. Unable to grapple cargo");
 		}
-		return 1;
+		break;
 	}
-	// SHIFT+C release cargo. If iSelectedCargo=-1 (default) release the first free slot found
-	if(key==OAPI_KEY_C&&KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
+
+	// release cargo. If iSelectedCargo=-1 (default) release the first free slot found
+	case CMD_CARGO_RELEASE:
 		if(hUcgo.ReleaseOneCargo(iSelectedCargo)!=FALSE)
-		{
-			strcpy(SendCargHudMessage(),"Cargo release");
-		}
+			HudMessage(HUD_INFO,"Cargo release");
 		else
+			HudMessage(HUD_INFO,"Slot empty");
+		break;
+
+	// show some info on cargo
+	case CMD_CARGO_INFO:
+		HudMessage(HUD_INFO,"Curent Payload mass %.0fkg in "
+			"%i slots",hUcgo.GetCargoTotalMass(),hUcgo.GetNbrCargoLoaded());
+		break;
+
+	// Check O2 state
+	case CMD_O2_INFO:
 		{
-			strcpy(SendCargHudMessage(),"Slot empty");
+			double simt = oapiGetSimTime();
+			HudMessage(HUD_INFO,"Main Oxygen tank %.0fkg/%.0fkg. CO2 scrubbers %.0f%%, water %.0fkg, power %.0fkWh"
+				,O2Check(),LS_CAPACITY[LS_O2],LifeSupportLevel(LS_CO2,simt)/LS_CAPACITY[LS_CO2]*100,
+				LifeSupportLevel(LS_WATER,simt),LifeSupportLevel(LS_POWER,simt));
+			if (ls.tEmpty < 1e29)
+				HudMessage(ls.tEmpty-simt < 86400 ? HUD_WARNING : HUD_INFO,"Life support runs out in %.1f days",(ls.tEmpty-simt)/86400);
 		}
-		return 1;
-	}
-	// "8" show some info on cargo
-	if(key==OAPI_KEY_8&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
-		sprintf(SendCargHudMessage(),"Curent Payload mass %.0fkg in "
-			"%i slots",hUcgo.GetCargoTotalMass(),hUcgo.GetNbrCargoLoaded());
-	return 1;
+		break;
+
+	// show or hide the profile on the HUD, showing it switches profiling on
+	case CMD_PROFILE:
+		bShowProfile = !bShowProfile;
+		if (bShowProfile)
+			bShuttleProfile = true;
+		break;
+
+	// write the profile out
+	case CMD_PROFILE_DUMP:
+		if (WriteProfile (PROFILE_FILE))
+			HudMessage(HUD_INFO,"Profile written to %s",PROFILE_FILE);
+		else
+			HudMessage(HUD_WARNING,"Unable to write %s",PROFILE_FILE);
+		break;
 	}
+}
 
-		// "7" Check O2 state
-	if(key==OAPI_KEY_7&&!KEYMOD_SHIFT(kstate)&&!KEYMOD_CONTROL (kstate))
-	{
-		sprintf(SendCargHudMessage(),"Main Oxygen tank %.0fkg/1000kg. "
-			,O2Check());
-	return 1;
+//=========================================================
+// clbkConsumeBufferedKey
+// Another important function, this particular section is used to execute functions whenever the Orbiter application detects a given keystroke by a user.
+// It used to be a long chain of if (key==...) tests, one per key, with the ctrl-keypress & shift-keypress versions each needing a test
+// of their own. Now it only works out which Shift/Ctrl combination is held & looks the key up in KeyBinding, see Commands & Key
+// Bindings above.
+//=========================================================
+
+int ShuttleD::clbkConsumeBufferedKey (DWORD key, bool down, char *kstate)
+{
+	if (!down || key >= 256) return 0;       // only process keydown events
+
+	int m = (KEYMOD_SHIFT(kstate) ? 1 : 0) + (KEYMOD_CONTROL(kstate) ? 2 : 0);
+	if (ilog) {
+		if (ilog->replay)		// the keys come from the log now
+			return KeyBinding[key][m] ? 1 : 0;
+		unsigned char k[2] = {(unsigned char)key, (unsigned char)m};
+		LogEvent (IL_KEY, k, 2);
 	}
+	return KeyDown (key, m);
+}
 
-	return 0;
+// m is the Shift (1) & Ctrl (2) bits
+int ShuttleD::KeyDown (DWORD key, int m)
+{
+	int cmd = KeyBinding[key][m];
+	if (!cmd) return 0;
+	RunCommand (cmd-1);
+	return 1;
 }
 
 //=========================================================
 // UMmuCrewAddCallback & AddUMmuToVessel
 // Again, a Dansteph creation, so I dont know a great deal about it, but its used in adding crew directly to the ship without entering through the main
 // hatch. Fairly usefull, Id say.
+// Each step of it runs from an EV_ADD_CREW event, scheduled when it starts & whenever an answer comes back from the input box.
 //=========================================================
 
+// data is the vessel, so the answer can go into the input log as well
 bool UMmuCrewAddCallback(void *id, char *str, void *data)
 {
 	if(strlen(str)<2||strlen(str)>38)
 		return false;
-	char *cPtr=(char*)data;	if(*cPtr==2){*cPtr=3;strcpy(cPtr+2,str);}
+	ShuttleD *v=(ShuttleD*)data;
+	if(v->ilog&&!v->ilog->replay)
+		v->LogEvent(IL_INPUT,str,(int)strlen(str));
+	char *cPtr=v->cAddUMmuToVessel;	if(*cPtr==2){*cPtr=3;strcpy(cPtr+2,str);}
 	else if(*cPtr==4){*cPtr=5;strcpy(cPtr+42,str);}
-	else if(*cPtr==6){*cPtr=7;strcpy(cPtr+82,str);}return true;
+	else if(*cPtr==6){*cPtr=7;strcpy(cPtr+82,str);}
+	else return true;
+	v->ScheduleEvent(oapiGetSimTime(),EV_ADD_CREW);	// the next step goes on from here
+	return true;
+}
+
+// while an input log is replayed the answer comes from the log instead
+void ShuttleD::OpenCrewInputBox (const char *title)
+{
+	if (ilog && ilog->replay) return;
+	oapiOpenInputBox ((char*)title,UMmuCrewAddCallback,0,30,(void*)this);
 }
 
 void ShuttleD::AddUMmuToVessel(BOOL bStartAdding)
@@ -1532,27 +3611,29 @@ void ShuttleD::AddUMmuToVessel(BOOL bStartAdding)
 		int salut=sizeof(cAddUMmuToVessel);
 		memset(cAddUMmuToVessel,0,sizeof(cAddUMmuToVessel));
 		cAddUMmuToVessel[0]=1;
+		ScheduleEvent(oapiGetSimTime(),EV_ADD_CREW);
 	}
 	else if(cAddUMmuToVessel[0]==1){
 		cAddUMmuToVessel[0]=2;
-		oapiOpenInputBox ("Enter new crew member name (or hit escape to cancel)",UMmuCrewAddCallback,0,30,(void*)cAddUMmuToVessel);
+		OpenCrewInputBox ("Enter new crew member name (or hit escape to cancel)");
 	}
 	else if(cAddUMmuToVessel[0]==3){
 		cAddUMmuToVessel[0]=4;
-		oapiOpenInputBox ("Enter age",UMmuCrewAddCallback,0,30,(void*)cAddUMmuToVessel);
+		OpenCrewInputBox ("Enter age");
 	}
 	else if(cAddUMmuToVessel[0]==5){
 		cAddUMmuToVessel[0]=6;
-		oapiOpenInputBox ("Enter Crew ID - Capt,Sec,Vip,Sci,Doc,Tech,Crew,Pax)",UMmuCrewAddCallback,0,30,(void*)cAddUMmuToVessel);
+		OpenCrewInputBox ("Enter Crew ID - Capt,Sec,Vip,Sci,Doc,Tech,Crew,Pax)");
 	}
 	else if(cAddUMmuToVessel[0]==7){
 		cAddUMmuToVessel[0]=0;
 		int Age=max(5,min(100,atoi(&cAddUMmuToVessel[42])));
 		if(Crew.AddCrewMember(&cAddUMmuToVessel[2],Age,70,70,&cAddUMmuToVessel[82])==TRUE){
-			sprintf(SendHudMessage(),"\"%s\" aged %i added to vessel",&cAddUMmuToVessel[2],Age);
+			HudMessage(HUD_INFO,"\"%s\" aged %i added to vessel",&cAddUMmuToVessel[2],Age);
+			LifeSupportChanged ();
 		}
 		else{
-			strcpy(SendHudMessage(),"Unable to add crew");
+			HudMessage(HUD_WARNING,"Unable to add crew");
 		}
 	}
 }
@@ -1572,6 +3653,13 @@ DLLCLBK void InitModule (HINSTANCE hModule)
 	hBrush = CreateSolidBrush (RGB(0,128,0));
 
 	// perform global module initialisation here
+	Shuttle_BuildAeroTables();
+	Shuttle_IndexVCAreas();
+	Shuttle_InitProfile();
+#ifdef _DEBUG
+	Shuttle_CheckAeroTables();
+	Shuttle_CheckScheduler();
+#endif
 }
 DLLCLBK void ExitModule (HINSTANCE hModule)
 {
@@ -1579,6 +3667,7 @@ DLLCLBK void ExitModule (HINSTANCE hModule)
 	DeleteObject (hFont);
 	DeleteObject (hPen);
 	DeleteObject (hBrush);
+	if (GlyphAtlas) oapiDestroySurface (GlyphAtlas);
 
 }
 
@@ -1615,8 +3704,23 @@ void ShuttleD::clbkPostCreation (void)
 	// (new version of ovcPostCreation wich is now obsolet)
 	SHD=ConnectToOrbiterSoundDLL(GetHandle());
 
+	tUcgoWarn = oapiGetSimTime() + UCGO_WARN_TIME;
+
+	// The main bay door state only gets pushed to UCGO when the doors finish moving, so give it the starting state here
+	hUcgo.SetSlotDoorState(mech[MECH_PLBAYA].status == MECHANISM::OPEN ? TRUE : FALSE);
+
+	// the crew & life support levels are both loaded by now
+	LifeSupportChanged ();
+
 	SetMyDefaultWaveDirectory("Sound\\_CustomVesselsSounds\\Shuttle_D\\");
 
+	if (bShuttleTelemetry)
+		StartTelemetry ();
+	if (bShuttleRecorder)
+		StartRecorder ();
+	if (ShuttleInputLog)
+		StartInputLog (ShuttleInputLog == 2);
+
 	RequestLoadVesselWave(SHD,GEARUP,"gearup.wav",INTERNAL_ONLY);
 	RequestLoadVesselWave(SHD,GEARDOWN,"geardown.wav",INTERNAL_ONLY);
 	RequestLoadVesselWave(SHD,PLBAYAOPEN,"plbayaopen.wav",INTERNAL_ONLY);
@@ -1652,7 +3756,12 @@ void ShuttleD::clbkPostCreation (void)
 
 ShuttleD::~ShuttleD() 
 {
-     delete th_rcs, th_main;
+	if (tlm)
+		StopTelemetry ();
+	if (fdr)
+		StopRecorder ();
+	if (ilog)
+		StopInputLog ("stopped");
 }
 
 //=========================================================